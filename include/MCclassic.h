@@ -16,7 +16,65 @@
 #ifndef MCCLASSIC_H_INCLUDED
 #define MCCLASSIC_H_INCLUDED
 
-uint64_t make_MC_moves(ATOM at[], DATA *dat, double *ener);
-int32_t apply_Metrop(ATOM at[], ATOM at_new[], DATA *dat, int32_t *candidate, double *ener, uint64_t *step);
+/*
+ * Random numbers drawn by a rejected move of a single atom : the atom, its displacement and the acceptance test
+ */
+#define SPEC_RN     5
+
+/**
+ * @brief Trial moves of a Metropolis chain evaluated together against the same state (METHOD METROP SPECULATIVE),
+ *          see make_MC_spec_steps in MCclassic.c
+ */
+typedef struct
+{
+    uint32_t n;             ///< number of trial moves evaluated together
+    COORDS **trial;         ///< trial copy of the coordinates of each move, trial[0] being the one of the chain
+    uint32_t *cand;         ///< moving atom of each move
+    double *dr;             ///< its displacement, x,y,z for each
+    double *ediff;          ///< change of the energy of each move
+    double *econstr;        ///< change of the energy of the constraint
+    double *enew;           ///< with the energy cache, energy of each moving atom in its trial position
+    double *rows;           ///< with the energy cache, its pair energies
+    double *rn;             ///< random numbers drawn ahead of the chain
+    uint32_t nrn;           ///< how many of them are not used yet
+} SPEC_MOVES;
+
+/**
+ * @brief Working data of a Metropolis chain besides its coordinates, see alloc_MC_chain in MCclassic.c
+ */
+typedef struct
+{
+    COORDS crd_new;         ///< copy of the coordinates where the trial moves are made, identical to them in between
+    ECACHE ecache;          ///< per atom energy cache, used only if cache is not NULL
+    ECACHE *cache;          ///< &ecache if the potential provides the pair energies of a candidate, NULL otherwise
+    EARLY_REJ early_rej;    ///< nearest neighbours lists for the early rejection of the moves, used only if early is not NULL
+    EARLY_REJ *early;       ///< &early_rej with METHOD METROP EARLY, NULL otherwise
+    int32_t *ismoving;      ///< the atoms moving at the current step
+    double *dr;             ///< their displacements, x,y,z for each
+    double *rows;           ///< with the cache and MOVE NATOMS, pair energies of each moving atom in its trial position
+    double *enews;          ///< with the cache and MOVE NATOMS, energy of each moving atom in its trial position
+    SPEC_MOVES spec_moves;  ///< trial moves evaluated together, used only if spec is not NULL
+    SPEC_MOVES *spec;       ///< &spec_moves with METHOD METROP SPECULATIVE, NULL otherwise
+    char name[32];          ///< name of the replica or walker in the outputs, empty for a single chain
+} MC_CHAIN;
+
+/// allocate or free the working data of a Metropolis chain
+void alloc_MC_chain(MC_CHAIN *ch, COORDS *crd, DATA *dat);
+void free_MC_chain(MC_CHAIN *ch);
+
+/// one Metropolis step of a chain, returns 1 if the move was accepted
+uint32_t make_MC_step(MC_CHAIN *ch, COORDS *crd, DATA *dat, double *ener, uint64_t st);
+
+/// up to nmax Metropolis steps of a chain made together, returns the number of steps done
+uint32_t make_MC_spec_steps(MC_CHAIN *ch, COORDS *crd, DATA *dat, double *ener, uint32_t nmax, uint32_t *accepted);
+
+/// recompute from scratch what the steps update incrementally
+void refresh_MC_chain(MC_CHAIN *ch, COORDS *crd, DATA *dat, uint64_t st, double *ener);
+
+/// minimise the trial copy of the coordinates, returns its energy
+double quench_MC_chain(MC_CHAIN *ch, DATA *dat);
+
+uint64_t make_MC_moves(COORDS *crd, ATOM at[], DATA *dat, double *ener);
+int32_t apply_Metrop(COORDS *crd, COORDS *crd_new, DATA *dat, int32_t *candidate, double *ener, uint64_t *step, ECACHE *cache, EARLY_REJ *early);
 
 #endif // MCCLASSIC_H_INCLUDED
@@ -0,0 +1,33 @@
+/**
+ * \file MCptmc.h
+ *
+ * \brief Header file for MCptmc.c
+ *
+ * \authors Florent Hedin (University of Basel, Switzerland) \n
+ *          Markus Meuwly (University of Basel, Switzerland)
+ *
+ * \copyright Copyright (c) 2011-2015, Florent Hédin, Markus Meuwly, and the University of Basel. \n
+ *            All rights reserved. \n
+ *            The 3-clause BSD license is applied to this software. \n
+ *            See LICENSE.txt
+ *
+ */
+
+#ifndef MCPTMC_H_INCLUDED
+#define MCPTMC_H_INCLUDED
+
+/*
+ * Default number of steps between two attempts of exchanging the neighbour replicas (METHOD PTMC EXCHANGE)
+ * Can be redefined when compiling
+ */
+#ifndef PT_EXCH
+#define PT_EXCH     100
+#endif
+
+/// parallel tempering simulation, returns the number of moves accepted by all the replicas
+uint64_t launch_PTMC(COORDS *crd, ATOM at[], DATA *dat, double *ener);
+
+/// temperature of replica r of the geometric ladder
+double get_PT_temp(const DATA *dat, uint32_t r);
+
+#endif // MCPTMC_H_INCLUDED
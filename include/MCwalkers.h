@@ -0,0 +1,22 @@
+/**
+ * \file MCwalkers.h
+ *
+ * \brief Header file for MCwalkers.c
+ *
+ * \authors Florent Hedin (University of Basel, Switzerland) \n
+ *          Markus Meuwly (University of Basel, Switzerland)
+ *
+ * \copyright Copyright (c) 2011-2015, Florent Hédin, Markus Meuwly, and the University of Basel. \n
+ *            All rights reserved. \n
+ *            The 3-clause BSD license is applied to this software. \n
+ *            See LICENSE.txt
+ *
+ */
+
+#ifndef MCWALKERS_H_INCLUDED
+#define MCWALKERS_H_INCLUDED
+
+/// independent Metropolis chains run together, returns the number of moves accepted by all the walkers
+uint64_t launch_walkers(COORDS *crd, ATOM at[], DATA *dat, double *ener);
+
+#endif // MCWALKERS_H_INCLUDED
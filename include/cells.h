@@ -0,0 +1,53 @@
+/**
+ * \file cells.h
+ *
+ * \brief Header file for cells.c
+ *
+ * \authors Florent Hedin (University of Basel, Switzerland) \n
+ *          Markus Meuwly (University of Basel, Switzerland)
+ *
+ * \copyright Copyright (c) 2011-2015, Florent Hédin, Markus Meuwly, and the University of Basel. \n
+ *            All rights reserved. \n
+ *            The 3-clause BSD license is applied to this software. \n
+ *            See LICENSE.txt
+ *
+ */
+
+#ifndef CELLS_H_INCLUDED
+#define CELLS_H_INCLUDED
+
+/*
+ * Empty space (in cutoff units) added around the cluster on each side when building the grid,
+ * so that it does not have to be rebuilt each time an atom moves out of the cluster extent
+ * Can be redefined when compiling
+ */
+#ifndef CELLS_MARGIN
+#define CELLS_MARGIN    2.0
+#endif
+
+/*
+ * Maximum number of cells per atom : for sparse systems the cells are made larger than the cutoff
+ * Can be redefined when compiling
+ */
+#ifndef CELLS_PER_ATOM
+#define CELLS_PER_ATOM  2
+#endif
+
+/// allocate, build or free the cell grid attached to a coordinates store
+void alloc_cells(COORDS *crd, double rc);
+void free_cells(COORDS *crd);
+void build_cells(COORDS *crd);
+
+/// update the grid after atom i moved, regrowing it if the atom left the grid
+void move_cells(COORDS *crd, uint32_t i);
+
+/// copy a grid to another coordinates store with the same atoms
+void copy_cells(COORDS *dst, COORDS *src);
+
+/// undo the moves of atom i in the grid of a trial copy of src
+void revert_cells(COORDS *dst, COORDS *src, uint32_t i);
+
+/// indices of the (up to 27) cells surrounding the one containing the point x,y,z
+uint32_t get_neighbour_cells(CELLS *c, double x, double y, double z, uint32_t nb[27]);
+
+#endif // CELLS_H_INCLUDED
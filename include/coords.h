@@ -0,0 +1,57 @@
+/**
+ * \file coords.h
+ *
+ * \brief Header file for coords.c
+ *
+ * \authors Florent Hedin (University of Basel, Switzerland) \n
+ *          Markus Meuwly (University of Basel, Switzerland)
+ *
+ * \copyright Copyright (c) 2011-2015, Florent Hédin, Markus Meuwly, and the University of Basel. \n
+ *            All rights reserved. \n
+ *            The 3-clause BSD license is applied to this software. \n
+ *            See LICENSE.txt
+ *
+ */
+
+#ifndef COORDS_H_INCLUDED
+#define COORDS_H_INCLUDED
+
+/*
+ * Alignment in bytes of the coordinates arrays : 64 is enough for AVX-512 loads
+ * Can be redefined when compiling
+ */
+#ifndef COORDS_ALIGN
+#define COORDS_ALIGN    64
+#endif
+
+/// allocate or free the arrays of a coordinates store
+void alloc_coords(COORDS *crd, uint32_t natom);
+void free_coords(COORDS *crd);
+
+/// allocate the single precision copies of X,Y,Z read by the mixed precision kernels
+void alloc_coords_mixed(COORDS *crd);
+
+/// copy X,Y,Z from one coordinates store to another one of the same size
+void copy_coords(COORDS *dst, COORDS *src);
+
+/// allocate a coordinates store as a copy of another one, with its own grid, lists and densities
+void clone_coords(COORDS *dst, COORDS *src);
+
+/// conversion between the coordinates store and the ATOM view used for I/O
+void atoms_to_coords(ATOM at[], COORDS *crd);
+void coords_to_atoms(const COORDS *crd, ATOM at[]);
+
+/// move or place one atom, updating the sums used for the center of mass in O(1), and the cell grid and densities if any
+void move_atom_coords(COORDS *crd, uint32_t i, double dx, double dy, double dz);
+void set_atom_coords(COORDS *crd, uint32_t i, double x, double y, double z);
+
+/// undo the move of atom i in a trial copy of src, and make the trial copy identical to src again
+void revert_atom_coords(COORDS *dst, COORDS *src, uint32_t i);
+void sync_coords(COORDS *dst, COORDS *src);
+
+///get centre of mass of a coordinates store, in O(1)
+CM getCM_coords(const COORDS *crd);
+///recompute the sums used for the center of mass, and the cell grid and densities if any, after the coordinates were modified directly
+void refresh_coords(COORDS *crd);
+
+#endif // COORDS_H_INCLUDED
@@ -33,22 +33,187 @@
 #define JTOCAL      0.239005736     // Joules to Calories
 #define CM1TOKJM    1.1963e-02    // 1 cm-1 in kJ/mol
 
-// pointers to the desired energy and force functions
-double (*get_ENER)(ATOM at[], DATA *dat, int32_t candidate);
-void   (*get_DV)(ATOM at[], DATA *dat, double fx[], double fy[], double fz[]);
+/*
+ * Systems up to this number of atoms also keep the full matrix of pair energies in the ECACHE ;
+ * updating the matrix writes one column so it only pays off while it fits in the L1 cache.
+ * Can be redefined when compiling
+ */
+#ifndef ECACHE_MATRIX_MAX
+#define ECACHE_MATRIX_MAX   64
+#endif
+
+/*
+ * When compiled with OpenMP, the energy and gradient of the whole system (L-J, Aziz or tabulated) are computed
+ * in parallel for systems with at least this number of atoms
+ * Can be redefined when compiling
+ */
+#ifndef LJ_DV_OMP_MIN
+#define LJ_DV_OMP_MIN   128
+#endif
+
+/*
+ * When compiled with OpenMP, the energy of a single candidate is evaluated in parallel in systems with at least
+ * this number of atoms (see init_omp_cand)
+ * Can be redefined when compiling
+ */
+#ifndef CAND_OMP_MIN
+#define CAND_OMP_MIN    1024
+#endif
+
+/*
+ * With REDUCTION DETERMINISTIC the energy of a candidate is summed over blocks of this number of atoms,
+ * whatever the number of threads ; see get_V_cand_det
+ * Can be redefined when compiling
+ */
+#ifndef DET_BLOCK
+#define DET_BLOCK   64
+#endif
+
+/*
+ * Pointers to the desired energy and force functions, defined in main.c.
+ * They are reentrant : the coordinates and data are only read, and the only memory written is the one given by the caller
+ * (except for the Lua plugins, which share one interpreter).
+ */
+extern ENERGY (*get_ENER)(const COORDS *crd, const DATA *dat, int32_t candidate);
+extern void   (*get_DV)(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[]);
+
+// optional pointers (NULL if the potential does not provide them) to a function returning the pair energy
+// of a candidate while storing each pair term in row[] (without the constraint), and to the constraint energy alone
+extern double (*get_ENER_ROW)(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[]);
+extern double (*get_CONSTR)(const COORDS *crd, const DATA *dat, int32_t candidate);
+
+// optional pointer (NULL if the potential does not provide it) to a function returning the same as get_ENER(crd,dat,-1)
+// while filling the gradient as get_DV, in a single sweep over the pairs
+extern ENERGY (*get_ENER_DV)(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[]);
+
+/**
+ * @brief Cache of the interaction energy of each atom with the rest of the system, i.e. of get_ENER(crd,dat,i),
+ *          so that a MC step only has to evaluate the trial configuration. See alloc_ecache in ener.c
+ */
+typedef struct
+{
+    uint32_t natom;     ///< Number of atoms
+    double *eat;        ///< interaction energy of each atom in the committed configuration
+    double *row;        ///< pair energies of the last evaluated candidate in its trial position
+    double enew;        ///< interaction energy of the last evaluated candidate in its trial position
+    double *oldrow;     ///< scratch row used for updating eat when there is no matrix of pairs
+    double *pairs;      ///< natom*natom matrix of pair energies, only when natom <= ECACHE_MATRIX_MAX, NULL otherwise
+} ECACHE;
+
+// per atom energy cache
+void alloc_ecache(ECACHE *cache, const COORDS *crd, const DATA *dat);
+void free_ecache(ECACHE *cache);
+void build_ecache(ECACHE *cache, const COORDS *crd, const DATA *dat);
+void update_ecache(ECACHE *cache, const COORDS *crd, const DATA *dat, uint32_t candidate, const double row[], double Enew);
+
+/*
+ * Default number of nearest neighbours of a candidate visited for the early rejection of a L-J move (METHOD METROP EARLY)
+ * Can be redefined when compiling
+ */
+#ifndef EARLY_NEAR
+#define EARLY_NEAR  12
+#endif
+
+/**
+ * @brief Nearest neighbours of each atom and well depths of the L-J pairs, used for proving that a trial move will be
+ *          rejected from the pair energies of the nearest neighbours of the candidate only (see early_reject in ener.c)
+ */
+typedef struct
+{
+    uint32_t natom;     ///< Number of atoms
+    uint32_t k;         ///< Number of neighbours stored per atom
+    uint32_t *near;     ///< natom*k indices of the k nearest neighbours of each atom, nearest first, at the last update of the lists
+    double *depth;      ///< ntypes*ntypes well depths of the pairs of species
+    double *wsum;       ///< for each species, minus the sum of the well depths with all the other atoms, i.e. the lowest possible pair energy of an atom
+    uint64_t nrej;      ///< number of moves rejected early
+} EARLY_REJ;
+
+// early rejection of the L-J moves
+void alloc_early(EARLY_REJ *er, const COORDS *crd, const DATA *dat);
+void free_early(EARLY_REJ *er);
+void build_early(EARLY_REJ *er, const COORDS *crd);
+uint32_t early_reject(const EARLY_REJ *er, const COORDS *crd, const DATA *dat, uint32_t candidate, double limit);
+
+// per species pair table of lennard-jones coefficients
+void build_LJ_table(DATA *dat);
+void free_LJ_table(DATA *dat);
+
+/**
+ * @brief A set of Lennard-Jones kernels : pair energy of the whole system, pair energy of one candidate atom,
+ *          gradient contributions (and energy) of the pairs (i,j>i), pair energies of one candidate atom,
+ *          and pair energy of atom i with the atoms [from,to[ (optionally stored in out[j]).
+ *          Several vectorised variants exist, see init_LJ_kernels in ener.c
+ */
+typedef struct
+{
+    const char *name;   ///< name of the variant, printed at startup
+    double (*full)(const COORDS *crd, const DATA *dat);
+    double (*cand)(const COORDS *crd, const DATA *dat, uint32_t candidate);
+    double (*grad_row)(const COORDS *crd, const DATA *dat, uint32_t i, double fx[], double fy[], double fz[]);
+    double (*row)(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[]);
+    double (*range)(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t from, uint32_t to, double out[]);
+} LJ_KERNELS;
+
+// select at startup the fastest kernels supported by the cpu
+const char* init_LJ_kernels(const COORDS *crd, const DATA *dat);
+
+// energy of atom i with the atoms [from,to[, and if out is not NULL each pair energy stored in out[j]
+typedef double (*PAIR_RANGE)(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t from, uint32_t to, double out[]);
+
+// energy of the whole system and of a candidate (optionally stored in row[]) summed in an order independent of the threads
+double get_V_full_det(const COORDS *crd, const DATA *dat, PAIR_RANGE range);
+double get_V_cand_det(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[], PAIR_RANGE range);
+
+#ifdef _OPENMP
+// set by init_omp_cand : 1 if the energy of a candidate is evaluated in parallel
+extern uint32_t cand_omp;
+
+// parallel evaluation of the whole system, and of a candidate ; not when already called from a parallel region
+#define OMP_FULL(crd)   ((crd)->natom >= LJ_DV_OMP_MIN && omp_get_max_threads() > 1 && !omp_in_parallel())
+#define OMP_CAND        (cand_omp && !omp_in_parallel())
+
+// energy of the whole system and of a candidate (optionally stored in row[]) with the pairs distributed over the threads
+double get_V_full_omp(const COORDS *crd, const DATA *dat, PAIR_RANGE range);
+double get_V_cand_omp(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[], PAIR_RANGE range);
+
+// decide at startup if the energy of a candidate is evaluated in parallel
+void init_omp_cand(const COORDS *crd);
+#endif
 
 // ener and force for lennard-jones
-double get_LJ_V(ATOM at[], DATA *dat, int32_t candidate);
-void get_LJ_DV(ATOM at[], DATA *dat, double fx[], double fy[], double fz[]);
+ENERGY get_LJ_V(const COORDS *crd, const DATA *dat, int32_t candidate);
+double get_LJ_V_row(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[]);
+double get_LJ_CONSTR(const COORDS *crd, const DATA *dat, int32_t candidate);
+void get_LJ_DV(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[]);
+double get_LJ_V_ref(const COORDS *crd, const DATA *dat);
+void check_LJ_mixed(const COORDS *crd, const DATA *dat, uint64_t step, double *ener, const char *name);
+ENERGY get_LJ_V_DV(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[]);
 
-// ener for aziz potential
-double get_AZIZ_V(ATOM at[], DATA *dat, int32_t candidate);
+// ener and force for lennard-jones with a cutoff, using cell lists or Verlet lists
+ENERGY get_LJ_V_cut(const COORDS *crd, const DATA *dat, int32_t candidate);
+void get_LJ_DV_cut(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[]);
+ENERGY get_LJ_V_DV_cut(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[]);
 
-// those 3 functions returns energy in cm-1 !!
+// ener (and ener with gradient) for aziz potential
+void build_AZIZ_table(DATA *dat);
+void free_AZIZ_table(DATA *dat);
+ENERGY get_AZIZ_V(const COORDS *crd, const DATA *dat, int32_t candidate);
+double get_AZIZ_V_row(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[]);
+void get_AZIZ_DV(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[]);
+ENERGY get_AZIZ_V_DV(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[]);
+
+// those functions returns energy in cm-1 !! (for a pair of Aziz species, or for one of the 3 pairs)
+double aziz_pair(AZIZ_SPECIES a, AZIZ_SPECIES b, double r);
 double aziz_ne_ne(double r);
 double aziz_ar_ne(double r);
 double aziz_ar_ar(double r);
 
+// same, also storing the derivative dV/dr (in cm-1 per angstroem) in dv
+double aziz_pair_dv(AZIZ_SPECIES a, AZIZ_SPECIES b, double r, double *dv);
+double aziz_ne_ne_dv(double r, double *dv);
+double aziz_ar_ne_dv(double r, double *dv);
+double aziz_ar_ar_dv(double r, double *dv);
+
 // constraint for avoiding cluster evaporation
 double getExtraPot(double d2, double sig, double eps);
 
@@ -0,0 +1,69 @@
+/**
+ * \file ener_simd.h
+ *
+ * \brief Header file for ener_simd.c
+ *
+ * \authors Florent Hedin (University of Basel, Switzerland) \n
+ *          Markus Meuwly (University of Basel, Switzerland)
+ *
+ * \copyright Copyright (c) 2011-2015, Florent Hédin, Markus Meuwly, and the University of Basel. \n
+ *            All rights reserved. \n
+ *            The 3-clause BSD license is applied to this software. \n
+ *            See LICENSE.txt
+ *
+ */
+
+#ifndef ENER_SIMD_H_INCLUDED
+#define ENER_SIMD_H_INCLUDED
+
+/*
+ * The vectorised kernels are compiled for x86 with gcc or clang, using function attributes
+ * so that the rest of the program is still built for the baseline (-msse2) instruction set.
+ * Define NO_SIMD_KERNELS when compiling for disabling them.
+ */
+#if !defined(NO_SIMD_KERNELS) && (defined(__x86_64__) || defined(__i386__)) \
+    && defined(__GNUC__) && !defined(__INTEL_COMPILER)
+#define SIMD_KERNELS
+#endif
+
+#ifdef SIMD_KERNELS
+
+// AVX2 + FMA kernels, 4 doubles per vector
+double LJ_V_full_avx2(const COORDS *crd, const DATA *dat);
+double LJ_V_cand_avx2(const COORDS *crd, const DATA *dat, uint32_t candidate);
+double LJ_DV_row_avx2(const COORDS *crd, const DATA *dat, uint32_t i, double fx[], double fy[], double fz[]);
+double LJ_V_row_avx2(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[]);
+double LJ_V_range_avx2(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t from, uint32_t to, double out[]);
+
+// AVX-512F kernels, 8 doubles per vector
+double LJ_V_full_avx512(const COORDS *crd, const DATA *dat);
+double LJ_V_cand_avx512(const COORDS *crd, const DATA *dat, uint32_t candidate);
+double LJ_DV_row_avx512(const COORDS *crd, const DATA *dat, uint32_t i, double fx[], double fy[], double fz[]);
+double LJ_V_row_avx512(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[]);
+double LJ_V_range_avx512(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t from, uint32_t to, double out[]);
+
+// the same for systems of a single species, where the coefficients of the pairs are constants
+double LJ_V_full_avx2_single(const COORDS *crd, const DATA *dat);
+double LJ_V_cand_avx2_single(const COORDS *crd, const DATA *dat, uint32_t candidate);
+double LJ_DV_row_avx2_single(const COORDS *crd, const DATA *dat, uint32_t i, double fx[], double fy[], double fz[]);
+double LJ_V_row_avx2_single(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[]);
+double LJ_V_range_avx2_single(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t from, uint32_t to, double out[]);
+double LJ_V_full_avx512_single(const COORDS *crd, const DATA *dat);
+double LJ_V_cand_avx512_single(const COORDS *crd, const DATA *dat, uint32_t candidate);
+double LJ_DV_row_avx512_single(const COORDS *crd, const DATA *dat, uint32_t i, double fx[], double fy[], double fz[]);
+double LJ_V_row_avx512_single(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[]);
+double LJ_V_range_avx512_single(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t from, uint32_t to, double out[]);
+
+// mixed precision variants of the energy kernels (distances in float, sums in double), see PRECISION_MODE
+double LJ_V_full_mixed_avx2(const COORDS *crd, const DATA *dat);
+double LJ_V_cand_mixed_avx2(const COORDS *crd, const DATA *dat, uint32_t candidate);
+double LJ_V_row_mixed_avx2(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[]);
+double LJ_V_range_mixed_avx2(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t from, uint32_t to, double out[]);
+double LJ_V_full_mixed_avx512(const COORDS *crd, const DATA *dat);
+double LJ_V_cand_mixed_avx512(const COORDS *crd, const DATA *dat, uint32_t candidate);
+double LJ_V_row_mixed_avx512(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[]);
+double LJ_V_range_mixed_avx512(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t from, uint32_t to, double out[]);
+
+#endif //SIMD_KERNELS
+
+#endif // ENER_SIMD_H_INCLUDED
@@ -74,6 +74,78 @@ extern uint32_t ncpus;
 extern uint32_t nthreads;
 #endif
 
+/**
+ * @brief A structure holding the Lennard-Jones parameters
+ * See http://www.sklogwiki.org/SklogWiki/index.php/Lennard-Jones_model
+ */
+typedef struct
+{
+    char sym[4];    ///< atomic symbol
+    double sig ;    ///< L-J sigma parameter
+    double eps ;    ///< L-J epsilon parameter
+} LJPARAMS;
+
+/**
+ * @brief How the pair potential is brought to zero at the cutoff distance, see the CUTOFF keyword of the input file
+ */
+typedef enum
+{
+    CUT_NONE=0,     ///< no cutoff, all the pairs are computed
+    CUT_TRUNC,      ///< pairs further than the cutoff are ignored
+    CUT_SHIFT,      ///< the potential is shifted so that it is 0 at the cutoff
+    CUT_SWITCH      ///< the potential is smoothly switched off between DATA::cuton and DATA::cutoff
+} CUTOFF_MODE;
+
+/**
+ * @brief Precision of the L-J energy kernels, see the PRECISION keyword of the input file
+ */
+typedef enum
+{
+    PREC_DOUBLE=0,  ///< everything in double precision
+    PREC_MIXED      ///< distances and r^-6 in float, energies accumulated in double ; coordinates are still stored in double
+} PRECISION_MODE;
+
+/**
+ * @brief Pair potential sampled by the tabulated potential (POTENTIAL TABLE keyword of the input file), see table.c
+ */
+typedef enum
+{
+    TAB_NONE=0,     ///< the potential is not tabulated
+    TAB_LJ,         ///< Lennard-Jones
+    TAB_AZIZ,       ///< Aziz
+    TAB_PLUGIN      ///< pair functions of a Lua plugin
+} TABLE_SOURCE;
+
+/**
+ * @brief Many-body potential of the embedded atom kind (POTENTIAL GUPTA or SC keyword of the input file), see manybody.c
+ */
+typedef enum
+{
+    MB_NONE=0,      ///< the potential is not a many-body one
+    MB_GUPTA,       ///< Gupta, i.e. second moment approximation of the tight binding
+    MB_SC           ///< Sutton-Chen
+} MANYBODY_KIND;
+
+/**
+ * @brief Species known by the Aziz potential ; the atomic symbols are resolved to it once, see build_AZIZ_table in ener.c
+ */
+typedef enum
+{
+    AZ_NE=0,        ///< neon
+    AZ_AR=1         ///< argon
+} AZIZ_SPECIES;
+
+/**
+ * @brief Constants of the HFD-B form of the Aziz potential for one pair of species ;
+ *          r_m is in angstroems and epsi in cm-1
+ */
+typedef struct
+{
+    double a_s, alpha_s, beta_s;
+    double c_6, c_8, c_10, c_12;
+    double d, epsi, r_m;
+} AZIZ_PARAMS;
+
 /**
  * @brief This structure holds useful variables used across the simulations,
  * it is almost always transmitted from one function to another one .
@@ -90,7 +162,6 @@ typedef struct
 
     double inid ;       ///< An initial distance term used when randomly assigning coordinates to atoms when generating a cluster
     double T ;          ///< Temperature : in reduced units, or kcal/mol if charmm_units is 1
-    double E_constr;    ///< An energy constraints for avoiding "cluster evaporation" : avoids that atoms go to far from each other : see ener.c for details
     double E_steepD;    ///< A threshold at which starting Steepest Descent minimisation
     double E_expected;  ///< Expected best energy minima of the cluster currently studied ; usually taken from http://www-wales.ch.cam.ac.uk/CCD.html
     double beta;        ///< the inverse temperature used in acceptance criterion
@@ -101,6 +172,44 @@ typedef struct
 #endif
     uint32_t nrn ;      ///< a counter to know how many random numbers from the rn array we have used
     double *rn ;        ///< to avoid calling too often dSFMT, numbers are "cached" i.e. stored in an array ; see rand.c and rand.h
+
+    uint32_t ntypes;    ///< Number of atomic species (one per LJPARAMS record or unknown atomic symbol)
+    LJPARAMS *ljp;      ///< LJPARAMS array of size ntypes, indexed by the species index ATOM::type
+    double *lj_c12;     ///< ntypes*ntypes table of the mixed 4*eps*sig^12 terms ; see build_LJ_table in ener.c
+    double *lj_c6;      ///< ntypes*ntypes table of the mixed 4*eps*sig^6 terms ; see build_LJ_table in ener.c
+    float *lj_c12f;     ///< float copy of lj_c12, for the mixed precision kernels
+    float *lj_c6f;      ///< float copy of lj_c6, for the mixed precision kernels
+    PRECISION_MODE precision;   ///< precision of the L-J energy kernels
+    uint32_t early_rej;         ///< with METHOD METROP EARLY, number of nearest neighbours visited for rejecting a move early ; 0 if disabled
+    uint32_t det_sum;           ///< 1 if the energies are summed in an order independent of the number of threads (REDUCTION DETERMINISTIC)
+    uint32_t n_move;            ///< number of atoms moved together at each Metropolis step (MOVE NATOMS), 1 by default
+    uint32_t n_move_rand;       ///< 1 if the number of atoms moved at each step is drawn between 1 and n_move
+    uint32_t n_spec;            ///< with METHOD METROP SPECULATIVE, number of trial moves evaluated together ; 1 otherwise
+
+    uint32_t pt_nrep;       ///< with METHOD PTMC, number of replicas i.e. of temperatures, from T to pt_tmax ; see MCptmc.c
+    double pt_tmax;         ///< highest temperature of the ladder
+    uint32_t pt_exch;       ///< number of steps between two attempts of exchanging the neighbour replicas
+
+    uint32_t n_walkers;     ///< number of independent Metropolis chains run in one process (WALKERS), 1 by default ; see MCwalkers.c
+
+    CUTOFF_MODE cut_mode;   ///< if and how the L-J potential is cut ; with a cutoff the energy uses cell lists, see cells.c
+    double cutoff;          ///< cutoff distance
+    double cuton;           ///< distance at which the switching function starts (CUT_SWITCH only)
+    double *lj_shift;       ///< ntypes*ntypes table of the L-J energy at the cutoff (CUT_SHIFT only), NULL otherwise
+    double skin;            ///< skin distance of the Verlet lists (VERLET keyword), 0 if they are not used ; see nlist.c
+
+    AZIZ_SPECIES *aziz_sp;      ///< Aziz species of each species index ATOM::type, NULL if the Aziz potential is not used
+    const AZIZ_PARAMS **aziz;   ///< ntypes*ntypes table of the HFD-B constants of each pair of species ; see build_AZIZ_table in ener.c
+
+    TABLE_SOURCE tab_src;   ///< pair potential sampled by the tabulated potential, TAB_NONE if not used ; see table.c
+    uint32_t tab_points;    ///< number of points of the tables (TABLE keyword), 0 for the default
+    double tab_rmin;        ///< shortest distance of the tables, 0 for the default of the sampled potential
+    double tab_rmax;        ///< longest distance of the tables, pairs further apart are ignored ; 0 for the default
+
+    MANYBODY_KIND mb_kind;  ///< many-body potential in use, MB_NONE if none ; see manybody.c
+
+    uint32_t threebody;     ///< 1 if the Axilrod-Teller three-body term is added to the potential (THREEBODY keyword) ; see threebody.c
+    double tb_cutoff;       ///< only the triplets whose three sides are shorter are summed, 0 for all the triplets
 } DATA;
 
 /**
@@ -116,17 +225,6 @@ typedef struct
     uint32_t normalSize;    ///< a counter to know how many random numbers from the normalNumbs array we have used
 } SPDAT;
 
-/**
- * @brief A structure holding the Lennard-Jones parameters
- * See http://www.sklogwiki.org/SklogWiki/index.php/Lennard-Jones_model
- */
-typedef struct
-{
-    char sym[4];    ///< atomic symbol
-    double sig ;    ///< L-J sigma parameter
-    double eps ;    ///< L-J epsilon parameter
-} LJPARAMS;
-
 /**
  * @brief A structure representing an atom
  */
@@ -136,9 +234,78 @@ typedef struct
     double y;   ///< Y coordinate
     double z;   ///< Z coordinate
     char sym[4] ;   ///< atomic symbol
+    uint32_t type;  ///< species index, i.e. index of this atom's LJPARAMS in DATA::ljp
     LJPARAMS ljp;    ///< substructure containing LJ parameters
 } ATOM;
 
+/**
+ * @brief A grid of cubic-like cells of side larger than the cutoff, each one holding a linked list of the atoms it contains,
+ *          so that the neighbours of an atom within the cutoff are all in the 27 surrounding cells. See cells.c
+ */
+typedef struct
+{
+    double rc;              ///< minimal side of a cell, i.e. the cutoff
+    double ox,oy,oz;        ///< lower corner of the grid
+    double ix,iy,iz;        ///< inverse of the side of a cell along each direction
+    uint32_t nx,ny,nz;      ///< number of cells along each direction
+    uint32_t ncell;         ///< nx*ny*nz
+    uint32_t maxcell;       ///< allocated size of head
+    int32_t *head;          ///< first atom of each cell, -1 if empty
+    int32_t *next;          ///< next atom of the same cell, -1 for the last one
+    int32_t *prev;          ///< previous atom of the same cell, -1 for the first one
+    uint32_t *cell;         ///< cell of each atom
+    uint64_t nbuild;        ///< number of times the grid was (re)built
+} CELLS;
+
+/**
+ * @brief Verlet neighbour lists : for each atom the atoms closer than rc+skin when the lists were built.
+ *          They stay valid as long as no atom moved by more than skin/2 since then. See nlist.c
+ */
+typedef struct
+{
+    double rc;              ///< cutoff of the potential
+    double skin;            ///< skin distance
+    double *x0,*y0,*z0;     ///< positions of the atoms when the lists were built
+    uint32_t *start;        ///< the neighbours of atom i are nb[start[i]] to nb[start[i+1]-1] ...
+    uint32_t *half;         ///< ... the ones with j>i coming first, up to nb[half[i]-1]
+    uint32_t *nb;           ///< concatenated lists
+    uint64_t size;          ///< allocated size of nb
+    uint8_t *far;           ///< 1 for the atoms which moved by more than skin/2 since the build
+    uint32_t nfar;          ///< number of such atoms : the lists can only be used when it is 0
+    uint64_t stamp;         ///< unique identifier of the build, so that identical lists are not copied again
+    uint64_t nbuild;        ///< number of times the lists of this coordinates store were built, not counting the copies
+} NLIST;
+
+/**
+ * @brief Densities of the atoms for the many-body potentials, i.e. for each atom the sum of the density functions
+ *          of all the other ones. See manybody.c
+ */
+typedef struct
+{
+    double *rho;            ///< density at each atom
+} DENSITY;
+
+/**
+ * @brief A structure of arrays storing the coordinates used by the energy, moves and minimisation loops.
+ *
+ * Compared to an array of ATOM, only the data touched by the pair loops is stored, and each array is
+ * contiguous and aligned (see coords.c) so that those loops can be vectorised.
+ * The ATOM array is still used as a view of the system for I/O and by the Lua FFI plugins.
+ */
+typedef struct
+{
+    uint32_t natom;     ///< Number of atoms
+    double *x;          ///< X coordinates
+    double *y;          ///< Y coordinates
+    double *z;          ///< Z coordinates
+    uint32_t *type;     ///< species index of each atom, see ATOM::type
+    double sx,sy,sz;    ///< sums of the X,Y,Z coordinates, maintained by the functions of coords.c for an O(1) center of mass
+    CELLS *cells;       ///< optional cell grid, maintained by the functions of coords.c ; NULL if there is no cutoff
+    NLIST *nlist;       ///< optional Verlet lists, maintained by the functions of coords.c ; NULL if not used
+    DENSITY *dens;      ///< optional densities of the many-body potentials, maintained by the functions of coords.c ; NULL if not used
+    float *xf,*yf,*zf;  ///< optional single precision copies of X,Y,Z for PRECISION MIXED, maintained by the functions of coords.c ; NULL if not used
+} COORDS;
+
 /**
  * @brief A structure representing the center of mass of a system, simply a point in
  * a 3-Dim space
@@ -148,4 +315,14 @@ typedef struct
     double cx,cy,cz;
 } CM;
 
+/**
+ * @brief The result of an energy evaluation : the pair energy, and the energy of the constraint avoiding
+ * "cluster evaporation", i.e. atoms going too far from the center of mass (see getExtraPot in ener.c)
+ */
+typedef struct
+{
+    double pair;        ///< pair (interaction) energy
+    double constr;      ///< constraint energy, 0 if the potential has no constraint
+} ENERGY;
+
 #endif // GLOBAL_H_INCLUDED
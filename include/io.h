@@ -46,13 +46,20 @@ extern FILE *crdfile;
 extern FILE *traj;
 extern FILE *efile;
 
-//pointer to the desired IO function
-void (*write_traj)(ATOM at[], DATA *dat, uint64_t when);
+//pointer to the desired IO function, defined in main.c
+extern void (*write_traj)(ATOM at[], DATA *dat, uint64_t when);
 
 //read or write coordinates or trajectory files
 void read_xyz(ATOM at[], DATA *dat, FILE *inpf);
 void write_xyz(ATOM at[], DATA *dat, uint64_t when, FILE *outf);
 void write_dcd(ATOM at[], DATA *dat, uint64_t when);
+void write_dcd_frame(ATOM at[], DATA *dat, FILE *outf, uint32_t header);
+
+// name of the output file of a replica or walker, path with _r inserted before its extension
+void indexed_path(char out[FILENAME_MAX], const char *path, uint32_t r);
+
+// open the output file of a replica or walker, exits on failure
+FILE* open_indexed(const char *path, uint32_t r, const char *mode);
 
 // BUG : restart file 
 void write_rst(ATOM at[], DATA *dat, SPDAT *spdat, uint32_t meth);
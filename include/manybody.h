@@ -0,0 +1,47 @@
+/**
+ * \file manybody.h
+ *
+ * \brief Header file for manybody.c
+ *
+ * \authors Florent Hedin (University of Basel, Switzerland) \n
+ *          Markus Meuwly (University of Basel, Switzerland)
+ *
+ * \copyright Copyright (c) 2011-2015, Florent Hédin, Markus Meuwly, and the University of Basel. \n
+ *            All rights reserved. \n
+ *            The 3-clause BSD license is applied to this software. \n
+ *            See LICENSE.txt
+ *
+ */
+
+#ifndef MANYBODY_H_INCLUDED
+#define MANYBODY_H_INCLUDED
+
+/*
+ * for converting the parameters of the many-body potentials
+ */
+#define EVTOKCAL    23.060548   // 1 eV in kcal/mol
+
+/// parameters given in the input file (GUPTAPARAMS or SCPARAMS), used instead of the built-in ones
+void set_MB_params(MANYBODY_KIND kind, const char *sym, const double par[5]);
+
+/// resolve the parameters of each species and mix them for each pair of species, or free them
+void build_MB_table(DATA *dat);
+void free_MB_table();
+
+/// allocate, build or free the densities attached to a coordinates store
+void alloc_density(COORDS *crd);
+void free_density(COORDS *crd);
+void build_density(COORDS *crd);
+
+/// update the densities after atom i moved from (xo,yo,zo)
+void move_density(COORDS *crd, uint32_t i, double xo, double yo, double zo);
+
+/// copy the densities to another coordinates store with the same atoms
+void copy_density(COORDS *dst, const COORDS *src);
+
+// ener and force from the many-body potentials
+ENERGY get_MB_V(const COORDS *crd, const DATA *dat, int32_t candidate);
+void get_MB_DV(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[]);
+ENERGY get_MB_V_DV(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[]);
+
+#endif // MANYBODY_H_INCLUDED
@@ -19,7 +19,7 @@
 void alloc_minim(DATA *dat);
 void dealloc_minim();
 
-void steepd(ATOM at[],DATA *dat);
+void steepd(COORDS *crd,DATA *dat);
 // void steepd_ini(ATOM at[],DATA *dat);
 void adjust_alpha(const uint32_t natom, const double grad_old[], const double grad_new[], double *alpha);
 
@@ -0,0 +1,41 @@
+/**
+ * \file nlist.h
+ *
+ * \brief Header file for nlist.c
+ *
+ * \authors Florent Hedin (University of Basel, Switzerland) \n
+ *          Markus Meuwly (University of Basel, Switzerland)
+ *
+ * \copyright Copyright (c) 2011-2015, Florent Hédin, Markus Meuwly, and the University of Basel. \n
+ *            All rights reserved. \n
+ *            The 3-clause BSD license is applied to this software. \n
+ *            See LICENSE.txt
+ *
+ */
+
+#ifndef NLIST_H_INCLUDED
+#define NLIST_H_INCLUDED
+
+/*
+ * Initial number of neighbours allocated per atom ; the lists grow if needed
+ * Can be redefined when compiling
+ */
+#ifndef NLIST_NB_PER_ATOM
+#define NLIST_NB_PER_ATOM   64
+#endif
+
+/// allocate, build or free the Verlet lists attached to a coordinates store
+void alloc_nlist(COORDS *crd, double rc, double skin);
+void free_nlist(COORDS *crd);
+void build_nlist(COORDS *crd);
+
+/// check how far atom i moved since the lists were built
+void move_nlist(COORDS *crd, uint32_t i);
+
+/// check all the atoms, and rebuild the lists if one of them moved too far
+void refresh_nlist(COORDS *crd);
+
+/// copy the lists to another coordinates store with the same atoms
+void copy_nlist(COORDS *dst, COORDS *src);
+
+#endif // NLIST_H_INCLUDED
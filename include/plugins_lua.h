@@ -27,7 +27,8 @@ typedef enum
 typedef enum
 {
     POTENTIAL=0,
-    GRADIENT=1
+    GRADIENT=1,
+    ENERGY_GRADIENT=2
 }LUA_FUNCTION_TYPE;
 
 extern LUA_PLUGIN_TYPE lua_plugin_type;
@@ -52,11 +53,13 @@ void init_lua(char *plugin_file_name);
 void register_lua_function(char *plugin_function_name, LUA_FUNCTION_TYPE type);
 void end_lua();
 
-double get_lua_V(ATOM at[], DATA *dat, int32_t candidate);
-void get_lua_DV(ATOM at[], DATA *dat, double fx[], double fy[], double fz[]);
+ENERGY get_lua_V(const COORDS *crd, const DATA *dat, int32_t candidate);
+void get_lua_DV(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[]);
+double get_lua_pair_dv(double r, LJPARAMS *pi, LJPARAMS *pj, double *dv);
 
-double get_lua_V_ffi(ATOM at[], DATA *dat, int32_t candidate);
-void get_lua_DV_ffi(ATOM at[], DATA *dat, double fx[], double fy[], double fz[]);
+ENERGY get_lua_V_ffi(const COORDS *crd, const DATA *dat, int32_t candidate);
+void get_lua_DV_ffi(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[]);
+ENERGY get_lua_V_DV_ffi(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[]);
 
 #endif //LUA_PLUGINS
 
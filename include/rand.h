@@ -19,6 +19,18 @@
 /// get a uniformly distributed random number 
 double get_next(DATA *dat);
 
+/*
+ * Number of 32 bits integers drawn from the main generator for seeding the one of a replica
+ * Can be redefined when compiling
+ */
+#ifndef RAND_STREAM_KEY
+#define RAND_STREAM_KEY 8
+#endif
+
+/// give a copy of the common data its own random numbers stream, derived from another one
+void init_rand_stream(DATA *dst, DATA *src);
+void free_rand_stream(DATA *dat);
+
 /// get a normally distributed random number
 double get_BoxMuller(DATA *dat, SPDAT *spdat);
 
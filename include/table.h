@@ -0,0 +1,40 @@
+/**
+ * \file table.h
+ *
+ * \brief Header file for table.c
+ *
+ * \authors Florent Hedin (University of Basel, Switzerland) \n
+ *          Markus Meuwly (University of Basel, Switzerland)
+ *
+ * \copyright Copyright (c) 2011-2015, Florent Hédin, Markus Meuwly, and the University of Basel. \n
+ *            All rights reserved. \n
+ *            The 3-clause BSD license is applied to this software. \n
+ *            See LICENSE.txt
+ *
+ */
+
+#ifndef TABLE_H_INCLUDED
+#define TABLE_H_INCLUDED
+
+/*
+ * Default number of intervals of the table of each pair of species
+ * Can be redefined when compiling
+ */
+#ifndef TABLE_POINTS
+#define TABLE_POINTS    4096
+#endif
+
+/// sample the selected pair potential, or free the tables
+void alloc_pair_table(DATA *dat);
+void free_pair_table();
+
+/// print the resolution and interpolation error of the tables to stdout
+void print_pair_table(DATA *dat);
+
+// ener and force from the tabulated potential
+ENERGY get_TAB_V(const COORDS *crd, const DATA *dat, int32_t candidate);
+double get_TAB_V_row(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[]);
+void get_TAB_DV(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[]);
+ENERGY get_TAB_V_DV(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[]);
+
+#endif // TABLE_H_INCLUDED
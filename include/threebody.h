@@ -0,0 +1,52 @@
+/**
+ * \file threebody.h
+ *
+ * \brief Header file for threebody.c
+ *
+ * \authors Florent Hedin (University of Basel, Switzerland) \n
+ *          Markus Meuwly (University of Basel, Switzerland)
+ *
+ * \copyright Copyright (c) 2011-2015, Florent Hédin, Markus Meuwly, and the University of Basel. \n
+ *            All rights reserved. \n
+ *            The 3-clause BSD license is applied to this software. \n
+ *            See LICENSE.txt
+ *
+ */
+
+#ifndef THREEBODY_H_INCLUDED
+#define THREEBODY_H_INCLUDED
+
+/*
+ * for converting the built-in triple-dipole constants from atomic units to kcal/mol and angstroems
+ */
+#define HARTREETOKCAL   627.509474      // 1 hartree in kcal/mol
+#define BOHRTOANG       0.529177211     // 1 bohr in angstroems
+
+/*
+ * Minimum number of atoms for distributing the triplets of one evaluation over the OpenMP threads
+ * Can be redefined when compiling
+ */
+#ifndef TB_OMP_MIN
+#define TB_OMP_MIN  128
+#endif
+
+/// triple-dipole constant given in the input file (THREEBODY NU), used for all the triplets instead of the built-in ones
+void set_3B_nu(double nu);
+
+/// resolve the triple-dipole constant of each triplet of species, or free them
+void build_3B_table(DATA *dat);
+void free_3B_table();
+
+/// three-body energy of the whole system (candidate=-1) or of the triplets containing the candidate
+double get_3B_V(const COORDS *crd, const DATA *dat, int32_t candidate);
+
+/// change of the three-body energy when the candidate moves from its position in crd to the one in crd_new
+double get_3B_diff(const COORDS *crd, const COORDS *crd_new, const DATA *dat, uint32_t candidate);
+
+/// three-body energy of the whole system, its gradient being added to fx,fy,fz
+double get_3B_DV(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[]);
+
+/// cpu time spent in the three-body term, in seconds
+double get_3B_time();
+
+#endif // THREEBODY_H_INCLUDED
@@ -32,6 +32,7 @@ ffi.cdef[[
     {
         double x,y,z;
         char sym[4];
+        uint32_t type;
         LJPARAMS ljp;
     } ATOM;
     ]]
@@ -162,3 +163,54 @@ function lj_dv_n_m_ffi(natom, at_list, fx, fy, fz)
 end
 
 
+-- Optional : energy of the whole system and gradient in a single loop over the pairs
+function lj_vdv_n_m_ffi(natom, at_list, fx, fy, fz)
+    
+    local at  = ffi.new("ATOM*",at_list)
+    
+    local lfx = ffi.new("double*",fx)
+    local lfy = ffi.new("double*",fy)
+    local lfz = ffi.new("double*",fz)
+    
+    local i,j
+    local ener = 0.0
+    
+    for i=0,natom-1
+    do
+        lfx[i] = 0.0 ;
+        lfy[i] = 0.0 ;
+        lfz[i] = 0.0 ;
+    end
+    
+    for i=0,natom-1
+    do
+        for j=i+1,natom-1
+        do
+            local dx= at[i].x - at[j].x
+            local dy= at[i].y - at[j].y
+            local dz= at[i].z - at[j].z
+            
+            local eps = math.sqrt( at[i].ljp.eps * at[j].ljp.eps )
+            local sig = 0.5*( at[i].ljp.sig + at[j].ljp.sig )
+            local r2 = dx^2 + dy^2 + dz^2
+            local r  = math.sqrt(r2)
+            
+            local sn = math.pow(sig/r,n)
+            local sm = math.pow(sig/r,m)
+            
+            ener = ener + c*eps*(sn-sm)
+            
+            -- the force of the pair is applied to both atoms
+            local dv = -c*eps*( n*sn - m*sm )/r2
+            lfx[i] = lfx[i] + dv*dx
+            lfy[i] = lfy[i] + dv*dy
+            lfz[i] = lfz[i] + dv*dz
+            lfx[j] = lfx[j] - dv*dx
+            lfy[j] = lfy[j] - dv*dy
+            lfz[j] = lfz[j] - dv*dz
+        end
+    end
+    
+    return ener
+    
+end
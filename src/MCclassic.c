@@ -20,10 +20,15 @@
 #include <time.h>
 
 #include "global.h"
+#include "coords.h"
+#include "cells.h"
+#include "nlist.h"
+#include "manybody.h"
+#include "threebody.h"
+#include "ener.h"
 #include "MCclassic.h"
 #include "tools.h"
 #include "rand.h"
-#include "ener.h"
 #include "minim.h"
 #include "io.h"
 #include "logger.h"
@@ -39,116 +44,435 @@
  */
 #define MV_REJ -1
 
+static void get_move_diff(COORDS *crd, COORDS *crd_new, DATA *dat, int32_t candidate, ECACHE *cache, double row[],
+                          double *enew, double *ediff, double *econstr);
+static int32_t apply_Metrop_multi(COORDS *crd, COORDS *crd_new, DATA *dat, int32_t *ismoving, uint32_t n_moving,
+                                  double dr[], double *ener, ECACHE *cache, double rows[], double enews[]);
+
 /**
- * @brief This is the core function for Metropolis MC simulation 
- *        where the main loop is located, 
- * 
- * @param at Atom list
+ * @brief Allocates the working data of a Metropolis chain on the coordinates crd : the trial copy of the coordinates,
+ *          with the same cell grid, Verlet lists and densities, and the energy cache and early rejection lists if used
+ *
+ * @param ch The chain
+ * @param crd Coordinates of the chain
  * @param dat Common data
- * @param ener Variable containing total energy of the system
- * 
- * @return The number of moves accepted
  */
-uint64_t make_MC_moves(ATOM at[], DATA *dat, double *ener)
+void alloc_MC_chain(MC_CHAIN *ch, COORDS *crd, DATA *dat)
 {
-    uint32_t /*i,*/j,k;
-    uint64_t st, acc=0, acc2=0;
-    int32_t accParam=0;
+    clone_coords(&ch->crd_new,crd);
+
+    ch->name[0]='\0';
+    ch->ismoving=calloc(dat->natom,sizeof *ch->ismoving);
+    ch->dr=calloc(3*dat->n_move,sizeof *ch->dr);
+    ch->rows=NULL;
+    ch->enews=NULL;
+    ch->cache=NULL;
+    ch->early=NULL;
+
+    if (get_ENER_ROW != NULL)
+    {
+        alloc_ecache(&ch->ecache,crd,dat);
+        ch->cache = &ch->ecache;
+        if (dat->n_move > 1)
+        {
+            ch->rows=calloc((size_t)dat->n_move*dat->natom,sizeof *ch->rows);
+            ch->enews=calloc(dat->n_move,sizeof *ch->enews);
+        }
+    }
 
-    // a copy of the atom list
-    ATOM *at_new;
+    if (dat->early_rej != 0)
+    {
+        alloc_early(&ch->early_rej,crd,dat);
+        ch->early = &ch->early_rej;
+    }
+
+    ch->spec=NULL;
+    if (dat->n_spec > 1)
+    {
+        SPEC_MOVES *sp = &ch->spec_moves;
+        uint32_t k;
+
+        sp->n = dat->n_spec;
+        sp->trial = calloc(sp->n,sizeof *sp->trial);
+        sp->trial[0] = &ch->crd_new;
+        for (k=1; k<sp->n; k++)
+        {
+            sp->trial[k] = malloc(sizeof(COORDS));
+            clone_coords(sp->trial[k],crd);
+        }
+        sp->cand = calloc(sp->n,sizeof *sp->cand);
+        sp->dr = calloc(3*sp->n,sizeof *sp->dr);
+        sp->ediff = calloc(sp->n,sizeof *sp->ediff);
+        sp->econstr = calloc(sp->n,sizeof *sp->econstr);
+        sp->enew = calloc(sp->n,sizeof *sp->enew);
+        sp->rows = (ch->cache != NULL) ? calloc((size_t)sp->n*dat->natom,sizeof *sp->rows) : NULL;
+        sp->rn = calloc(SPEC_RN*sp->n,sizeof *sp->rn);
+        sp->nrn = 0;
+        ch->spec = sp;
+    }
+}
+
+void free_MC_chain(MC_CHAIN *ch)
+{
+    free_coords(&ch->crd_new);
+    free(ch->ismoving);
+    free(ch->dr);
+    free(ch->rows);
+    free(ch->enews);
+    if (ch->cache != NULL)
+        free_ecache(ch->cache);
+    if (ch->early != NULL)
+        free_early(ch->early);
+    if (ch->spec != NULL)
+    {
+        SPEC_MOVES *sp = ch->spec;
+        uint32_t k;
+
+        for (k=1; k<sp->n; k++)
+        {
+            free_coords(sp->trial[k]);
+            free(sp->trial[k]);
+        }
+        free(sp->trial);
+        free(sp->cand);
+        free(sp->dr);
+        free(sp->ediff);
+        free(sp->econstr);
+        free(sp->enew);
+        free(sp->rows);
+        free(sp->rn);
+    }
+}
+
+/**
+ * @brief One Metropolis step of a chain : the moving atom(s) are chosen and displaced in the trial copy, and the move
+ *          is either placed in crd or undone in the copy, which is identical to crd again on return
+ *
+ * @param ch The chain
+ * @param crd Coordinates of the chain
+ * @param dat Common data, for the temperature, dmax and random numbers of the chain
+ * @param ener Energy of the chain, updated if the move is accepted
+ * @param st The current step
+ *
+ * @return 1 if the move was accepted, 0 otherwise
+ */
+uint32_t make_MC_step(MC_CHAIN *ch, COORDS *crd, DATA *dat, double *ener, uint64_t st)
+{
+    uint32_t j,k;
+    int32_t accParam=0;
+    int32_t *ismoving = ch->ismoving;
+    double *dr = ch->dr;
 
     //the candidate moving atom
     int32_t candidate =-1;
     //number of simultaneously moving atoms
-    uint32_t n_moving = 1;
-    //a list of moving atoms
-    int32_t *ismoving = NULL;
+    uint32_t n_moving = dat->n_move;
     //move direction : 0=x 1=y 2=z -1=all
     int32_t mv_direction= -1;
 
     double randvec[3] = {0.0,0.0,0.0};
 
-    at_new=malloc(dat->natom*sizeof *at_new);
-    ismoving=calloc(dat->natom,sizeof *ismoving);
+    LOG_PRINT(LOG_DEBUG,"----------------------"
+              " STEP %"PRIu64" ----------------------\n",st);
 
-    // main iteration over all steps
-    for (st=1; st<=(dat->nsteps); st++) //main loop
+    // choose how many atoms will move at this step
+    if (dat->n_move_rand)
+        n_moving = (uint32_t) (dat->n_move*get_next(dat)) + 1;
+
+    // randomly choose atom(s) moving at this step
+    j=0;
+    do
     {
+        uint32_t redundant=0;
+        candidate = (int32_t) (dat->natom*get_next(dat));
+        for(k=0; k<j; k++)
+        {
+            if (ismoving[k]==candidate)
+            {
+                redundant=1;
+                break;
+            }
+        }
+        if(redundant)
+            continue;
+        else
+        {
+            ismoving[j] = candidate;
+            j++;
+        }
+    }
+    while(j<n_moving);
 
-        LOG_PRINT(LOG_DEBUG,"----------------------"
-                  " STEP %"PRIu64" ----------------------\n",st);
+    LOG_PRINT(LOG_DEBUG,"%d atoms moving for step %"PRIu64" --> ",n_moving,st);
+    for (j=0; j<n_moving; j++)
+        LOG_PRINT_SHORT(LOG_DEBUG,"%d ",ismoving[j]);
+    LOG_PRINT_SHORT(LOG_DEBUG,"\n");
 
-        for (j=0; j<(dat->natom); j++)
-            memcpy(&at_new[j],&at[j],sizeof(ATOM));
+    //draw random moves for the moving atoms
+    k=0;
+    do
+    {
+        //uncomment if anisotropic moves required (i.e. in only one direction)
+//        mv_direction = (int)3*get_next(dat);
+        get_vector(dat,mv_direction,randvec);
+
+        dr[3*k]   = (dat->d_max)*randvec[0];
+        dr[3*k+1] = (dat->d_max)*randvec[1];
+        dr[3*k+2] = (dat->d_max)*randvec[2];
+        k++;
+    }
+    while(k<n_moving);
 
-        // choose how many atoms will move at this step
-//         n_moving=(int) dat->natom*get_next(dat) + 1;
+    //apply them and get acceptance criterion ; with several atoms they are applied one by one while evaluating
+    if (n_moving == 1)
+    {
+        move_atom_coords(&ch->crd_new,(uint32_t)ismoving[0],dr[0],dr[1],dr[2]);
+        accParam=apply_Metrop(crd,&ch->crd_new,dat,&ismoving[0],ener,&st,ch->cache,ch->early);
+    }
+    else
+        accParam=apply_Metrop_multi(crd,&ch->crd_new,dat,ismoving,n_moving,dr,ener,ch->cache,ch->rows,ch->enews);
 
-        // randomly choose atom(s) moving at this step
-        j=0;
+    //if accepted copy new coordinates of the moving atom(s)
+    if (accParam == MV_ACC)
+    {
+        k=0;
         do
         {
-            uint32_t redundant=0;
-            candidate = (int32_t) (dat->natom*get_next(dat));
-            for(k=0; k<j; k++)
-            {
-                if (ismoving[k]==candidate)
-                {
-                    redundant=1;
-                    break;
-                }
-            }
-            if(redundant)
-                continue;
-            else
-            {
-                ismoving[j] = candidate;
-                j++;
-            }
+            j = (uint32_t) ismoving[k];
+            // the cache needs the coordinates before the move of each atom
+            if (ch->cache != NULL && n_moving == 1)
+                update_ecache(ch->cache,crd,dat,j,ch->cache->row,ch->cache->enew);
+            else if (ch->cache != NULL)
+                update_ecache(ch->cache,crd,dat,j,ch->rows+(size_t)k*dat->natom,ch->enews[k]);
+            set_atom_coords(crd,j,ch->crd_new.x[j],ch->crd_new.y[j],ch->crd_new.z[j]);
+            k++;
         }
-        while(j<n_moving);
-
-        LOG_PRINT(LOG_DEBUG,"%d atoms moving for step %"PRIu64" --> ",n_moving,st);
-        for (j=0; j<n_moving; j++)
-            LOG_PRINT_SHORT(LOG_DEBUG,"%d ",ismoving[j]);
-        LOG_PRINT_SHORT(LOG_DEBUG,"\n");
-
-        //apply random moves to moving atoms
+        while(k<n_moving);
+    }
+    //otherwise only the moving atom(s) are put back in the copy, instead of copying the whole system each step
+    else
+    {
         k=0;
         do
         {
             j = (uint32_t) ismoving[k];
-            //uncomment if anisotropic moves required (i.e. in only one direction)
-//            mv_direction = (int)3*get_next(dat);
-            get_vector(dat,mv_direction,randvec);
-
-            at_new[j].x += (dat->d_max)*randvec[0] ;
-            at_new[j].y += (dat->d_max)*randvec[1] ;
-            at_new[j].z += (dat->d_max)*randvec[2] ;
+            revert_atom_coords(&ch->crd_new,crd,j);
             k++;
         }
         while(k<n_moving);
+    }
+    sync_coords(&ch->crd_new,crd);
 
-        //get acceptance criterion
-        accParam=apply_Metrop(at,at_new,dat,&ismoving[0],ener,&st);
+    return (accParam == MV_ACC);
+}
+
+/**
+ * @brief Up to nmax Metropolis steps of a chain made together (METHOD METROP SPECULATIVE) : a trial move is drawn for
+ *          each step as if all the previous ones were rejected, the moves are evaluated concurrently against the same
+ *          state, and the first accepted one in the order of the steps is placed in crd, the later ones being discarded.
+ *          A rejected move always draws SPEC_RN random numbers, so that the chain is the same as the one of make_MC_step.
+ *
+ * @param ch The chain
+ * @param crd Coordinates of the chain
+ * @param dat Common data, for the temperature, dmax and random numbers of the chain
+ * @param ener Energy of the chain, updated if a move is accepted
+ * @param nmax Maximum number of steps
+ * @param accepted Set to 1 if the last step done was accepted, 0 otherwise
+ *
+ * @return The number of steps done : up to the accepted one, or nmax
+ */
+uint32_t make_MC_spec_steps(MC_CHAIN *ch, COORDS *crd, DATA *dat, double *ener, uint32_t nmax, uint32_t *accepted)
+{
+    SPEC_MOVES *sp = ch->spec;
+    const uint32_t n = (nmax < sp->n) ? nmax : sp->n;
+    const size_t natom = dat->natom;
+    uint32_t k, j, used;
+    int32_t first = -1;
+    double *rn = NULL;
+
+    // the random numbers of the n steps, the ones not used being kept for the next call
+    while (sp->nrn < SPEC_RN*n)
+        sp->rn[sp->nrn++] = get_next(dat);
+
+    // the same draws as make_MC_step
+    for (k=0; k<n; k++)
+    {
+        rn = sp->rn + SPEC_RN*k;
+        sp->cand[k] = (uint32_t) (int32_t) (dat->natom*rn[0]);
+        sp->dr[3*k]   = (dat->d_max)*(2.*rn[1]-1.);
+        sp->dr[3*k+1] = (dat->d_max)*(2.*rn[2]-1.);
+        sp->dr[3*k+2] = (dat->d_max)*(2.*rn[3]-1.);
+    }
+
+#ifdef _OPENMP
+    // one trial move per thread, each evaluation being then sequential
+    #pragma omp parallel for schedule(static,1) if(n > 1)
+#endif
+    for (k=0; k<n; k++)
+    {
+        move_atom_coords(sp->trial[k],sp->cand[k],sp->dr[3*k],sp->dr[3*k+1],sp->dr[3*k+2]);
+        get_move_diff(crd,sp->trial[k],dat,(int32_t)sp->cand[k],ch->cache,(sp->rows != NULL) ? sp->rows+k*natom : NULL,
+                      &sp->enew[k],&sp->ediff[k],&sp->econstr[k]);
+    }
 
-        //if accepted
-        if (accParam == MV_ACC)
+    // the same test as apply_Metrop, in the order of the steps
+    used = SPEC_RN*n;
+    for (k=0; k<n; k++)
+    {
+        if ( (sp->ediff[k] + sp->econstr[k]) < 0.0 )
+        {
+            first = (int32_t) k;
+            used = SPEC_RN*k + SPEC_RN - 1;
+            break;
+        }
+        else if (sp->rn[SPEC_RN*k+SPEC_RN-1] < exp(-dat->beta*(sp->ediff[k] + sp->econstr[k])))
+        {
+            first = (int32_t) k;
+            used = SPEC_RN*k + SPEC_RN;
+            break;
+        }
+    }
+    sp->nrn -= used;
+    memmove(sp->rn,sp->rn+used,sp->nrn*sizeof *sp->rn);
+
+    // the other moves are undone, and the accepted one is also made in all the other copies
+    for (k=0; k<n; k++)
+        if ((int32_t)k != first)
+            revert_atom_coords(sp->trial[k],crd,sp->cand[k]);
+
+    if (first >= 0)
+    {
+        j = sp->cand[first];
+        *ener += sp->ediff[first];
+        if (ch->cache != NULL)
+            update_ecache(ch->cache,crd,dat,j,sp->rows+first*natom,sp->enew[first]);
+        set_atom_coords(crd,j,sp->trial[first]->x[j],sp->trial[first]->y[j],sp->trial[first]->z[j]);
+
+        for (k=0; k<sp->n; k++)
+            if ((int32_t)k != first)
+                move_atom_coords(sp->trial[k],j,sp->dr[3*first],sp->dr[3*first+1],sp->dr[3*first+2]);
+    }
+
+    for (k=0; k<sp->n; k++)
+        sync_coords(sp->trial[k],crd);
+
+    *accepted = (first >= 0);
+
+    return (first >= 0) ? (uint32_t) first + 1 : n;
+}
+
+/**
+ * @brief Removes the rounding errors accumulated by the O(1) updates of the coordinates sums and of the energy cache,
+ *          by recomputing them from scratch, and refreshes the early rejection lists ; the trial copy is then copied
+ *          from crd. With the mixed precision kernels the running energy is also checked here.
+ *
+ * @param ch The chain
+ * @param crd Coordinates of the chain
+ * @param dat Common data
+ * @param st The current step
+ * @param ener Energy of the chain
+ */
+void refresh_MC_chain(MC_CHAIN *ch, COORDS *crd, DATA *dat, uint64_t st, double *ener)
+{
+    refresh_coords(crd);
+    if (ch->cache != NULL)
+        build_ecache(ch->cache,crd,dat);
+    // the nearest neighbours are only refreshed here : the lists give the last known ordering in between
+    if (ch->early != NULL)
+        build_early(ch->early,crd);
+
+    // with the mixed precision kernels the running energy is checked against a double precision evaluation
+    if (dat->precision == PREC_MIXED)
+    {
+        check_LJ_mixed(crd,dat,st,ener,ch->name);
+        if (dat->threebody)
+            *ener += get_3B_V(crd,dat,-1);
+    }
+
+    copy_coords(&ch->crd_new,crd);
+    if (ch->spec != NULL)
+    {
+        uint32_t k;
+        for (k=1; k<ch->spec->n; k++)
+            copy_coords(ch->spec->trial[k],crd);
+    }
+}
+
+/**
+ * @brief Minimises with a steepest descent the trial copy of the coordinates of a chain, which has then to be
+ *          restored from the coordinates of the chain (refresh_MC_chain or copy_coords) before the next step
+ *
+ * @param ch The chain
+ * @param dat Common data
+ *
+ * @return The energy of the minimised configuration
+ */
+double quench_MC_chain(MC_CHAIN *ch, DATA *dat)
+{
+    double e;
+
+    steepd(&ch->crd_new,dat);
+
+    e = (*get_ENER)(&ch->crd_new,dat,-1).pair;
+    if (dat->threebody)
+        e += get_3B_V(&ch->crd_new,dat,-1);
+
+    return e;
+}
+
+/*
+ * Number of steps from st to the next one where dmax is updated or something is saved, both included
+ */
+static uint32_t steps_to_event(const DATA *dat, uint64_t st)
+{
+    uint64_t n = dat->nsteps - st + 1;
+
+    if (io.trsave - (st-1)%io.trsave < n)
+        n = io.trsave - (st-1)%io.trsave;
+    if (io.esave - (st-1)%io.esave < n)
+        n = io.esave - (st-1)%io.esave;
+    if (dat->d_max_when != 0 && dat->d_max_when - (st-1)%dat->d_max_when < n)
+        n = dat->d_max_when - (st-1)%dat->d_max_when;
+
+    return (uint32_t) n;
+}
+
+/**
+ * @brief This is the core function for Metropolis MC simulation 
+ *        where the main loop is located, 
+ * 
+ * @param crd Coordinates of the system
+ * @param at Atom list, only used as a view of the system when writing the trajectory
+ * @param dat Common data
+ * @param ener Variable containing total energy of the system
+ * 
+ * @return The number of moves accepted
+ */
+uint64_t make_MC_moves(COORDS *crd, ATOM at[], DATA *dat, double *ener)
+{
+    uint64_t st, acc=0, acc2=0;
+    uint32_t accepted=0;
+
+    // the trial copy of the coordinates, and the optional energy cache and early rejection lists
+    MC_CHAIN chain;
+    COORDS *crd_new = &chain.crd_new;
+
+    alloc_MC_chain(&chain,crd,dat);
+
+    // main iteration over all steps
+    for (st=1; st<=(dat->nsteps); st++) //main loop
+    {
+        // with SPECULATIVE several steps are made at once, up to the next one where something is done below
+        if (chain.spec != NULL)
+            st += make_MC_spec_steps(&chain,crd,dat,ener,steps_to_event(dat,st),&accepted) - 1;
+        else
+            accepted = make_MC_step(&chain,crd,dat,ener,st);
+
+        //if accepted increase acceptance counters
+        if (accepted)
         {
-            // increase acceptance counters
             acc++;
             acc2++;
-
-            //copy new coordinates of the moving atom(s)
-            k=0;
-            do
-            {
-                j = (uint32_t) ismoving[k];
-                memcpy(&at[j],&at_new[j],sizeof(ATOM));
-                k++;
-            }
-            while(k<n_moving);
         }
 
         //if required adjust dmax
@@ -181,12 +505,12 @@ uint64_t make_MC_moves(ATOM at[], DATA *dat, double *ener)
 	double E_sd = 0.;
         if (st!=0 && st%io.trsave==0)
         {
-            steepd(at_new,dat);
+            E_sd = quench_MC_chain(&chain,dat);
             sddone=1;
-            E_sd = (*get_ENER)(at_new,dat,-1);
             fprintf(stdout,"Steepest Descent done (step %"PRIu64"): E = %.3lf\n",st,E_sd);
             //(*write_traj)(at,dat,st);
-	    (*write_traj)(at_new,dat,st);
+            coords_to_atoms(crd_new,at);
+	    (*write_traj)(at,dat,st);
         }
         
         //if necessary save energy and run steepest descent if not done yet
@@ -194,60 +518,267 @@ uint64_t make_MC_moves(ATOM at[], DATA *dat, double *ener)
 	{
 	    if(!sddone)
 	    {
-	      steepd(at_new,dat);
+	      E_sd = quench_MC_chain(&chain,dat);
 	      sddone=1;
-	      E_sd = (*get_ENER)(at_new,dat,-1);
 	      fprintf(stdout,"Steepest Descent done (step %"PRIu64"): E = %.3lf\n",st,E_sd);
 	    }
 	    fwrite(&E_sd,sizeof(double),1,efile);
+
+	    // also restores the copy, which was minimised
+	    refresh_MC_chain(&chain,crd,dat,st,ener);
 	}
+        // the copy was minimised
+        else if (sddone)
+            copy_coords(crd_new,crd);
 
     }//end of main loop
 
-    free(at_new) ;
-    free(ismoving);
+    if (chain.early != NULL)
+        fprintf(stdout,"Early rejections : %"PRIu64" (%.3lf %% of the steps)\n",chain.early->nrej,100.0*chain.early->nrej/(double)dat->nsteps);
+    free_MC_chain(&chain);
 
+    coords_to_atoms(crd,at);
     (*write_traj)(at,dat,st);
 
     return acc2;
 }
 
+/**
+ * @brief Same as apply_Metrop when several atoms move together : they are displaced in crd_new one after the other,
+ *          and the energy difference is the sum of the differences of each single move, the energy of each atom being
+ *          evaluated before and after its own displacement. Each pair of moved atoms is thus counted once, with the
+ *          old or new position of both, and the energy difference is exact for any potential with 2k evaluations
+ *          of a candidate, i.e. O(kN) instead of a full evaluation.
+ *
+ * @param ismoving The moving atoms, whose positions in crd_new are still the ones of crd
+ * @param n_moving Their number
+ * @param dr Their displacements, x,y,z for each atom
+ * @param cache Per atom energy cache, or NULL
+ * @param rows With the cache, filled with the pair energies of each moved atom once displaced, which are the ones
+ *          update_ecache requires when the atoms are placed in crd in the same order
+ * @param enews With the cache, filled with the energies of each moved atom once displaced
+ */
+static int32_t apply_Metrop_multi(COORDS *crd, COORDS *crd_new, DATA *dat, int32_t *ismoving, uint32_t n_moving,
+                                  double dr[], double *ener, ECACHE *cache, double rows[], double enews[])
+{
+    uint32_t k, i;
+    double Eold=0.0, Enew=0.0, Ediff=0.0;
+    double EconstrOld=0.0,EconstrNew=0.0,EconstrDiff=0.0;
+    double alpha = 0.;
+    double rejParam = 0.;
+
+    ENERGY e;
+
+    for (k=0; k<n_moving; k++)
+    {
+        i = (uint32_t) ismoving[k];
+
+        // only the first atom is evaluated in the configuration of the cache
+        if (cache != NULL)
+        {
+            Eold = (k == 0) ? cache->eat[i] : (*get_ENER)(crd_new,dat,(int32_t)i).pair;
+            EconstrOld=(get_CONSTR != NULL) ? (*get_CONSTR)(crd_new,dat,(int32_t)i) : 0.0;
+        }
+        else
+        {
+            e=(*get_ENER)(crd_new,dat,(int32_t)i);
+            Eold=e.pair;
+            EconstrOld=e.constr;
+        }
+
+        if (dat->threebody)
+            Eold += get_3B_V(crd_new,dat,(int32_t)i);
+
+        move_atom_coords(crd_new,i,dr[3*k],dr[3*k+1],dr[3*k+2]);
+
+        if (cache != NULL)
+        {
+            Enew=(*get_ENER_ROW)(crd_new,dat,i,rows+(size_t)k*crd->natom);
+            EconstrNew=(get_CONSTR != NULL) ? (*get_CONSTR)(crd_new,dat,(int32_t)i) : 0.0;
+            enews[k]=Enew;
+        }
+        else
+        {
+            e=(*get_ENER)(crd_new,dat,(int32_t)i);
+            Enew=e.pair;
+            EconstrNew=e.constr;
+        }
+
+        if (dat->threebody)
+            Enew += get_3B_V(crd_new,dat,(int32_t)i);
+
+        Ediff += (Enew - Eold) ;
+        EconstrDiff += (EconstrNew - EconstrOld) ;
+    }
+
+    LOG_PRINT(LOG_DEBUG,"Ediff : %lf \t Econstrdiff : %lf \n",Ediff,EconstrDiff);
+
+    if ( (Ediff + EconstrDiff) < 0.0 )
+    {
+        *ener+=Ediff;
+
+        LOG_PRINT(LOG_DEBUG,"MOVE ACCEPTED\n");
+
+        return MV_ACC ;
+    }
+
+    rejParam = exp(-dat->beta*(Ediff + EconstrDiff));
+    alpha = get_next(dat);
+
+    LOG_PRINT(LOG_DEBUG,"alpha : %lf ; \t rejp : %lf\n",alpha,rejParam);
+
+    if (alpha < rejParam)
+    {
+        *ener+=Ediff;
+
+        LOG_PRINT(LOG_DEBUG,"MOVE ACCEPTED\n");
+
+        return MV_ACC ;
+    }
+
+    LOG_PRINT(LOG_DEBUG,"MOVE REJECTED\n");
+
+    return MV_REJ ;
+}
+
+/**
+ * @brief Same as apply_Metrop but the random number of the acceptance test is drawn first, which gives the
+ *          largest energy difference still accepted, -ln(alpha)/beta. The pair energies of the candidate with its
+ *          nearest neighbours are then summed one by one, and the move is rejected as soon as the lower bound
+ *          of its new energy exceeds that difference (see early_reject in ener.c) ; otherwise the complete energy
+ *          is evaluated. The moves are accepted with the same probability min(1,exp(-beta*dE)) as apply_Metrop.
+ */
+static int32_t apply_Metrop_early(COORDS *crd, COORDS *crd_new, DATA *dat, int32_t *candidate, double *ener,
+                                  ECACHE *cache, EARLY_REJ *early)
+{
+    double Eold=0.0, Enew=0.0, Ediff=0.0;
+    double EconstrOld=0.0,EconstrNew=0.0,EconstrDiff=0.0;
+    double alpha = get_next(dat);
+    // any move with a smaller energy difference is accepted
+    double dEmax = (alpha > 0.0) ? -log(alpha)/dat->beta : HUGE_VAL;
+
+    ENERGY e;
+
+    if (cache != NULL)
+        Eold=cache->eat[*candidate];
+    else
+        Eold=(*get_ENER)(crd,dat,*candidate).pair;
+
+    EconstrOld=(get_CONSTR != NULL) ? (*get_CONSTR)(crd,dat,*candidate) : 0.0;
+    EconstrNew=(get_CONSTR != NULL) ? (*get_CONSTR)(crd_new,dat,*candidate) : 0.0;
+    EconstrDiff = (EconstrNew - EconstrOld) ;
+
+    if (early_reject(early,crd_new,dat,(uint32_t)*candidate,Eold+dEmax-EconstrDiff))
+    {
+        early->nrej++;
+
+        LOG_PRINT(LOG_DEBUG,"MOVE REJECTED EARLY\n");
+
+        return MV_REJ ;
+    }
+
+    if (cache != NULL)
+    {
+        Enew=(*get_ENER_ROW)(crd_new,dat,(uint32_t)*candidate,cache->row);
+        cache->enew=Enew;
+    }
+    else
+    {
+        e=(*get_ENER)(crd_new,dat,*candidate);
+        Enew=e.pair;
+    }
+
+    Ediff = (Enew - Eold) ;
+
+    LOG_PRINT(LOG_DEBUG,"Ediff : %lf \t Econstrdiff : %lf \t dEmax : %lf\n",Ediff,EconstrDiff,dEmax);
+
+    if ( (Ediff + EconstrDiff) < dEmax )
+    {
+        *ener+=Ediff;
+
+        LOG_PRINT(LOG_DEBUG,"MOVE ACCEPTED\n");
+
+        return MV_ACC ;
+    }
+
+    LOG_PRINT(LOG_DEBUG,"MOVE REJECTED\n");
+
+    return MV_REJ ;
+}
+
+/*
+ * Energy change when the candidate moves from its position in crd to the one in crd_new : ediff for the potential
+ * (with the three-body term) and econstr for the constraint. With the cache, the pair energies of the candidate in
+ * its new position are stored in row and its new energy in enew.
+ */
+static void get_move_diff(COORDS *crd, COORDS *crd_new, DATA *dat, int32_t candidate, ECACHE *cache, double row[],
+                          double *enew, double *ediff, double *econstr)
+{
+    double Eold=0.0, Enew=0.0;
+    double EconstrOld=0.0,EconstrNew=0.0;
+
+    ENERGY e;
+
+    // each evaluation is itself parallel when worth it (see get_V_cand_omp in ener.c)
+    if (cache != NULL)
+    {
+        Eold=cache->eat[candidate];
+        EconstrOld=(get_CONSTR != NULL) ? (*get_CONSTR)(crd,dat,candidate) : 0.0;
+
+        Enew=(*get_ENER_ROW)(crd_new,dat,(uint32_t)candidate,row);
+        EconstrNew=(get_CONSTR != NULL) ? (*get_CONSTR)(crd_new,dat,candidate) : 0.0;
+    }
+    else
+    {
+        e=(*get_ENER)(crd,dat,candidate);
+        Eold=e.pair;
+        EconstrOld=e.constr;
+
+        e=(*get_ENER)(crd_new,dat,candidate);
+        Enew=e.pair;
+        EconstrNew=e.constr;
+    }
+
+    *enew = Enew;
+    *ediff = (Enew - Eold) ;
+    *econstr = (EconstrNew - EconstrOld) ;
+
+    // the three-body term is not part of the energy functions : its change is added separately
+    if (dat->threebody)
+        *ediff += get_3B_diff(crd,crd_new,dat,(uint32_t)candidate);
+}
+
 /**
  * @bried This function is in charge of checking the energy difference between the new and old atomic configurations
  *          and then return if the move is accepted or rejected
  * 
- * @param at Atom list
- * @param at_new Modifed atom lsit
+ * @param crd Coordinates
+ * @param crd_new Modifed coordinates
  * @param dat Common data
  * @param candidate List of atoms that were moving
  * @param ener Variable where energy difference will be stored
  * @param step The current simulation step
+ * @param cache Per atom energy cache providing the old energy of the candidate, or NULL for evaluating it again ;
+ *          on output cache->row and cache->enew contain the new energy of the candidate
+ * @param early Nearest neighbours lists for the early rejection of the move, or NULL
  * 
  * @return MV_ACC or MV_REJ if the move is either accepted or rejected
  */
-int32_t apply_Metrop(ATOM at[], ATOM at_new[], DATA *dat, int32_t *candidate, double *ener, uint64_t *step)
+int32_t apply_Metrop(COORDS *crd, COORDS *crd_new, DATA *dat, int32_t *candidate, double *ener, uint64_t *step, ECACHE *cache, EARLY_REJ *early)
 {
+    if (early != NULL)
+        return apply_Metrop_early(crd,crd_new,dat,candidate,ener,cache,early);
+
+
     //return 1 if move accepted, -1 if rejected
-    double Eold=0.0, Enew=0.0, Ediff=0.0;
-    double EconstrOld=0.0,EconstrNew=0.0,EconstrDiff=0.0;
+    double Enew=0.0, Ediff=0.0;
+    double EconstrDiff=0.0;
     double alpha = 0.;
     double rejParam = 0.;
 
-#ifdef _OPENMP
-    #pragma omp parallel
-    {
-#endif
-        Eold=(*get_ENER)(at,dat,*candidate);
-        EconstrOld=dat->E_constr;
-
-        Enew=(*get_ENER)(at_new,dat,*candidate);
-        EconstrNew=dat->E_constr;
-#ifdef _OPENMP
-    }
-#endif
-
-    Ediff = (Enew - Eold) ;
-    EconstrDiff = (EconstrNew - EconstrOld) ;
+    get_move_diff(crd,crd_new,dat,*candidate,cache,(cache != NULL) ? cache->row : NULL,&Enew,&Ediff,&EconstrDiff);
+    if (cache != NULL)
+        cache->enew=Enew;
 
     LOG_PRINT(LOG_DEBUG,"Ediff : %lf \t Econstrdiff : %lf \n",Ediff,EconstrDiff);
 
@@ -0,0 +1,284 @@
+/**
+ * \file MCptmc.c
+ *
+ * \brief Parallel tempering (replica exchange) Monte Carlo : one Metropolis chain per temperature of a ladder,
+ *          the chains being run concurrently and the neighbour replicas exchanged every few steps
+ *
+ * \authors Florent Hedin (University of Basel, Switzerland) \n
+ *          Markus Meuwly (University of Basel, Switzerland)
+ *
+ * \copyright Copyright (c) 2011-2015, Florent Hédin, Markus Meuwly, and the University of Basel. \n
+ *            All rights reserved. \n
+ *            The 3-clause BSD license is applied to this software. \n
+ *            See LICENSE.txt
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#include "global.h"
+#include "coords.h"
+#include "threebody.h"
+#include "ener.h"
+#include "MCclassic.h"
+#include "MCptmc.h"
+#include "tools.h"
+#include "rand.h"
+#include "io.h"
+#include "logger.h"
+
+#if defined(STDRAND)
+// the generator of the C library is shared by all the replicas, which are then run one after the other
+#define PARALLEL_REP    0
+#elif defined(LUA_PLUGINS)
+#include "plugins_lua.h"
+// the Lua plugins share one interpreter : their energies are never evaluated from several threads
+#define PARALLEL_REP    (get_ENER != &(get_lua_V) && get_ENER != &(get_lua_V_ffi))
+#else
+#define PARALLEL_REP    1
+#endif
+
+/*
+ * A replica : a configuration with its Metropolis chain, moving from one temperature to another when exchanged
+ */
+typedef struct
+{
+    COORDS crd;         // coordinates
+    MC_CHAIN ch;        // trial copy, energy cache, ...
+    double ener;        // running energy
+    uint32_t id;        // index of the replica, i.e. its temperature at the start
+} REPLICA;
+
+/*
+ * A temperature of the ladder and the replica it currently holds. The temperature, dmax and random numbers are in its
+ * own copy of the common data, so that exchanging two replicas only swaps two pointers ; the outputs are per temperature.
+ */
+typedef struct
+{
+    DATA dat;           // copy of the common data with the temperature of the ladder
+    REPLICA *rep;       // the replica at this temperature
+    uint64_t acc;       // number of moves accepted at this temperature
+    uint64_t acc_dmax;  // number of moves accepted since the last update of dmax
+    uint64_t ntry;      // number of exchanges attempted with the next temperature
+    uint64_t nexch;     // number of exchanges accepted with the next temperature
+    double emin;        // lowest energy of the minimised configurations at this temperature
+    FILE *efile;        // energy file
+    FILE *traj;         // trajectory file
+    uint32_t header;    // 1 until the header of the trajectory is written
+    ATOM *at;           // view of the replica used for writing the trajectory
+} PT_TEMP;
+
+/**
+ * @brief Temperature of replica r of the ladder : the ladder is geometric from DATA::T to DATA::pt_tmax,
+ *          which makes the acceptance of the exchanges about uniform along it
+ */
+double get_PT_temp(const DATA *dat, uint32_t r)
+{
+    if (dat->pt_nrep < 2)
+        return dat->T;
+
+    return dat->T*pow(dat->pt_tmax/dat->T,(double)r/(double)(dat->pt_nrep-1));
+}
+
+/*
+ * Steps first to last of the replica at temperature t, with the per temperature outputs : as with make_MC_moves,
+ * the configurations saved are minimised
+ */
+static void run_temp(PT_TEMP *t, uint64_t first, uint64_t last)
+{
+    uint64_t st;
+    uint32_t sddone;
+    double E_sd = 0.0;
+    REPLICA *rep = t->rep;
+    DATA *dat = &t->dat;
+
+    for (st=first; st<=last; st++)
+    {
+        if (make_MC_step(&rep->ch,&rep->crd,dat,&rep->ener,st))
+        {
+            t->acc++;
+            t->acc_dmax++;
+        }
+
+        // dmax belongs to the temperature, not to the replica
+        if (dat->d_max_when != 0)
+            adj_dmax(dat,&st,&t->acc_dmax);
+
+        sddone = 0;
+        if (st%io.trsave==0)
+        {
+            E_sd = quench_MC_chain(&rep->ch,dat);
+            sddone = 1;
+            coords_to_atoms(&rep->ch.crd_new,t->at);
+            write_dcd_frame(t->at,dat,t->traj,t->header);
+            t->header = 0;
+        }
+
+        if (st%io.esave==0)
+        {
+            if (!sddone)
+            {
+                E_sd = quench_MC_chain(&rep->ch,dat);
+                sddone = 1;
+            }
+            fwrite(&E_sd,sizeof(double),1,t->efile);
+            refresh_MC_chain(&rep->ch,&rep->crd,dat,st,&rep->ener);
+        }
+        // the trial copy was minimised
+        else if (sddone)
+            copy_coords(&rep->ch.crd_new,&rep->crd);
+
+        if (sddone && E_sd < t->emin)
+            t->emin = E_sd;
+    }
+}
+
+/*
+ * Attempts to exchange the replicas of the temperatures offset and offset+1, offset+2 and offset+3, ... : an exchange
+ * is accepted with the probability min(1,exp((beta_i-beta_j)*(E_i-E_j))), and only swaps the replicas' pointers
+ */
+static void exchange_temps(PT_TEMP temp[], uint32_t nrep, uint32_t offset, DATA *dat)
+{
+    uint32_t r;
+    double ea, eb, delta;
+    REPLICA *tmp = NULL;
+
+    for (r=offset; r+1<nrep; r+=2)
+    {
+        PT_TEMP *a = &temp[r];
+        PT_TEMP *b = &temp[r+1];
+
+        // the constraint is also part of the Boltzmann weights
+        ea = a->rep->ener + ((get_CONSTR != NULL) ? (*get_CONSTR)(&a->rep->crd,&a->dat,-1) : 0.0);
+        eb = b->rep->ener + ((get_CONSTR != NULL) ? (*get_CONSTR)(&b->rep->crd,&b->dat,-1) : 0.0);
+        delta = (a->dat.beta - b->dat.beta)*(ea - eb);
+
+        a->ntry++;
+
+        if (delta >= 0.0 || get_next(dat) < exp(delta))
+        {
+            tmp = a->rep;
+            a->rep = b->rep;
+            b->rep = tmp;
+            a->nexch++;
+
+            LOG_PRINT(LOG_DEBUG,"Exchange of the replicas %u and %u accepted\n",a->rep->id,b->rep->id);
+        }
+    }
+}
+
+/**
+ * @brief This is the core function of the parallel tempering simulation : DATA::pt_nrep replicas start from the
+ *          configuration crd, each one at a temperature of the ladder (see get_PT_temp). The replicas are run
+ *          concurrently by the OpenMP threads for DATA::pt_exch steps, with their own random numbers derived
+ *          from the ones of dat, and then the replicas of neighbour temperatures are exchanged or not, alternating
+ *          the even and odd pairs. Like with make_MC_moves, the saved configurations and energies are minimised.
+ *          The energy, trajectory and last coordinates of each temperature r are saved in the files given in the
+ *          input file, with _r added before their extension.
+ *
+ * @param crd Coordinates of the system ; on return those of the replica at the lowest temperature
+ * @param at Atom list ; on return the view of the replica at the lowest temperature
+ * @param dat Common data, whose random numbers are used for the exchanges
+ * @param ener Energy of the system ; on return the one of the replica at the lowest temperature
+ *
+ * @return The number of moves accepted by all the replicas
+ */
+uint64_t launch_PTMC(COORDS *crd, ATOM at[], DATA *dat, double *ener)
+{
+    uint32_t r;
+    uint64_t st, last, acc=0, nexch=0;
+    FILE *f = NULL;
+    const uint32_t nrep = dat->pt_nrep;
+
+    PT_TEMP *temp = calloc(nrep,sizeof *temp);
+    REPLICA *reps = calloc(nrep,sizeof *reps);
+
+    for (r=0; r<nrep; r++)
+    {
+        PT_TEMP *t = &temp[r];
+
+        clone_coords(&reps[r].crd,crd);
+        alloc_MC_chain(&reps[r].ch,&reps[r].crd,dat);
+        snprintf(reps[r].ch.name,sizeof reps[r].ch.name,"replica %u",r);
+        reps[r].ener = *ener;
+        reps[r].id = r;
+
+        t->dat = *dat;
+        t->dat.T = get_PT_temp(dat,r);
+        t->dat.beta = (charmm_units) ? 1.0/(KBCH*t->dat.T) : 1.0/t->dat.T;
+        init_rand_stream(&t->dat,dat);
+
+        t->rep = &reps[r];
+        t->emin = DBL_MAX;
+        t->header = 1;
+
+        t->efile = open_indexed(io.etitle,r,"wb");
+        t->traj = open_indexed(io.trajtitle,r,"wb");
+
+        t->at = malloc(dat->natom*sizeof *t->at);
+        memcpy(t->at,at,dat->natom*sizeof *t->at);
+
+        fprintf(stdout,"Replica %u : T = %lf \t beta = %lf\n",r,t->dat.T,t->dat.beta);
+    }
+    fprintf(stdout,"Exchanges of the neighbour replicas attempted each %u steps\n\n",dat->pt_exch);
+
+    for (st=1; st<=dat->nsteps; st=last+1)
+    {
+        last = st - 1 + dat->pt_exch;
+        if (last > dat->nsteps)
+            last = dat->nsteps;
+
+#ifdef _OPENMP
+        // one replica per thread
+        #pragma omp parallel for schedule(static,1) if(PARALLEL_REP)
+#endif
+        for (r=0; r<nrep; r++)
+            run_temp(&temp[r],st,last);
+
+        if (last%dat->pt_exch==0)
+            exchange_temps(temp,nrep,(uint32_t)(nexch++%2),dat);
+    }
+
+    fprintf(stdout,"\n%-4s %-12s %-12s %-12s %-14s %-16s %-16s %s\n","","T","acc. (%)","final dmax","exch. (%)","lowest minimum","final energy","replica");
+    for (r=0; r<nrep; r++)
+    {
+        PT_TEMP *t = &temp[r];
+
+        fprintf(stdout,"%-4u %-12lf %-12lf %-12lf %-14lf %-16lf %-16lf %u\n",r,t->dat.T,100.0*(double)t->acc/(double)dat->nsteps,
+                t->dat.d_max,(t->ntry != 0) ? 100.0*(double)t->nexch/(double)t->ntry : 0.0,t->emin,t->rep->ener,t->rep->id);
+        acc += t->acc;
+
+        f = open_indexed(io.crdtitle_last,r,"wt");
+        coords_to_atoms(&t->rep->crd,t->at);
+        write_xyz(t->at,&t->dat,dat->nsteps,f);
+        fclose(f);
+    }
+
+    if (crd->nlist != NULL)
+        for (r=0; r<nrep; r++)
+            fprintf(stdout,"Verlet lists of replica %u were built %"PRIu64" times\n",r,reps[r].crd.nlist->nbuild);
+
+    // the lowest temperature is the one of the input file
+    copy_coords(crd,&temp[0].rep->crd);
+    coords_to_atoms(crd,at);
+    *ener = temp[0].rep->ener;
+    dat->d_max = temp[0].dat.d_max;
+
+    for (r=0; r<nrep; r++)
+    {
+        free_MC_chain(&reps[r].ch);
+        free_coords(&reps[r].crd);
+        free_rand_stream(&temp[r].dat);
+        fclose(temp[r].efile);
+        fclose(temp[r].traj);
+        free(temp[r].at);
+    }
+    free(reps);
+    free(temp);
+
+    return acc;
+}
@@ -20,15 +20,28 @@
 #include <time.h>
 
 #include "global.h"
+#include "coords.h"
+#include "cells.h"
+#include "nlist.h"
+#include "manybody.h"
+#include "threebody.h"
+#include "ener.h"
 #include "MCspav.h"
 #include "tools.h"
 #include "rand.h"
 #include "memory.h"
-#include "ener.h"
 #include "minim.h"
 #include "io.h"
 #include "logger.h"
 
+#ifdef LUA_PLUGINS
+#include "plugins_lua.h"
+// the Lua plugins share one interpreter : their energies are never evaluated from several threads
+#define PARALLEL_ENER   (get_ENER != &(get_lua_V) && get_ENER != &(get_lua_V_ffi))
+#else
+#define PARALLEL_ENER   1
+#endif
+
 #define MV_ACC 1
 #define MV_REJ -1
 
@@ -39,7 +52,12 @@ static double *deltaM=NULL;
 static double **EI=NULL;
 static double **EF=NULL;
 
-uint64_t launch_SPAV(ATOM at[], DATA *dat, SPDAT *spdat, double *ener)
+// gaussian displacements of the candidate in each replica
+static double **BMX=NULL;
+static double **BMY=NULL;
+static double **BMZ=NULL;
+
+uint64_t launch_SPAV(COORDS *crd, ATOM at[], DATA *dat, SPDAT *spdat, double *ener)
 {
     uint64_t acc=0, acc2=0 ;
     uint64_t st=0 ;
@@ -56,8 +74,6 @@ uint64_t launch_SPAV(ATOM at[], DATA *dat, SPDAT *spdat, double *ener)
 
     int32_t is_accepted = 0 ;
 
-    double bmx=0.,bmy=0.,bmz=0.;
-
 //     uint64_t progress=dat->nsteps/1000;
 //     clock_t start,now;
 
@@ -65,31 +81,39 @@ uint64_t launch_SPAV(ATOM at[], DATA *dat, SPDAT *spdat, double *ener)
 
     ismoving=calloc(n_moving,sizeof *ismoving);
 
-    ATOM *at_new=NULL;
-    at_new=malloc( dat->natom*sizeof *at_new );
+    // a copy of the coordinates where the trial moves are made, kept identical to crd in between
+    COORDS crd_new;
+    clone_coords(&crd_new,crd);
+
+    // per atom energy cache of the real configuration, only if the potential provides the pair energies of a candidate
+    ECACHE ecache;
+    ECACHE *cache = NULL;
+    if (get_ENER_ROW != NULL)
+    {
+        alloc_ecache(&ecache,crd,dat);
+        cache = &ecache;
+    }
 
-    ATOM ***iniArray=(ATOM***)calloc_3D(spdat->meps,spdat->neps,dat->natom,sizeof ***iniArray);
-    ATOM ***finArray=(ATOM***)calloc_3D(spdat->meps,spdat->neps,dat->natom,sizeof ***finArray);
+    // the replicas are also kept identical to crd, the candidate being only displaced when they are evaluated
+    COORDS **repArray=(COORDS**)calloc_2D(spdat->meps,spdat->neps,sizeof **repArray);
+
+    for (i=0; i<spdat->meps; i++)
+    {
+        for (j=0; j<spdat->neps; j++)
+        {
+            alloc_coords(&repArray[i][j],dat->natom);
+            memcpy(repArray[i][j].type,crd->type,dat->natom*sizeof(uint32_t));
+            if (crd->xf != NULL)
+                alloc_coords_mixed(&repArray[i][j]);
+            copy_coords(&repArray[i][j],crd);
+        }
+    }
 
     for (st=1; st<=dat->nsteps; st++)
     {
         LOG_PRINT(LOG_DEBUG,"----------------------"
                   " STEP %"PRIu64" ----------------------\n",st);
 
-        for (k=0; k<dat->natom; k++)
-        {
-            memcpy(&(at_new[k]),&(at[k]),sizeof(ATOM));
-
-            for (i=0; i<spdat->meps; i++)
-            {
-                for (j=0; j<spdat->neps; j++)
-                {
-                    memcpy(&(iniArray[i][j][k]),&(at[k]),sizeof(ATOM));
-                    //memcpy(&(finArray[i][j][k]),&(at[k]),sizeof(ATOM));
-                }
-            }
-        }
-
         //n_moving=(int) dat->natom*get_next(dat) + 1;
 
         j=0;
@@ -127,34 +151,21 @@ uint64_t launch_SPAV(ATOM at[], DATA *dat, SPDAT *spdat, double *ener)
 //          mv_direction = (int)3*get_next(dat);
             get_vector(dat,mv_direction,randvec);
 
-            at_new[k].x += (dat->d_max)*randvec[0] ;
-            at_new[k].y += (dat->d_max)*randvec[1] ;
-            at_new[k].z += (dat->d_max)*randvec[2] ;
+            move_atom_coords(&crd_new,k,(dat->d_max)*randvec[0],(dat->d_max)*randvec[1],(dat->d_max)*randvec[2]);
 
             for (i=0; i<spdat->meps; i++)
             {
                 for (j=0; j<spdat->neps; j++)
                 {
-                    bmx = get_BoxMuller(dat,spdat);
-                    bmy = get_BoxMuller(dat,spdat);
-                    bmz = get_BoxMuller(dat,spdat);
-
-                    iniArray[i][j][k].x += bmx;
-                    iniArray[i][j][k].y += bmy;
-                    iniArray[i][j][k].z += bmz;
-
-                    memcpy(&finArray[i][j][k],&at_new[k],sizeof(ATOM));
-
-                    finArray[i][j][k].x += bmx;
-                    finArray[i][j][k].y += bmy;
-                    finArray[i][j][k].z += bmz;
-
+                    BMX[i][j] = get_BoxMuller(dat,spdat);
+                    BMY[i][j] = get_BoxMuller(dat,spdat);
+                    BMZ[i][j] = get_BoxMuller(dat,spdat);
                 }
             }
 
         }
 
-        is_accepted = apply_SPAV_Criterion(dat,spdat,at,at_new,iniArray,finArray,&ismoving[0],ener,&st);
+        is_accepted = apply_SPAV_Criterion(dat,spdat,crd,&crd_new,repArray,&ismoving[0],ener,&st,cache);
         
 //         is_accepted = apply_SPAV_Criterion(dat,spdat,at,at_new,iniArray,finArray,&unicMove,ener,&st);
 
@@ -177,19 +188,53 @@ uint64_t launch_SPAV(ATOM at[], DATA *dat, SPDAT *spdat, double *ener)
         {
             acc++;
             acc2++;
+
+            // the cache needs the coordinates before the move
+            if (cache != NULL)
+                update_ecache(cache,crd,dat,(uint32_t)ismoving[0],cache->row,cache->enew);
+
             for (l=0; l<n_moving; l++)
             {
                 j = (uint32_t) ismoving[l];
 
-                at[j].x = at_new[j].x ;
-                at[j].y = at_new[j].y ;
-                at[j].z = at_new[j].z ;
+                set_atom_coords(crd,j,crd_new.x[j],crd_new.y[j],crd_new.z[j]);
             }
+
+            for (i=0; i<spdat->meps; i++)
+                for (j=0; j<spdat->neps; j++)
+                    for (l=0; l<n_moving; l++)
+                    {
+                        k = (uint32_t) ismoving[l];
+                        set_atom_coords(&repArray[i][j],k,crd->x[k],crd->y[k],crd->z[k]);
+                    }
         }
+        else
+        {
+            for (l=0; l<n_moving; l++)
+                revert_atom_coords(&crd_new,crd,(uint32_t)ismoving[l]);
+        }
+        sync_coords(&crd_new,crd);
         
         if (dat->d_max_when != 0)
             adj_dmax(dat,&st,&acc);
 
+        // removes the rounding errors accumulated by the O(1) center of mass and the cache updates
+        if (st%io.esave==0)
+        {
+            refresh_coords(crd);
+            if (cache != NULL)
+                build_ecache(cache,crd,dat);
+
+            copy_coords(&crd_new,crd);
+            for (i=0; i<spdat->meps; i++)
+                for (j=0; j<spdat->neps; j++)
+                    copy_coords(&repArray[i][j],crd);
+
+            // the running energy is averaged over the replicas, so only the kernels are checked
+            if (dat->precision == PREC_MIXED)
+                check_LJ_mixed(crd,dat,st,NULL,"");
+        }
+
 //         if ((*ener)/at[0].ljp.eps <= dat->E_steepD)
 //         {
 //           fprintf(stdout,"Running Steepest Descent at step %d : E = %lf.\n",st,(*ener)/at[0].ljp.eps);
@@ -216,6 +261,7 @@ uint64_t launch_SPAV(ATOM at[], DATA *dat, SPDAT *spdat, double *ener)
         
         if (st!=0 && st%io.trsave==0)
         {
+            coords_to_atoms(crd,at);
             (*write_traj)(at,dat,st);
             fprintf(stdout,"Energy at step %"PRIu64" : E = %.3lf\n",st,*ener );
         }
@@ -248,32 +294,69 @@ uint64_t launch_SPAV(ATOM at[], DATA *dat, SPDAT *spdat, double *ener)
 
     } //END OF MAIN FOR
 
-    free_3D(spdat->meps,spdat->neps,iniArray,finArray,NULL);
+    for (i=0; i<spdat->meps; i++)
+    {
+        for (j=0; j<spdat->neps; j++)
+        {
+            free_coords(&repArray[i][j]);
+        }
+    }
+    free_2D(spdat->meps,repArray,NULL);
+
+    free_coords(&crd_new);
 
-    free(at_new);
+    if (cache != NULL)
+        free_ecache(cache);
 
     free(ismoving);
 
+    coords_to_atoms(crd,at);
     (*write_traj)(at,dat,st);
 
     return acc2;
 }
 
-int32_t apply_SPAV_Criterion(DATA *dat, SPDAT *spdat, ATOM at[], ATOM at_new[],
-                             ATOM ***iniArray, ATOM ***finArray, int32_t *candidate, double *ener, uint64_t *currStep)
+/**
+ * @brief Spatial averaging acceptance test of the move of the candidate from its position in crd to the one in crd_new.
+ *          If the energy does not decrease, the candidate is displaced by the gaussian vectors BMX,BMY,BMZ around its
+ *          old and then its new position in each replica, which is evaluated, and then put back where it is in crd.
+ *
+ * @return MV_ACC or MV_REJ if the move is either accepted or rejected
+ */
+int32_t apply_SPAV_Criterion(DATA *dat, SPDAT *spdat, COORDS *crd, COORDS *crd_new,
+                             COORDS **repArray, int32_t *candidate, double *ener, uint64_t *currStep, ECACHE *cache)
 {
     double Eold=0.,Enew=0.,Ediff=0.;
     double EconstrOld=0.0,EconstrNew=0.0,EconstrDiff=0.0;
+    ENERGY e;
+
+    if (cache != NULL)
+    {
+        Eold=cache->eat[*candidate];
+        EconstrOld=(get_CONSTR != NULL) ? (*get_CONSTR)(crd,dat,*candidate) : 0.0;
 
-    Eold=(*get_ENER)(at,dat,*candidate);
-    EconstrOld=dat->E_constr;
+        Enew=(*get_ENER_ROW)(crd_new,dat,(uint32_t)*candidate,cache->row);
+        EconstrNew=(get_CONSTR != NULL) ? (*get_CONSTR)(crd_new,dat,*candidate) : 0.0;
+        cache->enew=Enew;
+    }
+    else
+    {
+        e=(*get_ENER)(crd,dat,*candidate);
+        Eold=e.pair;
+        EconstrOld=e.constr;
 
-    Enew=(*get_ENER)(at_new,dat,*candidate);
-    EconstrNew=dat->E_constr;
+        e=(*get_ENER)(crd_new,dat,*candidate);
+        Enew=e.pair;
+        EconstrNew=e.constr;
+    }
 
     Ediff = (Enew - Eold) ;
     EconstrDiff = (EconstrNew - EconstrOld) ;
 
+    // the three-body term is not part of the energy functions : its change is added separately
+    if (dat->threebody)
+        Ediff += get_3B_diff(crd,crd_new,dat,(uint32_t)*candidate);
+
     LOG_PRINT(LOG_DEBUG,"Ediff : %lf \t Econstrdiff : %lf \n",Ediff,EconstrDiff);
 
     if ( (Ediff + EconstrDiff) < 0.0 )
@@ -286,17 +369,16 @@ int32_t apply_SPAV_Criterion(DATA *dat, SPDAT *spdat, ATOM at[], ATOM at_new[],
     else
     {
         uint32_t i,j/*,k*/ = 0 ;
+        const uint32_t k = (uint32_t) *candidate;
+        COORDS *r = NULL;
         double delta = 0. ;
         double sigma = 0. ;
         double rejParam = 0. ;
         double alpha = 0. ;
 
-
-
-
-
 #ifdef _OPENMP
-        #pragma omp parallel default(shared) firstprivate(i,j)
+        // the energy functions are reentrant (see ener.h) so the replicas are evaluated concurrently
+        #pragma omp parallel default(shared) firstprivate(i,j) private(e,r) if(PARALLEL_ENER)
         {
             #pragma omp for schedule(dynamic, 2)
 #endif
@@ -305,11 +387,22 @@ int32_t apply_SPAV_Criterion(DATA *dat, SPDAT *spdat, ATOM at[], ATOM at_new[],
             {
                 for (j=0; j<spdat->neps; j++)
                 {
-                    EI[i][j] =  (*get_ENER)(iniArray[i][j],dat,*candidate);
-                    EI[i][j] += dat->E_constr;
+                    r = &repArray[i][j];
+
+                    move_atom_coords(r,k,BMX[i][j],BMY[i][j],BMZ[i][j]);
+                    e = (*get_ENER)(r,dat,*candidate);
+                    EI[i][j] = e.pair + e.constr;
+                    if (dat->threebody)
+                        EI[i][j] += get_3B_V(r,dat,*candidate);
 
-                    EF[i][j] = (*get_ENER)(finArray[i][j],dat,*candidate);
-                    EF[i][j] += dat->E_constr;
+                    set_atom_coords(r,k,crd_new->x[k]+BMX[i][j],crd_new->y[k]+BMY[i][j],crd_new->z[k]+BMZ[i][j]);
+                    e = (*get_ENER)(r,dat,*candidate);
+                    EF[i][j] = e.pair + e.constr;
+                    if (dat->threebody)
+                        EF[i][j] += get_3B_V(r,dat,*candidate);
+
+                    revert_atom_coords(r,crd,k);
+                    sync_coords(r,crd);
 
 //                    fprintf(stderr,"EI[%d][%d]=%lf \t EF[%d][%d]=%lf \n",i,j,EI[i][j],i,j,EF[i][j]);
                 }
@@ -380,6 +473,10 @@ void alloc_SAMC(SPDAT *spdat)
 
     EI=(double**)calloc_2D(spdat->meps,spdat->neps,sizeof **EI);
     EF=(double**)calloc_2D(spdat->meps,spdat->neps,sizeof **EF);
+
+    BMX=(double**)calloc_2D(spdat->meps,spdat->neps,sizeof **BMX);
+    BMY=(double**)calloc_2D(spdat->meps,spdat->neps,sizeof **BMY);
+    BMZ=(double**)calloc_2D(spdat->meps,spdat->neps,sizeof **BMZ);
 }
 
 void dealloc_SAMC(SPDAT *spdat)
@@ -387,5 +484,5 @@ void dealloc_SAMC(SPDAT *spdat)
     free(Smnew);
     free(Smold);
     free(deltaM);
-    free_2D(spdat->meps,EI,EF,NULL);
+    free_2D(spdat->meps,EI,EF,BMX,BMY,BMZ,NULL);
 }
\ No newline at end of file
@@ -0,0 +1,199 @@
+/**
+ * \file MCwalkers.c
+ *
+ * \brief Several independent Metropolis chains (walkers) run in one process, spread over the OpenMP threads :
+ *          the input is parsed and the tables are built once for all of them
+ *
+ * \authors Florent Hedin (University of Basel, Switzerland) \n
+ *          Markus Meuwly (University of Basel, Switzerland)
+ *
+ * \copyright Copyright (c) 2011-2015, Florent Hédin, Markus Meuwly, and the University of Basel. \n
+ *            All rights reserved. \n
+ *            The 3-clause BSD license is applied to this software. \n
+ *            See LICENSE.txt
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <float.h>
+
+#include "global.h"
+#include "coords.h"
+#include "ener.h"
+#include "MCclassic.h"
+#include "MCwalkers.h"
+#include "tools.h"
+#include "rand.h"
+#include "io.h"
+#include "logger.h"
+
+#if defined(STDRAND)
+// the generator of the C library is shared by all the walkers, which are then run one after the other
+#define PARALLEL_WALK   0
+#elif defined(LUA_PLUGINS)
+#include "plugins_lua.h"
+// the Lua plugins share one interpreter : their energies are never evaluated from several threads
+#define PARALLEL_WALK   (get_ENER != &(get_lua_V) && get_ENER != &(get_lua_V_ffi))
+#else
+#define PARALLEL_WALK   1
+#endif
+
+/*
+ * A walker : a Metropolis chain with its own copy of the common data (dmax and random numbers), coordinates and outputs
+ */
+typedef struct
+{
+    DATA dat;           // copy of the common data with its own random numbers stream
+    COORDS crd;         // coordinates
+    MC_CHAIN ch;        // trial copy, energy cache, ...
+    double ener;        // running energy
+    double emin;        // lowest energy of the minimised configurations
+    uint64_t acc;       // number of moves accepted
+    FILE *efile;        // energy file
+    FILE *traj;         // trajectory file
+    ATOM *at;           // view of the walker used for writing the trajectory
+} WALKER;
+
+/*
+ * The whole run of one walker : the same as make_MC_moves, the outputs going to the files of the walker
+ */
+static void run_walker(WALKER *w)
+{
+    uint64_t st, acc_dmax=0;
+    uint32_t header = 1, sddone;
+    double E_sd = 0.0;
+    DATA *dat = &w->dat;
+
+    for (st=1; st<=dat->nsteps; st++)
+    {
+        if (make_MC_step(&w->ch,&w->crd,dat,&w->ener,st))
+        {
+            w->acc++;
+            acc_dmax++;
+        }
+
+        if (dat->d_max_when != 0)
+            adj_dmax(dat,&st,&acc_dmax);
+
+        // the saved configurations are minimised, which gives the lowest minima visited by the walker
+        sddone = 0;
+        if (st%io.trsave==0)
+        {
+            E_sd = quench_MC_chain(&w->ch,dat);
+            sddone = 1;
+            coords_to_atoms(&w->ch.crd_new,w->at);
+            write_dcd_frame(w->at,dat,w->traj,header);
+            header = 0;
+        }
+
+        if (st%io.esave==0)
+        {
+            if (!sddone)
+            {
+                E_sd = quench_MC_chain(&w->ch,dat);
+                sddone = 1;
+            }
+            fwrite(&E_sd,sizeof(double),1,w->efile);
+            refresh_MC_chain(&w->ch,&w->crd,dat,st,&w->ener);
+        }
+        else if (sddone)
+            copy_coords(&w->ch.crd_new,&w->crd);
+
+        if (sddone && E_sd < w->emin)
+            w->emin = E_sd;
+    }
+
+    coords_to_atoms(&w->crd,w->at);
+    write_dcd_frame(w->at,dat,w->traj,header);
+}
+
+/**
+ * @brief This is the core function of the multi-walker simulation : DATA::n_walkers Metropolis chains start from the
+ *          configuration crd, each one with its own random numbers derived from the ones of dat, and are run
+ *          independently by the OpenMP threads. Like with make_MC_moves, the configurations saved in the trajectory
+ *          are minimised. The energy, trajectory and last coordinates of each walker w are saved in the files given
+ *          in the input file, with _w added before their extension.
+ *
+ * @param crd Coordinates of the system ; on return those of the walker which found the lowest minimum
+ * @param at Atom list ; on return the view of the walker which found the lowest minimum
+ * @param dat Common data, whose random numbers seed the ones of the walkers
+ * @param ener Energy of the system ; on return the running energy of the walker which found the lowest minimum
+ *
+ * @return The number of moves accepted by all the walkers
+ */
+uint64_t launch_walkers(COORDS *crd, ATOM at[], DATA *dat, double *ener)
+{
+    uint32_t i, best=0;
+    uint64_t acc=0;
+    FILE *f = NULL;
+    const uint32_t nw = dat->n_walkers;
+
+    WALKER *w = calloc(nw,sizeof *w);
+
+    for (i=0; i<nw; i++)
+    {
+        w[i].dat = *dat;
+        init_rand_stream(&w[i].dat,dat);
+
+        clone_coords(&w[i].crd,crd);
+        alloc_MC_chain(&w[i].ch,&w[i].crd,&w[i].dat);
+        snprintf(w[i].ch.name,sizeof w[i].ch.name,"walker %u",i);
+        w[i].ener = *ener;
+        w[i].emin = DBL_MAX;
+
+        w[i].efile = open_indexed(io.etitle,i,"wb");
+        w[i].traj = open_indexed(io.trajtitle,i,"wb");
+
+        w[i].at = malloc(dat->natom*sizeof *w[i].at);
+        memcpy(w[i].at,at,dat->natom*sizeof *w[i].at);
+    }
+
+#ifdef _OPENMP
+    // one walker per thread at a time ; their results do not depend on the thread running them
+    #pragma omp parallel for schedule(dynamic,1) if(PARALLEL_WALK)
+#endif
+    for (i=0; i<nw; i++)
+        run_walker(&w[i]);
+
+    fprintf(stdout,"\n%-6s %-12s %-12s %-16s %s\n","","acc. (%)","final dmax","final energy","lowest minimum");
+    for (i=0; i<nw; i++)
+    {
+        fprintf(stdout,"%-6u %-12lf %-12lf %-16lf %lf\n",i,100.0*(double)w[i].acc/(double)dat->nsteps,
+                w[i].dat.d_max,w[i].ener,w[i].emin);
+        acc += w[i].acc;
+
+        if (w[i].emin < w[best].emin)
+            best = i;
+
+        f = open_indexed(io.crdtitle_last,i,"wt");
+        coords_to_atoms(&w[i].crd,w[i].at);
+        write_xyz(w[i].at,&w[i].dat,dat->nsteps,f);
+        fclose(f);
+    }
+    if (crd->nlist != NULL)
+        for (i=0; i<nw; i++)
+            fprintf(stdout,"Verlet lists of walker %u were built %"PRIu64" times\n",i,w[i].crd.nlist->nbuild);
+
+    if (w[best].emin < DBL_MAX)
+        fprintf(stdout,"\nLowest minimum found by walker %u : E = %lf\n",best,w[best].emin);
+
+    copy_coords(crd,&w[best].crd);
+    coords_to_atoms(crd,at);
+    *ener = w[best].ener;
+    dat->d_max = w[best].dat.d_max;
+
+    for (i=0; i<nw; i++)
+    {
+        free_MC_chain(&w[i].ch);
+        free_coords(&w[i].crd);
+        free_rand_stream(&w[i].dat);
+        fclose(w[i].efile);
+        fclose(w[i].traj);
+        free(w[i].at);
+    }
+    free(w);
+
+    return acc;
+}
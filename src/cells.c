@@ -0,0 +1,304 @@
+/**
+ * \file cells.c
+ *
+ * \brief Functions managing the cell grid (see CELLS in global.h) used for finding the neighbours
+ *          of an atom within the cutoff of the pair potential
+ *
+ * \authors Florent Hedin (University of Basel, Switzerland) \n
+ *          Markus Meuwly (University of Basel, Switzerland)
+ *
+ * \copyright Copyright (c) 2011-2015, Florent Hedin, Markus Meuwly, and the University of Basel. \n
+ *            All rights reserved. \n
+ *            The 3-clause BSD license is applied to this software. \n
+ *            See LICENSE.txt
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "global.h"
+#include "cells.h"
+#include "logger.h"
+
+/*
+ * Coordinates of the cell containing the point x,y,z along each direction ;
+ * returns 0 if the point is outside of the grid
+ */
+static inline uint32_t cell_coords(CELLS *c, double x, double y, double z, int32_t *cx, int32_t *cy, int32_t *cz)
+{
+    *cx = (int32_t) floor((x-c->ox)*c->ix);
+    *cy = (int32_t) floor((y-c->oy)*c->iy);
+    *cz = (int32_t) floor((z-c->oz)*c->iz);
+
+    return (*cx>=0 && *cx<(int32_t)c->nx && *cy>=0 && *cy<(int32_t)c->ny && *cz>=0 && *cz<(int32_t)c->nz);
+}
+
+static inline void unlink_atom(CELLS *c, uint32_t i)
+{
+    if (c->prev[i] != -1)
+        c->next[c->prev[i]] = c->next[i];
+    else
+        c->head[c->cell[i]] = c->next[i];
+
+    if (c->next[i] != -1)
+        c->prev[c->next[i]] = c->prev[i];
+}
+
+static inline void link_atom(CELLS *c, uint32_t i, uint32_t n)
+{
+    c->cell[i] = n;
+    c->prev[i] = -1;
+    c->next[i] = c->head[n];
+    if (c->head[n] != -1)
+        c->prev[c->head[n]] = (int32_t) i;
+    c->head[n] = (int32_t) i;
+}
+
+/**
+ * @brief Allocates a cell grid for the coordinates store crd and builds it
+ *
+ * @param crd The coordinates store
+ * @param rc The cutoff, i.e. the minimal side of a cell
+ */
+void alloc_cells(COORDS *crd, double rc)
+{
+    CELLS *c = malloc(sizeof *c);
+
+    c->rc = rc;
+    c->maxcell = 0;
+    c->head = NULL;
+    c->next = malloc(crd->natom*sizeof *c->next);
+    c->prev = malloc(crd->natom*sizeof *c->prev);
+    c->cell = malloc(crd->natom*sizeof *c->cell);
+    c->nbuild = 0;
+
+    crd->cells = c;
+    build_cells(crd);
+}
+
+void free_cells(COORDS *crd)
+{
+    CELLS *c = crd->cells;
+
+    if (c == NULL)
+        return;
+
+    free(c->head);
+    free(c->next);
+    free(c->prev);
+    free(c->cell);
+    free(c);
+    crd->cells = NULL;
+}
+
+/**
+ * @brief (Re)builds the grid from the current extent of the system, plus a margin of CELLS_MARGIN cutoffs on
+ *          each side. The cells are at least as large as the cutoff, and larger if needed for keeping
+ *          at most CELLS_PER_ATOM cells per atom.
+ *
+ * @param crd The coordinates store
+ */
+void build_cells(COORDS *crd)
+{
+    uint32_t i;
+    int32_t cx, cy, cz;
+    CELLS *c = crd->cells;
+    double lo[3] = {crd->x[0],crd->y[0],crd->z[0]};
+    double hi[3] = {crd->x[0],crd->y[0],crd->z[0]};
+    double ext[3];
+    double side = c->rc;
+    const double margin = CELLS_MARGIN*c->rc;
+    const uint64_t maxcell = (uint64_t)CELLS_PER_ATOM*crd->natom + 27;
+
+    for (i=1; i<crd->natom; i++)
+    {
+        lo[0] = fmin(lo[0],crd->x[i]); hi[0] = fmax(hi[0],crd->x[i]);
+        lo[1] = fmin(lo[1],crd->y[i]); hi[1] = fmax(hi[1],crd->y[i]);
+        lo[2] = fmin(lo[2],crd->z[i]); hi[2] = fmax(hi[2],crd->z[i]);
+    }
+
+    for (i=0; i<3; i++)
+    {
+        lo[i] -= margin;
+        ext[i] = hi[i] - lo[i] + margin;
+    }
+
+    do
+    {
+        c->nx = (uint32_t) fmax(1.0,floor(ext[0]/side));
+        c->ny = (uint32_t) fmax(1.0,floor(ext[1]/side));
+        c->nz = (uint32_t) fmax(1.0,floor(ext[2]/side));
+        side *= 1.25;
+    }
+    while ((uint64_t)c->nx*c->ny*c->nz > maxcell);
+
+    c->ox = lo[0];
+    c->oy = lo[1];
+    c->oz = lo[2];
+    c->ix = c->nx/ext[0];
+    c->iy = c->ny/ext[1];
+    c->iz = c->nz/ext[2];
+    c->ncell = c->nx*c->ny*c->nz;
+
+    if (c->ncell > c->maxcell)
+    {
+        free(c->head);
+        c->maxcell = c->ncell;
+        c->head = malloc(c->maxcell*sizeof *c->head);
+    }
+
+    for (i=0; i<c->ncell; i++)
+        c->head[i] = -1;
+
+    for (i=0; i<crd->natom; i++)
+    {
+        cell_coords(c,crd->x[i],crd->y[i],crd->z[i],&cx,&cy,&cz);
+        link_atom(c,i,((uint32_t)cz*c->ny + (uint32_t)cy)*c->nx + (uint32_t)cx);
+    }
+
+    c->nbuild++;
+
+    LOG_PRINT(LOG_DEBUG,"Cell grid built (%"PRIu64" times) : %u x %u x %u cells\n",c->nbuild,c->nx,c->ny,c->nz);
+}
+
+/**
+ * @brief Moves atom i to the cell of its new position ; if it left the grid the grid is rebuilt
+ *
+ * @param crd The coordinates store, where atom i already has its new position
+ * @param i Index of the atom
+ */
+void move_cells(COORDS *crd, uint32_t i)
+{
+    int32_t cx, cy, cz;
+    uint32_t n;
+    CELLS *c = crd->cells;
+
+    if (!cell_coords(c,crd->x[i],crd->y[i],crd->z[i],&cx,&cy,&cz))
+    {
+        build_cells(crd);
+        return;
+    }
+
+    n = ((uint32_t)cz*c->ny + (uint32_t)cy)*c->nx + (uint32_t)cx;
+
+    if (n != c->cell[i])
+    {
+        unlink_atom(c,i);
+        link_atom(c,i,n);
+    }
+}
+
+/**
+ * @brief Copies the grid of src to dst, which must already have a grid for the same number of atoms
+ *
+ * @param dst Destination coordinates store
+ * @param src Source coordinates store
+ */
+void copy_cells(COORDS *dst, COORDS *src)
+{
+    CELLS *d = dst->cells;
+    CELLS *s = src->cells;
+
+    if (s->ncell > d->maxcell)
+    {
+        free(d->head);
+        d->maxcell = s->ncell;
+        d->head = malloc(d->maxcell*sizeof *d->head);
+    }
+
+    d->rc = s->rc;
+    d->ox = s->ox; d->oy = s->oy; d->oz = s->oz;
+    d->ix = s->ix; d->iy = s->iy; d->iz = s->iz;
+    d->nx = s->nx; d->ny = s->ny; d->nz = s->nz;
+    d->ncell = s->ncell;
+    d->nbuild = s->nbuild;
+
+    memcpy(d->head,s->head,s->ncell*sizeof *s->head);
+    memcpy(d->next,s->next,src->natom*sizeof *s->next);
+    memcpy(d->prev,s->prev,src->natom*sizeof *s->prev);
+    memcpy(d->cell,s->cell,src->natom*sizeof *s->cell);
+}
+
+/*
+ * Copies the chain of cell n from s to d, which have the same grid : the atoms of this chain get the links of s
+ */
+static inline void copy_chain(CELLS *d, const CELLS *s, uint32_t n)
+{
+    int32_t a;
+
+    d->head[n] = s->head[n];
+    for (a=s->head[n]; a!=-1; a=s->next[a])
+    {
+        d->next[a] = s->next[a];
+        d->prev[a] = s->prev[a];
+        d->cell[a] = n;
+    }
+}
+
+/**
+ * @brief Undoes the moves of atom i in the grid of dst, a copy of src where only a few atoms moved (a trial move) :
+ *          the chains of the cells it left and entered are copied back from src, so that the order of the atoms in
+ *          the cells is exactly the one of src. Nothing is done if the grid of dst was rebuilt, see sync_coords.
+ *          As a chain copied back for an atom may also hold another moved atom, the cell entered is found from the
+ *          position of the atom, which therefore has to be reverted after its cells.
+ *
+ * @param dst The coordinates store where atom i moved, still at its trial position
+ * @param src The coordinates store where atom i did not move
+ * @param i Index of the atom
+ */
+void revert_cells(COORDS *dst, COORDS *src, uint32_t i)
+{
+    int32_t cx, cy, cz;
+    uint32_t n;
+    CELLS *d = dst->cells;
+    CELLS *s = src->cells;
+
+    if (d->nbuild != s->nbuild)
+        return;
+
+    // the grid was not rebuilt, so the trial position is inside
+    cell_coords(d,dst->x[i],dst->y[i],dst->z[i],&cx,&cy,&cz);
+    n = ((uint32_t)cz*d->ny + (uint32_t)cy)*d->nx + (uint32_t)cx;
+
+    copy_chain(d,s,n);
+    if (s->cell[i] != n)
+        copy_chain(d,s,s->cell[i]);
+}
+
+/**
+ * @brief Gets the indices of the cells surrounding (and including) the one containing the point x,y,z.
+ *          As there is no periodicity, cells on the border have less than 27 neighbours.
+ *
+ * @param c The cell grid
+ * @param x,y,z The point, which must be inside the grid
+ * @param nb Where to store the indices
+ * @return The number of neighbour cells
+ */
+uint32_t get_neighbour_cells(CELLS *c, double x, double y, double z, uint32_t nb[27])
+{
+    int32_t cx, cy, cz, a, b, d;
+    uint32_t n = 0;
+
+    cell_coords(c,x,y,z,&cx,&cy,&cz);
+
+    for (d=cz-1; d<=cz+1; d++)
+    {
+        if (d<0 || d>=(int32_t)c->nz)
+            continue;
+        for (b=cy-1; b<=cy+1; b++)
+        {
+            if (b<0 || b>=(int32_t)c->ny)
+                continue;
+            for (a=cx-1; a<=cx+1; a++)
+            {
+                if (a<0 || a>=(int32_t)c->nx)
+                    continue;
+                nb[n++] = ((uint32_t)d*c->ny + (uint32_t)b)*c->nx + (uint32_t)a;
+            }
+        }
+    }
+
+    return n;
+}
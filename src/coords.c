@@ -0,0 +1,387 @@
+/**
+ * \file coords.c
+ *
+ * \brief Functions managing the structure of arrays coordinates store (see COORDS in global.h)
+ *
+ * \authors Florent Hedin (University of Basel, Switzerland) \n
+ *          Markus Meuwly (University of Basel, Switzerland)
+ *
+ * \copyright Copyright (c) 2011-2015, Florent Hedin, Markus Meuwly, and the University of Basel. \n
+ *            All rights reserved. \n
+ *            The 3-clause BSD license is applied to this software. \n
+ *            See LICENSE.txt
+ *
+ */
+
+// required for posix_memalign when compiling with -std=c99
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "global.h"
+#include "coords.h"
+#include "cells.h"
+#include "nlist.h"
+#include "manybody.h"
+
+/**
+ * @brief Allocates an array of n elements of size si, aligned on COORDS_ALIGN bytes, and set to 0.
+ *        The allocated size is rounded up to a multiple of COORDS_ALIGN so that vectorised loops
+ *        may safely read a full vector past the last atom.
+ */
+static void* calloc_aligned(uint32_t n, size_t si)
+{
+    void *array=NULL;
+    size_t bytes = n*si;
+
+    bytes = (bytes/COORDS_ALIGN + 1)*COORDS_ALIGN;
+
+#ifdef __unix__
+    if (posix_memalign(&array,COORDS_ALIGN,bytes) != 0)
+        array=NULL;
+#else
+    array=malloc(bytes);
+#endif
+    assert(array!=NULL);
+
+    memset(array,0,bytes);
+
+    return array;
+}
+
+/**
+ * @brief Allocates the arrays of a coordinates store for natom atoms
+ *
+ * @param crd The coordinates store
+ * @param natom Number of atoms
+ */
+void alloc_coords(COORDS *crd, uint32_t natom)
+{
+    crd->natom = natom;
+    crd->x = calloc_aligned(natom,sizeof *crd->x);
+    crd->y = calloc_aligned(natom,sizeof *crd->y);
+    crd->z = calloc_aligned(natom,sizeof *crd->z);
+    crd->type = calloc_aligned(natom,sizeof *crd->type);
+    crd->sx = crd->sy = crd->sz = 0.0;
+    crd->cells = NULL;
+    crd->nlist = NULL;
+    crd->dens = NULL;
+    crd->xf = crd->yf = crd->zf = NULL;
+}
+
+/*
+ * Single precision copy of the coordinates of atom i
+ */
+static inline void set_mixed(COORDS *crd, uint32_t i)
+{
+    crd->xf[i] = (float) crd->x[i];
+    crd->yf[i] = (float) crd->y[i];
+    crd->zf[i] = (float) crd->z[i];
+}
+
+/**
+ * @brief Allocates the single precision copies of the X,Y,Z coordinates used by the mixed precision kernels
+ *          (PRECISION MIXED), so that they load floats instead of converting each difference of coordinates.
+ *          They are then kept up to date by the other functions of this file.
+ *
+ * @param crd The coordinates store
+ */
+void alloc_coords_mixed(COORDS *crd)
+{
+    crd->xf = calloc_aligned(crd->natom,sizeof *crd->xf);
+    crd->yf = calloc_aligned(crd->natom,sizeof *crd->yf);
+    crd->zf = calloc_aligned(crd->natom,sizeof *crd->zf);
+
+    for (uint32_t i=0; i<crd->natom; i++)
+        set_mixed(crd,i);
+}
+
+/**
+ * @brief Frees the arrays of a coordinates store, and its cell grid, Verlet lists and densities if any
+ *
+ * @param crd The coordinates store
+ */
+void free_coords(COORDS *crd)
+{
+    free(crd->x);
+    free(crd->y);
+    free(crd->z);
+    free(crd->type);
+    free(crd->xf);
+    free(crd->yf);
+    free(crd->zf);
+    crd->x = crd->y = crd->z = NULL;
+    crd->xf = crd->yf = crd->zf = NULL;
+    crd->type = NULL;
+    free_cells(crd);
+    free_nlist(crd);
+    free_density(crd);
+}
+
+/**
+ * @brief Copies the X,Y,Z coordinates (and their sums, and their single precision copies, cell grid, Verlet lists and densities
+ *        if both have them) from src to dst.
+ *        Species are not copied as they never change during a simulation.
+ *
+ * @param dst Destination coordinates store
+ * @param src Source coordinates store
+ */
+void copy_coords(COORDS *dst, COORDS *src)
+{
+    memcpy(dst->x,src->x,src->natom*sizeof(double));
+    memcpy(dst->y,src->y,src->natom*sizeof(double));
+    memcpy(dst->z,src->z,src->natom*sizeof(double));
+    dst->sx = src->sx;
+    dst->sy = src->sy;
+    dst->sz = src->sz;
+
+    if (dst->xf != NULL && src->xf != NULL)
+    {
+        memcpy(dst->xf,src->xf,src->natom*sizeof(float));
+        memcpy(dst->yf,src->yf,src->natom*sizeof(float));
+        memcpy(dst->zf,src->zf,src->natom*sizeof(float));
+    }
+
+    if (dst->cells != NULL && src->cells != NULL)
+        copy_cells(dst,src);
+
+    if (dst->nlist != NULL && src->nlist != NULL)
+        copy_nlist(dst,src);
+
+    if (dst->dens != NULL && src->dens != NULL)
+        copy_density(dst,src);
+}
+
+/**
+ * @brief Allocates dst as a copy of src : coordinates and species, and its own single precision copies, cell grid,
+ *          Verlet lists and densities if src has them. For example the trial copy of a Metropolis chain, or a replica.
+ *
+ * @param dst Coordinates store to allocate
+ * @param src Source coordinates store
+ */
+void clone_coords(COORDS *dst, COORDS *src)
+{
+    alloc_coords(dst,src->natom);
+    memcpy(dst->type,src->type,src->natom*sizeof(uint32_t));
+    copy_coords(dst,src);
+
+    // the single precision copies, the grid, the lists and the densities are then copied from src
+    if (src->xf != NULL)
+        alloc_coords_mixed(dst);
+    if (src->cells != NULL)
+        alloc_cells(dst,src->cells->rc);
+    if (src->nlist != NULL)
+        alloc_nlist(dst,src->nlist->rc,src->nlist->skin);
+    if (src->dens != NULL)
+        alloc_density(dst);
+    copy_coords(dst,src);
+}
+
+/**
+ * @brief Fills a coordinates store (X,Y,Z and species) from an ATOM array
+ *
+ * @param at Atom list
+ * @param crd The coordinates store, already allocated
+ */
+void atoms_to_coords(ATOM at[], COORDS *crd)
+{
+    for (uint32_t i=0; i<crd->natom; i++)
+    {
+        crd->x[i] = at[i].x;
+        crd->y[i] = at[i].y;
+        crd->z[i] = at[i].z;
+        crd->type[i] = at[i].type;
+    }
+
+    refresh_coords(crd);
+}
+
+/**
+ * @brief Updates the X,Y,Z coordinates of an ATOM array from a coordinates store,
+ *          for example before writing a trajectory frame
+ *
+ * @param crd The coordinates store
+ * @param at Atom list
+ */
+void coords_to_atoms(const COORDS *crd, ATOM at[])
+{
+    for (uint32_t i=0; i<crd->natom; i++)
+    {
+        at[i].x = crd->x[i];
+        at[i].y = crd->y[i];
+        at[i].z = crd->z[i];
+    }
+}
+
+/**
+ * @brief Displaces atom i by (dx,dy,dz), for example for a trial move.
+ *          The Verlet lists are not rebuilt if the atom moved too far, they are just not used until the next rebuild.
+ *
+ * @param crd The coordinates store
+ * @param i Index of the atom
+ * @param dx,dy,dz The displacement
+ */
+void move_atom_coords(COORDS *crd, uint32_t i, double dx, double dy, double dz)
+{
+    const double xo = crd->x[i], yo = crd->y[i], zo = crd->z[i];
+
+    crd->x[i] += dx;
+    crd->y[i] += dy;
+    crd->z[i] += dz;
+
+    crd->sx += dx;
+    crd->sy += dy;
+    crd->sz += dz;
+
+    if (crd->xf != NULL)
+        set_mixed(crd,i);
+
+    if (crd->cells != NULL)
+        move_cells(crd,i);
+
+    if (crd->nlist != NULL)
+        move_nlist(crd,i);
+
+    if (crd->dens != NULL)
+        move_density(crd,i,xo,yo,zo);
+}
+
+/**
+ * @brief Places atom i at (x,y,z), for example when copying an accepted move back.
+ *          The Verlet lists are rebuilt if the atom moved too far since they were built.
+ *
+ * @param crd The coordinates store
+ * @param i Index of the atom
+ * @param x,y,z The new position
+ */
+void set_atom_coords(COORDS *crd, uint32_t i, double x, double y, double z)
+{
+    const double xo = crd->x[i], yo = crd->y[i], zo = crd->z[i];
+
+    crd->sx += x - crd->x[i];
+    crd->sy += y - crd->y[i];
+    crd->sz += z - crd->z[i];
+
+    crd->x[i] = x;
+    crd->y[i] = y;
+    crd->z[i] = z;
+
+    if (crd->xf != NULL)
+        set_mixed(crd,i);
+
+    if (crd->cells != NULL)
+        move_cells(crd,i);
+
+    if (crd->nlist != NULL)
+    {
+        move_nlist(crd,i);
+        if (crd->nlist->nfar != 0)
+            build_nlist(crd);
+    }
+
+    if (crd->dens != NULL)
+        move_density(crd,i,xo,yo,zo);
+}
+
+/**
+ * @brief Brings atom i of a trial copy dst back to its position in src, for undoing a rejected move in O(1)
+ *          instead of copying the whole system : the cell grid is restored exactly, as is the distance of the atom
+ *          to its position when the Verlet lists were built. Once all the moved atoms are reverted, sync_coords completes
+ *          the restoration.
+ *
+ * @param dst The trial coordinates store, a copy of src where only a few atoms moved
+ * @param src The reference coordinates store
+ * @param i Index of the atom
+ */
+void revert_atom_coords(COORDS *dst, COORDS *src, uint32_t i)
+{
+    if (dst->cells != NULL && src->cells != NULL)
+        revert_cells(dst,src,i);
+
+    dst->x[i] = src->x[i];
+    dst->y[i] = src->y[i];
+    dst->z[i] = src->z[i];
+
+    if (dst->xf != NULL)
+        set_mixed(dst,i);
+
+    if (dst->nlist != NULL && dst->nlist->stamp == src->nlist->stamp)
+        move_nlist(dst,i);
+}
+
+/**
+ * @brief Makes a trial copy dst identical to src again once the moved atoms were either reverted (revert_atom_coords)
+ *          or placed in src (set_atom_coords) : the sums of the coordinates are copied, and the grid or the lists
+ *          only if one of the two stores rebuilt them in the meantime. Costs O(1) for most steps, or O(N) with
+ *          densities, which are copied back as they are updated in O(N) anyway.
+ *
+ * @param dst The trial coordinates store
+ * @param src The reference coordinates store
+ */
+void sync_coords(COORDS *dst, COORDS *src)
+{
+    dst->sx = src->sx;
+    dst->sy = src->sy;
+    dst->sz = src->sz;
+
+    if (dst->cells != NULL && src->cells != NULL && dst->cells->nbuild != src->cells->nbuild)
+        copy_cells(dst,src);
+
+    if (dst->nlist != NULL && src->nlist != NULL)
+        copy_nlist(dst,src);
+
+    if (dst->dens != NULL && src->dens != NULL)
+        copy_density(dst,src);
+}
+
+/**
+ * @brief Get the center of mass (barycentre) of the system stored in a coordinates store
+ *
+ * @param crd The coordinates store
+ * @return The center of mass of the system
+ */
+CM getCM_coords(const COORDS *crd)
+{
+    CM cm;
+
+    cm.cx = crd->sx/crd->natom;
+    cm.cy = crd->sy/crd->natom;
+    cm.cz = crd->sz/crd->natom;
+
+    return cm;
+}
+
+/**
+ * @brief Recomputes from scratch the sums of the coordinates used by getCM_coords and the single precision copies
+ *          if any, rebuilds the cell grid if any, the Verlet lists if any atom moved too far, and the densities if any.
+ *          Required after all the atoms were moved directly (minimisation), and also
+ *          used from time to time for removing the rounding errors accumulated by the O(1) updates.
+ *
+ * @param crd The coordinates store
+ */
+void refresh_coords(COORDS *crd)
+{
+    crd->sx = crd->sy = crd->sz = 0.0;
+
+    for(uint32_t i=0; i<crd->natom; i++)
+    {
+        crd->sx += crd->x[i];
+        crd->sy += crd->y[i];
+        crd->sz += crd->z[i];
+    }
+
+    if (crd->xf != NULL)
+        for(uint32_t i=0; i<crd->natom; i++)
+            set_mixed(crd,i);
+
+    if (crd->cells != NULL)
+        build_cells(crd);
+
+    if (crd->nlist != NULL)
+        refresh_nlist(crd);
+
+    if (crd->dens != NULL)
+        build_density(crd);
+}
@@ -14,326 +14,1611 @@
  *
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <math.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "global.h"
 #include "tools.h"
+#include "coords.h"
+#include "cells.h"
 #include "ener.h"
+#include "ener_simd.h"
+#include "table.h"
+#include "logger.h"
 
 #ifndef K_CONSTRAINT
 #define K_CONSTRAINT    4.00
 #endif
 
-/* How to call this function :
- *
- *  get_LJV(at,&dat,-1) is for total energy of the whole system.
+/**
+ * @brief Builds the per species pair table of Lennard-Jones coefficients.
  *
- *  get_LJV(at,&dat,candidate_atom_number) is for energy evaluation of candidate_atom_number only.
+ * For each pair of species (ti,tj) the Lorentz-Berthelot mixing rules give eps_ij = sqrt(eps_i*eps_j)
+ * and sig_ij = (sig_i+sig_j)/2 ; the table stores 4*eps_ij*sig_ij^12 and 4*eps_ij*sig_ij^6 so that
+ * the pair loops only have to evaluate c12/r^12 - c6/r^6.
  *
+ * @param dat Common data, dat->ntypes and dat->ljp have to be already set (see parsing.c)
  */
-double get_LJ_V(ATOM at[], DATA *dat, int32_t candidate)
+void build_LJ_table(DATA *dat)
 {
+    uint32_t ti,tj;
+    uint32_t nt = dat->ntypes;
+    double epsi_g, sig_g;
 
-    uint32_t i,j;
-    double dx1,dy1,dz1;
-    double dx2,dy2,dz2;
-    double dcm;
-    double d2, epsi_g, sig_g;
-    double energy = 0.0;
-
-    dat->E_constr = 0.0;
-    CM cm = getCM(at,dat);
+    dat->lj_c12 = malloc(nt*nt*sizeof *dat->lj_c12);
+    dat->lj_c6  = malloc(nt*nt*sizeof *dat->lj_c6);
+    dat->lj_c12f = malloc(nt*nt*sizeof *dat->lj_c12f);
+    dat->lj_c6f  = malloc(nt*nt*sizeof *dat->lj_c6f);
 
-    if (candidate==-1)
+    for (ti=0; ti<nt; ti++)
     {
-        for (i=0; i<(dat->natom); i++)
+        for (tj=0; tj<nt; tj++)
         {
-            dx1=at[i].x;
-            dy1=at[i].y;
-            dz1=at[i].z;
-
-            dcm = X2(cm.cx-dx1) +  X2(cm.cy-dy1) + X2(cm.cz-dz1) ;
-            dat->E_constr += getExtraPot(dcm,at[i].ljp.sig,at[i].ljp.eps);
-
-            for (j=i+1; j<(dat->natom); j++)
-            {
-                dx2=at[j].x;
-                dy2=at[j].y;
-                dz2=at[j].z;
+            epsi_g = sqrt( dat->ljp[ti].eps * dat->ljp[tj].eps );
+            sig_g  = 0.5*( dat->ljp[ti].sig + dat->ljp[tj].sig );
 
-                d2 = X2(dx2-dx1) +  X2(dy2-dy1) + X2(dz2-dz1) ;
-                epsi_g = sqrt( at[i].ljp.eps * at[j].ljp.eps );
-                sig_g  = 0.5*( at[i].ljp.sig + at[j].ljp.sig );
+            dat->lj_c12[ti*nt+tj] = 4.0 * epsi_g * X12(sig_g);
+            dat->lj_c6[ti*nt+tj]  = 4.0 * epsi_g * X6(sig_g);
 
-                energy += 4.0 * epsi_g *( (X12(sig_g))/(X6(d2)) - (X6(sig_g))/(X3(d2)) );
-            }
+            dat->lj_c12f[ti*nt+tj] = (float) dat->lj_c12[ti*nt+tj];
+            dat->lj_c6f[ti*nt+tj]  = (float) dat->lj_c6[ti*nt+tj];
         }
     }
-    else
+
+    // with a shifted cutoff, the energy of each pair of species at the cutoff
+    dat->lj_shift = NULL;
+    if (dat->cut_mode == CUT_SHIFT)
     {
-        i = (uint32_t) candidate;
+        dat->lj_shift = malloc(nt*nt*sizeof *dat->lj_shift);
+        for (ti=0; ti<nt*nt; ti++)
+            dat->lj_shift[ti] = dat->lj_c12[ti]/(X12(dat->cutoff)) - dat->lj_c6[ti]/(X6(dat->cutoff));
+    }
+}
+
+void free_LJ_table(DATA *dat)
+{
+    free(dat->lj_c12);
+    free(dat->lj_c6);
+    free(dat->lj_shift);
+    free(dat->lj_c12f);
+    free(dat->lj_c6f);
+    dat->lj_c12 = NULL;
+    dat->lj_c6 = NULL;
+    dat->lj_c12f = NULL;
+    dat->lj_c6f = NULL;
+    dat->lj_shift = NULL;
+}
+
+/**
+ * @brief Sum of the Lennard-Jones interactions between atom i and atoms [from,to[
+ *
+ * The loop only reads the contiguous x,y,z and type arrays of the coordinates store
+ * and has no branch, so that the compiler is able to vectorise it.
+ * If out is not NULL each pair energy is also stored in out[j].
+ * mix is a compile time constant : when it is 0 all the atoms are of the species of atom i,
+ * so that the coefficients are constants and the type array is not read.
+ */
+static inline double LJ_row(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t from, uint32_t to, double out[], const int mix)
+{
+    const double * restrict x = crd->x;
+    const double * restrict y = crd->y;
+    const double * restrict z = crd->z;
+    const uint32_t * restrict type = crd->type;
 
-        dx1=at[i].x;
-        dy1=at[i].y;
-        dz1=at[i].z;
+    // row of the coefficients table for the species of atom i
+    const double * restrict c12 = dat->lj_c12 + type[i]*dat->ntypes;
+    const double * restrict c6  = dat->lj_c6  + type[i]*dat->ntypes;
+    const double c12i = c12[type[i]], c6i = c6[type[i]];
 
-        dcm = X2(cm.cx-dx1) +  X2(cm.cy-dy1) + X2(cm.cz-dz1) ;
-        dat->E_constr += getExtraPot(dcm,at[i].ljp.sig,at[i].ljp.eps);
+    const double x1=x[i], y1=y[i], z1=z[i];
+    double d2, r6i, e;
+    double energy = 0.0;
 
-        for (j=0; j<(dat->natom); j++)
+    if (out == NULL)
+    {
+        for (uint32_t j=from; j<to; j++)
         {
-            if (j!=i)
-            {
-                dx2=at[j].x;
-                dy2=at[j].y;
-                dz2=at[j].z;
+            d2 = X2(x[j]-x1) + X2(y[j]-y1) + X2(z[j]-z1) ;
+            r6i = 1.0/(X3(d2));
 
-                d2 = X2(dx2-dx1) +  X2(dy2-dy1) + X2(dz2-dz1) ;
-                epsi_g = sqrt( at[i].ljp.eps * at[j].ljp.eps );
-                sig_g  = 0.5*( at[i].ljp.sig + at[j].ljp.sig );
+            energy += mix ? r6i*( c12[type[j]]*r6i - c6[type[j]] ) : r6i*( c12i*r6i - c6i );
+        }
+    }
+    else
+    {
+        for (uint32_t j=from; j<to; j++)
+        {
+            d2 = X2(x[j]-x1) + X2(y[j]-y1) + X2(z[j]-z1) ;
+            r6i = 1.0/(X3(d2));
 
-                energy += 4.0 * epsi_g *( (X12(sig_g))/(X6(d2)) - (X6(sig_g))/(X3(d2)) );
-            }
+            e = mix ? r6i*( c12[type[j]]*r6i - c6[type[j]] ) : r6i*( c12i*r6i - c6i );
+            out[j] = e;
+            energy += e;
         }
     }
 
     return energy;
 }
 
-void get_LJ_DV(ATOM at[], DATA *dat, double fx[], double fy[], double fz[])
+/*
+ * Gradient contributions of the pairs (i,j) with j>i, added to atom i and subtracted from atom j,
+ * so that a full gradient visits each pair only once (see get_LJ_DV) ; returns the energy of those pairs.
+ * mix has the same meaning as for LJ_row.
+ */
+static inline double LJ_DV_row(const COORDS *crd, const DATA *dat, uint32_t i, double fx[], double fy[], double fz[], const int mix)
 {
-    uint32_t i=0 , j=0 ;
-    double epsi_g=0.0 , sig_g=0.0;
+    uint32_t j=0 ;
     double dx=0.0 , dy=0.0 , dz=0.0 , d2=0.0 ;
-    double de=0.0 ;
+    double r2i=0.0 , r6i=0.0 ;
+    double de=0.0 , a=0.0 , b=0.0 ;
+    double gx=0.0, gy=0.0, gz=0.0;
+    double energy=0.0;
 
-    for (i=0 ; i < dat->natom ; i++ )
+    const uint32_t natom = crd->natom;
+    const double * restrict x = crd->x;
+    const double * restrict y = crd->y;
+    const double * restrict z = crd->z;
+    const uint32_t * restrict type = crd->type;
+    const double *c12 = dat->lj_c12 + type[i]*dat->ntypes;
+    const double *c6  = dat->lj_c6  + type[i]*dat->ntypes;
+    const double c12i = c12[type[i]], c6i = c6[type[i]];
+
+    for (j=i+1 ; j < natom ; j++ )
     {
-        fx[i] = 0.0 ;
-        fy[i] = 0.0 ;
-        fz[i] = 0.0 ;
-        for (j=0 ; j < dat->natom ; j++ )
-        {
-            if (i==j) continue ;
-            epsi_g = sqrt( at[i].ljp.eps * at[j].ljp.eps );
-            sig_g  = 0.5*( at[i].ljp.sig + at[j].ljp.sig );
-            dx = at[i].x - at[j].x ;
-            dy = at[i].y - at[j].y ;
-            dz = at[i].z - at[j].z ;
-            d2  = dx*dx + dy*dy + dz*dz ;
-            de = -24.0*epsi_g*( 2.0*(X12(sig_g))/(X6(d2)) - (X6(sig_g))/(X3(d2)) ) / d2 ;
-            fx[i] += de*dx;
-            fy[i] += de*dy;
-            fz[i] += de*dz;
-        }
+        dx = x[i] - x[j] ;
+        dy = y[i] - y[j] ;
+        dz = z[i] - z[j] ;
+        d2  = dx*dx + dy*dy + dz*dz ;
+        r2i = 1.0/d2;
+        r6i = X3(r2i);
+        a = mix ? c12[type[j]] : c12i;
+        b = mix ? c6[type[j]] : c6i;
+        energy += r6i*( a*r6i - b );
+        // -24*eps*(2*sig^12/r^12 - sig^6/r^6)/r^2 written with the tabulated 4*eps*sig^n terms
+        de = -6.0*r6i*( 2.0*a*r6i - b )*r2i ;
+        gx += de*dx;
+        gy += de*dy;
+        gz += de*dz;
+        fx[j] -= de*dx;
+        fy[j] -= de*dy;
+        fz[j] -= de*dz;
     }
+
+    fx[i] += gx ;
+    fy[i] += gy ;
+    fz[i] += gz ;
+
+    return energy;
 }
 
-double get_AZIZ_V(ATOM at[], DATA *dat, int32_t candidate)
+/*
+ * Scalar (reference) kernels : pair energy of the whole system, of one candidate, energies of the pairs
+ * of one candidate, and gradient. They are instantiated for mixtures (MIX=1) and for systems of
+ * a single species (MIX=0), see init_LJ_kernels.
+ */
+#define LJ_SCALAR_KERNELS(name,MIX) \
+static double LJ_V_full_##name(const COORDS *crd, const DATA *dat) \
+{ \
+    double energy = 0.0; \
+    for (uint32_t i=0; i<crd->natom; i++) \
+        energy += LJ_row(crd,dat,i,i+1,crd->natom,NULL,MIX); \
+    return energy; \
+} \
+\
+static double LJ_V_cand_##name(const COORDS *crd, const DATA *dat, uint32_t candidate) \
+{ \
+    /* the loop is split around the candidate so that there is no j!=i test */ \
+    return LJ_row(crd,dat,candidate,0,candidate,NULL,MIX) \
+           + LJ_row(crd,dat,candidate,candidate+1,crd->natom,NULL,MIX); \
+} \
+\
+static double LJ_V_row_##name(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[]) \
+{ \
+    row[candidate] = 0.0; \
+    return LJ_row(crd,dat,candidate,0,candidate,row,MIX) \
+           + LJ_row(crd,dat,candidate,candidate+1,crd->natom,row,MIX); \
+} \
+\
+static double LJ_DV_row_##name(const COORDS *crd, const DATA *dat, uint32_t i, double fx[], double fy[], double fz[]) \
+{ \
+    return LJ_DV_row(crd,dat,i,fx,fy,fz,MIX); \
+} \
+\
+static double LJ_V_range_##name(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t from, uint32_t to, double out[]) \
+{ \
+    return LJ_row(crd,dat,i,from,to,out,MIX); \
+}
+
+LJ_SCALAR_KERNELS(scalar,1)
+LJ_SCALAR_KERNELS(scalar_single,0)
+
+/*
+ * Same as LJ_row in float (PRECISION MIXED) : the single precision copies of the coordinates are read, and only
+ * the pair energies are summed in double
+ */
+static inline double LJ_row_mixed(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t from, uint32_t to, double out[])
 {
+    const float * restrict x = crd->xf;
+    const float * restrict y = crd->yf;
+    const float * restrict z = crd->zf;
+    const uint32_t * restrict type = crd->type;
 
-    uint32_t i,j;
-    double d, d2, energy=0.0, etmp;
+    const float * restrict c12 = dat->lj_c12f + type[i]*dat->ntypes;
+    const float * restrict c6  = dat->lj_c6f  + type[i]*dat->ntypes;
 
-    if (candidate==-1)
+    const float x1=x[i], y1=y[i], z1=z[i];
+    float d2, r6i, e;
+    double energy = 0.0;
+
+    for (uint32_t j=from; j<to; j++)
     {
-        for (i=0; i<(dat->natom-1); i++)
-        {
-            for (j=i+1; j<(dat->natom); j++)
-            {
-                d2 = X2(at[i].x-at[j].x) +  X2(at[i].y-at[j].y) + X2(at[i].z-at[j].z) ;
-                d = sqrt(d2);
+        d2 = X2(x[j]-x1) + X2(y[j]-y1) + X2(z[j]-z1) ;
+        r6i = 1.0f/(X3(d2));
+
+        e = r6i*( c12[type[j]]*r6i - c6[type[j]] );
+        if (out != NULL)
+            out[j] = e;
+        energy += e;
+    }
+
+    return energy;
+}
 
-                if(!strcmp(at[i].sym,at[j].sym)) //if the same type (strcmp return 0 if identical)
-                {
-                    if (!strcmp(at[i].sym,"Ne")) //both are neon
-                        etmp=aziz_ne_ne(d);
-                    else	//both are argon
-                        etmp=aziz_ar_ar(d);
+static double LJ_V_full_mixed_scalar(const COORDS *crd, const DATA *dat)
+{
+    double energy = 0.0;
 
-                }
-                else //if different type it means it is 1 Ar and 1 Ne
-                    etmp=aziz_ar_ne(d);
+    for (uint32_t i=0; i<crd->natom; i++)
+        energy += LJ_row_mixed(crd,dat,i,i+1,crd->natom,NULL);
 
-                energy += etmp;
-            }
+    return energy;
+}
+
+static double LJ_V_cand_mixed_scalar(const COORDS *crd, const DATA *dat, uint32_t candidate)
+{
+    return LJ_row_mixed(crd,dat,candidate,0,candidate,NULL)
+           + LJ_row_mixed(crd,dat,candidate,candidate+1,crd->natom,NULL);
+}
+
+static double LJ_V_row_mixed_scalar(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[])
+{
+    row[candidate] = 0.0;
+    return LJ_row_mixed(crd,dat,candidate,0,candidate,row)
+           + LJ_row_mixed(crd,dat,candidate,candidate+1,crd->natom,row);
+}
+
+static double LJ_V_range_mixed_scalar(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t from, uint32_t to, double out[])
+{
+    return LJ_row_mixed(crd,dat,i,from,to,out);
+}
+
+/// the different sets of kernels, the first one is the default
+static LJ_KERNELS LJ_kernels_list[] =
+{
+    {"scalar",LJ_V_full_scalar,LJ_V_cand_scalar,LJ_DV_row_scalar,LJ_V_row_scalar,LJ_V_range_scalar},
+#ifdef SIMD_KERNELS
+    {"AVX2",LJ_V_full_avx2,LJ_V_cand_avx2,LJ_DV_row_avx2,LJ_V_row_avx2,LJ_V_range_avx2},
+    {"AVX-512",LJ_V_full_avx512,LJ_V_cand_avx512,LJ_DV_row_avx512,LJ_V_row_avx512,LJ_V_range_avx512},
+#endif
+};
+
+/// the same for systems of a single species, in the same order
+static LJ_KERNELS LJ_kernels_single[] =
+{
+    {"scalar (single species)",LJ_V_full_scalar_single,LJ_V_cand_scalar_single,LJ_DV_row_scalar_single,LJ_V_row_scalar_single,LJ_V_range_scalar_single},
+#ifdef SIMD_KERNELS
+    {"AVX2 (single species)",LJ_V_full_avx2_single,LJ_V_cand_avx2_single,LJ_DV_row_avx2_single,LJ_V_row_avx2_single,LJ_V_range_avx2_single},
+    {"AVX-512 (single species)",LJ_V_full_avx512_single,LJ_V_cand_avx512_single,LJ_DV_row_avx512_single,LJ_V_row_avx512_single,LJ_V_range_avx512_single},
+#endif
+};
+
+/// the same in mixed precision, in the same order ; the gradient stays in double as the minimiser needs it
+static LJ_KERNELS LJ_kernels_mixed[] =
+{
+    {"scalar (mixed precision)",LJ_V_full_mixed_scalar,LJ_V_cand_mixed_scalar,LJ_DV_row_scalar,LJ_V_row_mixed_scalar,LJ_V_range_mixed_scalar},
+#ifdef SIMD_KERNELS
+    {"AVX2 (mixed precision)",LJ_V_full_mixed_avx2,LJ_V_cand_mixed_avx2,LJ_DV_row_avx2,LJ_V_row_mixed_avx2,LJ_V_range_mixed_avx2},
+    {"AVX-512 (mixed precision)",LJ_V_full_mixed_avx512,LJ_V_cand_mixed_avx512,LJ_DV_row_avx512,LJ_V_row_mixed_avx512,LJ_V_range_mixed_avx512},
+#endif
+};
+
+/// the set of kernels used by get_LJ_V and get_LJ_DV
+static LJ_KERNELS *LJ_kern = &LJ_kernels_list[0];
+
+/// the double precision set for the same cpu, used for checking the mixed precision kernels
+static LJ_KERNELS *LJ_kern_ref = &LJ_kernels_list[0];
+
+/// 1 when all the atoms are of the same species : the constraint of the whole system then reads one set of parameters
+static uint32_t LJ_single = 0;
+
+/**
+ * @brief Selects, depending of the instructions supported by the cpu, the fastest set of kernels used by
+ *          get_LJ_V and get_LJ_DV. When all the atoms are of the same species, the variant without any
+ *          mixing of the coefficients is used. This has to be called once at startup.
+ *
+ * @param crd The coordinates store, for the species of the atoms
+ * @param dat Common data ; with dat->precision set to PREC_MIXED the mixed precision variants of the energy kernels are used
+ * @return The name of the selected set of kernels, e.g. "scalar", "AVX2" or "AVX-512 (single species)"
+ */
+const char* init_LJ_kernels(const COORDS *crd, const DATA *dat)
+{
+    uint32_t k = 0;
+    uint32_t i, single = 1;
+
+#ifdef SIMD_KERNELS
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f"))
+        k = 2;
+    else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        k = 1;
+#endif
+
+    for (i=1; i<crd->natom; i++)
+    {
+        if (crd->type[i] != crd->type[0])
+        {
+            single = 0;
+            break;
         }
     }
+
+    LJ_single = single;
+    LJ_kern_ref = single ? &LJ_kernels_single[k] : &LJ_kernels_list[k];
+
+    if (dat->precision == PREC_MIXED)
+        LJ_kern = &LJ_kernels_mixed[k];
     else
+        LJ_kern = LJ_kern_ref;
+
+    LOG_PRINT(LOG_INFO,"Lennard-Jones kernels selected : %s\n",LJ_kern->name);
+
+    return LJ_kern->name;
+}
+
+/**
+ * @brief The pair energy of the whole system always evaluated in double precision, i.e. get_LJ_V(crd,dat,-1)
+ *          without the constraint ; used for checking the mixed precision kernels.
+ */
+double get_LJ_V_ref(const COORDS *crd, const DATA *dat)
+{
+    return LJ_kern_ref->full(crd,dat);
+}
+
+/**
+ * @brief Periodic check of the mixed precision kernels : prints the error of a full evaluation compared to
+ *          the double precision one and, if ener is not NULL, the drift of the running energy of a simulation,
+ *          which is then replaced by the double precision value.
+ *
+ * @param crd Coordinates of the committed configuration
+ * @param dat Common data
+ * @param step The current simulation step
+ * @param ener Running energy of the simulation, or NULL
+ * @param name Name of the replica or walker checked, printed with the step ; an empty string for a single chain
+ */
+void check_LJ_mixed(const COORDS *crd, const DATA *dat, uint64_t step, double *ener, const char *name)
+{
+    const double ref = get_LJ_V_ref(crd,dat);
+    const double err = LJ_kern->full(crd,dat) - ref;
+    const char *sep = (name[0] != '\0') ? ", " : "";
+
+    // the replicas and walkers are checked concurrently
+#ifdef _OPENMP
+    #pragma omp critical (check_mixed)
+#endif
     {
-        i = (uint32_t) candidate;
-        for (j=0; j<(dat->natom); j++)
-        {
-            if (j!=i)
-            {
-                d2 = X2(at[i].x-at[j].x) +  X2(at[i].y-at[j].y) + X2(at[i].z-at[j].z) ;
-                d = sqrt(d2);
+        if (ener != NULL)
+            fprintf(stdout,"Mixed precision check (step %"PRIu64"%s%s): E = %.6lf, error = %.3e, drift = %.3e\n",step,sep,name,ref,err,*ener-ref);
+        else
+            fprintf(stdout,"Mixed precision check (step %"PRIu64"%s%s): E = %.6lf, error = %.3e\n",step,sep,name,ref,err);
+    }
 
-                if(!strcmp(at[i].sym,at[j].sym)) //if the same type (strcmp return 0 if identical)
-                {
-                    if (!strcmp(at[i].sym,"Ne")) //both are neon
-                        etmp=aziz_ne_ne(d);
-                    else	//both are argon
-                        etmp=aziz_ar_ar(d);
+    if (ener != NULL)
+        *ener = ref;
+}
 
-                }
-                else //if different type it means it is 1 Ar and 1 Ne
-                    etmp=aziz_ar_ne(d);
+/*
+ * Pairwise sum of v[0..n-1], always split at the same places so that the result only depends on the values
+ */
+static double pairwise_sum(const double v[], uint32_t n)
+{
+    uint32_t h;
+    double sum = 0.0;
 
-                energy += etmp;
-            }
-        }
+    if (n <= 8)
+    {
+        for (h=0; h<n; h++)
+            sum += v[h];
+        return sum;
     }
 
-    return energy*CM1TOKJM*JTOCAL;
+    h = n/2;
+
+    return pairwise_sum(v,h) + pairwise_sum(v+h,n-h);
 }
 
-double getExtraPot(double d2, double sig, double eps)
+/**
+ * @brief Pair energy of the whole system for REDUCTION DETERMINISTIC : the energy of each row of pairs (i,j>i)
+ *          is computed by a single thread and stored, and the rows are then summed pairwise in a fixed order,
+ *          so that the result is the same with any number of threads and with or without OpenMP
+ *
+ * @param crd The coordinates store
+ * @param dat Common data
+ * @param range The function returning the energy of a row of pairs
+ */
+double get_V_full_det(const COORDS *crd, const DATA *dat, PAIR_RANGE range)
 {
-    double vc = d2/(X2(K_CONSTRAINT*sig));
-    vc=pow(vc,10.0);
-    vc*=eps;
+    const int64_t natom = (int64_t) crd->natom;
+    double *erow = malloc(crd->natom*sizeof *erow);
+    double energy;
+    int64_t i;
 
-    return vc;
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic,16) if(OMP_FULL(crd))
+#endif
+    for (i=0; i<natom; i++)
+        erow[i] = range(crd,dat,(uint32_t)i,(uint32_t)i+1,(uint32_t)natom,NULL);
 
-//     return 0.0;
+    energy = pairwise_sum(erow,crd->natom);
+    free(erow);
 
+    return energy;
 }
 
-double aziz_ne_ne(double r)
+/**
+ * @brief Pair energy of a candidate for REDUCTION DETERMINISTIC : the atoms j are split in blocks of DET_BLOCK atoms
+ *          whatever the number of threads, each block being summed by a single thread, and the blocks are then
+ *          summed pairwise in a fixed order
+ *
+ * @param crd The coordinates store
+ * @param dat Common data
+ * @param candidate The candidate atom
+ * @param row If not NULL each pair energy is also stored in row[j], and row[candidate] is set to 0
+ * @param range The function returning the energy of a range of pairs
+ */
+double get_V_cand_det(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[], PAIR_RANGE range)
 {
-    // HFD-B potential from Aziz, Chem. Phys. 130 (1989) p 187
-    // reads r in angstroems gives potential energy in cm-1.
+    const uint32_t natom = crd->natom;
+    const int64_t nblk = (natom+DET_BLOCK-1)/DET_BLOCK;
+    double one, energy;
+    double *eblk = (nblk > 1) ? malloc(nblk*sizeof *eblk) : &one;
+    int64_t b;
+
+    if (row != NULL)
+        row[candidate] = 0.0;
+
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static) if(nblk > 1 && OMP_CAND)
+#endif
+    for (b=0; b<nblk; b++)
+    {
+        const uint32_t from = (uint32_t) b*DET_BLOCK;
+        const uint32_t to = (from+DET_BLOCK < natom) ? from+DET_BLOCK : natom;
 
-    // local
-    double x;
-    double v_star;
-    double x2,x4,x6,x8,x10,f;
+        if (candidate >= from && candidate < to)
+            eblk[b] = range(crd,dat,candidate,from,candidate,row) + range(crd,dat,candidate,candidate+1,to,row);
+        else
+            eblk[b] = range(crd,dat,candidate,from,to,row);
+    }
+
+    energy = pairwise_sum(eblk,(uint32_t)nblk);
+    if (nblk > 1)
+        free(eblk);
+
+    return energy;
+}
+
+#ifdef _OPENMP
+/// see init_omp_cand
+uint32_t cand_omp = 0;
 
-    // local constants
-    const double a_s=8.9571795e+5;
-    const double alpha_s=13.86434671;
-    const double c_6=1.21317545;
-    const double c_8=0.53222749;
-    const double c_10=0.24570703;
-    const double beta_s=-0.12993822;
-    const double d=1.36;
-    const double epsi=42.25*0.695039;
-    const double r_m=3.091;
+/**
+ * @brief Pair energy of the whole system with the rows (i,j>i) distributed over the threads ; as the rows are
+ *          shorter and shorter they are distributed dynamically
+ *
+ * @param crd The coordinates store
+ * @param dat Common data
+ * @param range The function returning the energy of a row of pairs
+ */
+double get_V_full_omp(const COORDS *crd, const DATA *dat, PAIR_RANGE range)
+{
+    double energy = 0.0;
+    const int64_t natom = (int64_t) crd->natom;
+    int64_t i;
 
-    // output
-    double pot;
+    #pragma omp parallel for schedule(dynamic,16) reduction(+:energy)
+    for (i=0; i<natom; i++)
+        energy += range(crd,dat,(uint32_t)i,(uint32_t)i+1,(uint32_t)natom,NULL);
 
+    return energy;
+}
 
-    x=r/r_m;
+/**
+ * @brief Pair energy of a candidate with the atoms j split in one contiguous block per thread
+ *
+ * @param crd The coordinates store
+ * @param dat Common data
+ * @param candidate The candidate atom
+ * @param row If not NULL each pair energy is also stored in row[j], and row[candidate] is set to 0
+ * @param range The function returning the energy of a range of pairs
+ */
+double get_V_cand_omp(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[], PAIR_RANGE range)
+{
+    double energy = 0.0;
+    const uint64_t natom = crd->natom;
 
-    f=exp(-X2(d/x-1.));
+    if (row != NULL)
+        row[candidate] = 0.0;
 
-    if (x>=d)
-        f=1.;
+    #pragma omp parallel reduction(+:energy)
+    {
+        const uint64_t t = (uint64_t) omp_get_thread_num();
+        const uint64_t nth = (uint64_t) omp_get_num_threads();
+        const uint32_t from = (uint32_t) (natom*t/nth);
+        const uint32_t to = (uint32_t) (natom*(t+1)/nth);
 
-    x2=x*x;
-    x4=x2*x2;
-    x6=x2*x4;
-    x8=x4*x4;
-    x10=x4*x6;
+        if (candidate >= from && candidate < to)
+            energy += range(crd,dat,candidate,from,candidate,row) + range(crd,dat,candidate,candidate+1,to,row);
+        else
+            energy += range(crd,dat,candidate,from,to,row);
+    }
 
-    v_star=a_s*exp(-alpha_s*x+beta_s*X2(x))-f*(c_6/x6+c_8/x8+c_10/x10);
+    return energy;
+}
 
-    pot=epsi*v_star;
+/**
+ * @brief Decides at startup if the energy of a candidate is evaluated in parallel (see cand_omp) : only for
+ *          systems of at least CAND_OMP_MIN atoms and with at least 2 threads. As the parallel sum is split in one
+ *          block per thread, which changes the rounding, the decision only depends on the system and on the number
+ *          of threads, so that a run is reproducible for a given seed and -np. The plugin potentials and the
+ *          potentials with a cutoff are always evaluated sequentially.
+ *
+ * @param crd The initial coordinates
+ */
+void init_omp_cand(const COORDS *crd)
+{
+    cand_omp = (crd->natom >= CAND_OMP_MIN && omp_get_max_threads() > 1 &&
+                (get_ENER == &(get_LJ_V) || get_ENER == &(get_AZIZ_V) || get_ENER == &(get_TAB_V)));
 
-    return pot;
+    if (cand_omp)
+        fprintf(stdout,"Energy of a candidate evaluated in parallel with %d threads\n",omp_get_max_threads());
+    else
+        fprintf(stdout,"Energy of a candidate evaluated sequentially\n");
 }
 
-double aziz_ar_ne(double r)
+#endif
+
+/*
+ * the current L-J kernels as a PAIR_RANGE
+ */
+static double LJ_V_range(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t from, uint32_t to, double out[])
 {
-    // HFD-B potential from Barrow, Aziz, JCP 89, 6189 (1988)
-    // reads r in angstroems gives potential energy in cm-1.
-    
-    // local
-    double x;
-    double v_star;
-    double x2,x4,x6,x8,x10,x12,f;
-
-    // local constants
-    const double a_s=1.651205e+5;
-    const double alpha_s=9.69290567;
-    const double c_6=1.09781826;
-    const double c_8=0.34284623;
-    const double c_10=0.30103922;
-    const double c_12=0.74483225;
-    const double beta_s=-2.27380851;
-    const double d=1.44;
-    const double epsi=67.59*0.695039;
-    const double r_m=3.4889;
-    
-    // received
-    double pot;
-
-    x=r/r_m;
-
-    f=exp(-X2(d/x-1.));
-    
-    if (x>=d)
-        f=1.;
-
-    x2=x*x;
-    x4=x2*x2;
-    x6=x2*x4;
-    x8=x4*x4;
-    x10=x4*x6;
-    x12=x6*x6;
-
-    v_star=a_s*exp(-alpha_s*x+beta_s*X2(x))-f*(c_6/x6+c_8/x8+c_10/x10+c_12/x12);
-
-    pot=epsi*v_star;
-
-    return pot;
+    return LJ_kern->range(crd,dat,i,from,to,out);
 }
 
-double aziz_ar_ar(double r)
+/* How to call this function :
+ *
+ *  get_LJV(crd,&dat,-1) is for total energy of the whole system.
+ *
+ *  get_LJV(crd,&dat,candidate_atom_number) is for energy evaluation of candidate_atom_number only.
+ *
+ */
+ENERGY get_LJ_V(const COORDS *crd, const DATA *dat, int32_t candidate)
+{
+    ENERGY e;
+
+    e.constr = get_LJ_CONSTR(crd,dat,candidate);
+
+    if (dat->det_sum)
+    {
+        e.pair = (candidate==-1) ? get_V_full_det(crd,dat,LJ_V_range) : get_V_cand_det(crd,dat,(uint32_t)candidate,NULL,LJ_V_range);
+        return e;
+    }
+
+#ifdef _OPENMP
+    if (candidate==-1 && OMP_FULL(crd))
+        e.pair = get_V_full_omp(crd,dat,LJ_V_range);
+    else if (candidate!=-1 && OMP_CAND)
+        e.pair = get_V_cand_omp(crd,dat,(uint32_t)candidate,NULL,LJ_V_range);
+    else
+#endif
+    if (candidate==-1)
+        e.pair = LJ_kern->full(crd,dat);
+    else
+        e.pair = LJ_kern->cand(crd,dat,(uint32_t)candidate);
+
+    return e;
+}
+
+/**
+ * @brief Same as get_LJ_V(crd,dat,candidate) but each pair energy of the candidate is also stored
+ *          in row[j] (row[candidate] is set to 0). Used for the per atom energy cache.
+ *          The constraint is not evaluated here, see get_LJ_CONSTR.
+ */
+double get_LJ_V_row(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[])
+{
+    if (dat->det_sum)
+        return get_V_cand_det(crd,dat,candidate,row,LJ_V_range);
+
+#ifdef _OPENMP
+    if (OMP_CAND)
+        return get_V_cand_omp(crd,dat,candidate,row,LJ_V_range);
+#endif
+
+    return LJ_kern->row(crd,dat,candidate,row);
+}
+
+/**
+ * @brief The constraint energy avoiding evaporation (see getExtraPot), for the whole system (candidate=-1)
+ *          or for a candidate atom only
+ */
+double get_LJ_CONSTR(const COORDS *crd, const DATA *dat, int32_t candidate)
+{
+    uint32_t i;
+    double dcm;
+    double E_constr = 0.0;
+    CM cm = getCM_coords(crd);
+
+    if (candidate==-1 && LJ_single)
+    {
+        const double sig = dat->ljp[crd->type[0]].sig, eps = dat->ljp[crd->type[0]].eps;
+
+        for (i=0; i<crd->natom; i++)
+        {
+            dcm = X2(cm.cx-crd->x[i]) +  X2(cm.cy-crd->y[i]) + X2(cm.cz-crd->z[i]) ;
+            E_constr += getExtraPot(dcm,sig,eps);
+        }
+    }
+    else if (candidate==-1)
+    {
+        for (i=0; i<crd->natom; i++)
+        {
+            dcm = X2(cm.cx-crd->x[i]) +  X2(cm.cy-crd->y[i]) + X2(cm.cz-crd->z[i]) ;
+            E_constr += getExtraPot(dcm,dat->ljp[crd->type[i]].sig,dat->ljp[crd->type[i]].eps);
+        }
+    }
+    else
+    {
+        i = (uint32_t) candidate;
+
+        dcm = X2(cm.cx-crd->x[i]) +  X2(cm.cy-crd->y[i]) + X2(cm.cz-crd->z[i]) ;
+        E_constr = getExtraPot(dcm,dat->ljp[crd->type[i]].sig,dat->ljp[crd->type[i]].eps);
+    }
+
+    return E_constr;
+}
+
+#ifdef _OPENMP
+/*
+ * Parallel half loop gradient : each thread accumulates the rows it is given in its own
+ * force buffer, so that the scatter to the atoms j needs no synchronisation, and the buffers
+ * are then summed per atom. Returns the pair energy.
+ * The buffers belong to the call, so that concurrent calls are safe ; their allocation is
+ * negligible compared to the O(N^2) loop.
+ */
+static double LJ_DV_omp(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[])
+{
+    double energy = 0.0;
+    const int64_t natom = (int64_t) crd->natom;
+    const int nth = omp_get_max_threads();
+    const size_t stride = 3*(size_t)natom;
+    double *buf = calloc(nth*stride,sizeof *buf);
+
+    #pragma omp parallel num_threads(nth)
+    {
+        int64_t i;
+        double *bx = buf + omp_get_thread_num()*stride;
+        double *by = bx + natom;
+        double *bz = by + natom;
+
+        // the rows are shorter and shorter so they are distributed dynamically
+        #pragma omp for schedule(dynamic,16) reduction(+:energy)
+        for (i=0; i<natom; i++)
+            energy += LJ_kern->grad_row(crd,dat,(uint32_t)i,bx,by,bz);
+
+        #pragma omp for schedule(static)
+        for (i=0; i<natom; i++)
+        {
+            double gx=0.0, gy=0.0, gz=0.0;
+            for (int t=0; t<nth; t++)
+            {
+                gx += buf[t*stride+i];
+                gy += buf[t*stride+natom+i];
+                gz += buf[t*stride+2*natom+i];
+            }
+            fx[i] = gx;
+            fy[i] = gy;
+            fz[i] = gz;
+        }
+    }
+
+    free(buf);
+
+    return energy;
+}
+#endif
+
+/**
+ * @brief Gradient of the Lennard-Jones energy : each pair is visited once and its force applied to both atoms.
+ *          When compiled with OpenMP, systems of at least LJ_DV_OMP_MIN atoms use the parallel version.
+ */
+void get_LJ_DV(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[])
 {
-    //HFD-B potential from Aziz, JCP 92, 1030 (1990)
-    //reads r in angstroems gives potential energy in cm-1.
-    
-    // local
-    double x;
-    double v_star;
-    double x2,x4,x6,x8,x10,f;
+    const uint32_t natom = crd->natom;
+
+#ifdef _OPENMP
+    if (!dat->det_sum && OMP_FULL(crd))
+    {
+        LJ_DV_omp(crd,dat,fx,fy,fz);
+        return;
+    }
+#endif
 
-    // local constants
-    const double a_s=1.14211845e+5;
-    const double alpha_s=9.00053441;
-    const double c_6=1.09971113;
-    const double c_8=0.54511632;
-    const double c_10=0.39278653;
-    const double beta_s=-2.60270226;
-    const double d=1.04;
-    const double epsi=143.25*0.695039;
-    const double r_m=3.761;
-    
-    // received
-    double pot;
+    memset(fx,0,natom*sizeof(double));
+    memset(fy,0,natom*sizeof(double));
+    memset(fz,0,natom*sizeof(double));
 
-    x=r/r_m;
+    for (uint32_t i=0; i<natom; i++)
+        LJ_kern->grad_row(crd,dat,i,fx,fy,fz);
+}
 
-    f=exp(-X2(d/x-1.));
-    
-    if (x>=d)
-        f=1.;
+/**
+ * @brief Total Lennard-Jones energy (as get_LJ_V(crd,dat,-1), including the constraint)
+ *          and its gradient evaluated in the same sweep over the pairs ; used by the minimiser.
+ */
+ENERGY get_LJ_V_DV(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[])
+{
+    const uint32_t natom = crd->natom;
+    ENERGY e = {0.0, get_LJ_CONSTR(crd,dat,-1)};
 
-    x2=x*x;
-    x4=x2*x2;
-    x6=x2*x4;
-    x8=x4*x4;
-    x10=x4*x6;
+#ifdef _OPENMP
+    if (!dat->det_sum && OMP_FULL(crd))
+    {
+        e.pair = LJ_DV_omp(crd,dat,fx,fy,fz);
+        return e;
+    }
+#endif
 
-    v_star=a_s*exp(-alpha_s*x+beta_s*X2(x))-f*(c_6/x6+c_8/x8+c_10/x10);
+    memset(fx,0,natom*sizeof(double));
+    memset(fy,0,natom*sizeof(double));
+    memset(fz,0,natom*sizeof(double));
 
-    pot=epsi*v_star;
+    for (uint32_t i=0; i<natom; i++)
+        e.pair += LJ_kern->grad_row(crd,dat,i,fx,fy,fz);
 
-    return pot;
+    return e;
 }
 
+/*
+ * L-J energy of a pair of atoms at a squared distance d2 with a cutoff (see CUTOFF_MODE in global.h) ;
+ * if de is not NULL the derivative (dV/dr)/r is also stored, so that the gradient on atom i is de*(xi-xj)
+ */
+static inline double LJ_cut_pair(const DATA *dat, uint32_t ti, uint32_t tj, double d2, double *de)
+{
+    const uint32_t p = ti*dat->ntypes + tj;
+    const double rc2 = X2(dat->cutoff);
+    double r2i, r6i, e, s, ds, ron2;
+
+    if (d2 >= rc2)
+    {
+        if (de != NULL)
+            *de = 0.0;
+        return 0.0;
+    }
+
+    r2i = 1.0/d2;
+    r6i = X3(r2i);
+    e = r6i*( dat->lj_c12[p]*r6i - dat->lj_c6[p] );
+
+    if (de != NULL)
+        *de = -6.0*r6i*( 2.0*dat->lj_c12[p]*r6i - dat->lj_c6[p] )*r2i;
+
+    if (dat->cut_mode == CUT_SHIFT)
+        e -= dat->lj_shift[p];
+    else if (dat->cut_mode == CUT_SWITCH)
+    {
+        ron2 = X2(dat->cuton);
+        if (d2 > ron2)
+        {
+            // CHARMM like switching function of r^2, from 1 at ron to 0 at rc with zero derivatives at both ends
+            s  = X2(rc2-d2)*(rc2+2.0*d2-3.0*ron2)/(X3(rc2-ron2));
+            ds = 6.0*(rc2-d2)*(ron2-d2)/(X3(rc2-ron2));
+            if (de != NULL)
+                *de = (*de)*s + 2.0*e*ds;
+            e *= s;
+        }
+    }
+
+    return e;
+}
+
+/*
+ * Sum of the L-J interactions with a cutoff between atom i and the atoms j!=i with j>=jmin, where jmin is 0 or i+1 ;
+ * only the neighbours of atom i are visited if the coordinates store has valid Verlet lists,
+ * or the 27 cells around atom i if it has a cell grid
+ */
+static double LJ_cut_row(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t jmin)
+{
+    uint32_t j, k, n;
+    int32_t l;
+    uint32_t nb[27];
+    double energy = 0.0;
+    const double xi = crd->x[i], yi = crd->y[i], zi = crd->z[i];
+    const uint32_t ti = crd->type[i];
+
+    if (crd->nlist != NULL && crd->nlist->nfar == 0)
+    {
+        const NLIST *nl = crd->nlist;
+        const uint32_t end = (jmin==0) ? nl->start[i+1] : nl->half[i];
+
+        for (k=nl->start[i]; k<end; k++)
+        {
+            j = nl->nb[k];
+            energy += LJ_cut_pair(dat,ti,crd->type[j],X2(xi-crd->x[j])+X2(yi-crd->y[j])+X2(zi-crd->z[j]),NULL);
+        }
+
+        return energy;
+    }
+
+    if (crd->cells == NULL)
+    {
+        for (j=jmin; j<crd->natom; j++)
+            if (j!=i)
+                energy += LJ_cut_pair(dat,ti,crd->type[j],X2(xi-crd->x[j])+X2(yi-crd->y[j])+X2(zi-crd->z[j]),NULL);
+
+        return energy;
+    }
+
+    n = get_neighbour_cells(crd->cells,xi,yi,zi,nb);
+    for (k=0; k<n; k++)
+    {
+        for (l=crd->cells->head[nb[k]]; l!=-1; l=crd->cells->next[l])
+        {
+            j = (uint32_t) l;
+            if (j==i || j<jmin)
+                continue;
+            energy += LJ_cut_pair(dat,ti,crd->type[j],X2(xi-crd->x[j])+X2(yi-crd->y[j])+X2(zi-crd->z[j]),NULL);
+        }
+    }
+
+    return energy;
+}
+
+/*
+ * Gradient contributions of the pairs (i,j>i) with a cutoff, added to atom i and subtracted from atom j ;
+ * returns the energy of those pairs
+ */
+static double LJ_cut_grad_row(const COORDS *crd, const DATA *dat, uint32_t i, double fx[], double fy[], double fz[])
+{
+    uint32_t j, k, n;
+    int32_t l;
+    uint32_t nb[27];
+    double dx, dy, dz, de;
+    double energy = 0.0;
+    const uint32_t ti = crd->type[i];
+
+    if (crd->nlist != NULL && crd->nlist->nfar == 0)
+    {
+        const NLIST *nl = crd->nlist;
+
+        for (k=nl->start[i]; k<nl->half[i]; k++)
+        {
+            j = nl->nb[k];
+            dx = crd->x[i]-crd->x[j];
+            dy = crd->y[i]-crd->y[j];
+            dz = crd->z[i]-crd->z[j];
+            energy += LJ_cut_pair(dat,ti,crd->type[j],dx*dx+dy*dy+dz*dz,&de);
+            fx[i] += de*dx; fy[i] += de*dy; fz[i] += de*dz;
+            fx[j] -= de*dx; fy[j] -= de*dy; fz[j] -= de*dz;
+        }
+        return energy;
+    }
+
+    if (crd->cells == NULL)
+    {
+        for (j=i+1; j<crd->natom; j++)
+        {
+            dx = crd->x[i]-crd->x[j];
+            dy = crd->y[i]-crd->y[j];
+            dz = crd->z[i]-crd->z[j];
+            energy += LJ_cut_pair(dat,ti,crd->type[j],dx*dx+dy*dy+dz*dz,&de);
+            fx[i] += de*dx; fy[i] += de*dy; fz[i] += de*dz;
+            fx[j] -= de*dx; fy[j] -= de*dy; fz[j] -= de*dz;
+        }
+        return energy;
+    }
+
+    n = get_neighbour_cells(crd->cells,crd->x[i],crd->y[i],crd->z[i],nb);
+    for (k=0; k<n; k++)
+    {
+        for (l=crd->cells->head[nb[k]]; l!=-1; l=crd->cells->next[l])
+        {
+            j = (uint32_t) l;
+            if (j<=i)
+                continue;
+            dx = crd->x[i]-crd->x[j];
+            dy = crd->y[i]-crd->y[j];
+            dz = crd->z[i]-crd->z[j];
+            energy += LJ_cut_pair(dat,ti,crd->type[j],dx*dx+dy*dy+dz*dz,&de);
+            fx[i] += de*dx; fy[i] += de*dy; fz[i] += de*dz;
+            fx[j] -= de*dx; fy[j] -= de*dy; fz[j] -= de*dz;
+        }
+    }
+
+    return energy;
+}
+
+/**
+ * @brief Same as get_LJ_V but with the cutoff defined by the CUTOFF keyword ; with a cell grid (see cells.c)
+ *          the energy of a candidate costs O(1) instead of O(N), and the energy of the system O(N) instead of O(N^2).
+ *          Verlet lists (see nlist.c) reduce further the number of pairs visited.
+ */
+ENERGY get_LJ_V_cut(const COORDS *crd, const DATA *dat, int32_t candidate)
+{
+    ENERGY e = {0.0, get_LJ_CONSTR(crd,dat,candidate)};
+
+    if (candidate==-1)
+    {
+        for (uint32_t i=0; i<crd->natom; i++)
+            e.pair += LJ_cut_row(crd,dat,i,i+1);
+    }
+    else
+        e.pair = LJ_cut_row(crd,dat,(uint32_t)candidate,0);
+
+    return e;
+}
+
+/**
+ * @brief Gradient of get_LJ_V_cut
+ */
+void get_LJ_DV_cut(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[])
+{
+    const uint32_t natom = crd->natom;
+
+    memset(fx,0,natom*sizeof(double));
+    memset(fy,0,natom*sizeof(double));
+    memset(fz,0,natom*sizeof(double));
+
+    for (uint32_t i=0; i<natom; i++)
+        LJ_cut_grad_row(crd,dat,i,fx,fy,fz);
+}
+
+/**
+ * @brief Same as get_LJ_V_DV with the cutoff defined by the CUTOFF keyword
+ */
+ENERGY get_LJ_V_DV_cut(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[])
+{
+    const uint32_t natom = crd->natom;
+    ENERGY e = {0.0, get_LJ_CONSTR(crd,dat,-1)};
+
+    memset(fx,0,natom*sizeof(double));
+    memset(fy,0,natom*sizeof(double));
+    memset(fz,0,natom*sizeof(double));
+
+    for (uint32_t i=0; i<natom; i++)
+        e.pair += LJ_cut_grad_row(crd,dat,i,fx,fy,fz);
+
+    return e;
+}
+
+/*
+ * Constants of the HFD-B potentials, indexed by the AZIZ_SPECIES of both atoms :
+ *  Ne-Ne from Aziz, Chem. Phys. 130 (1989) p 187
+ *  Ar-Ne from Barrow, Aziz, JCP 89, 6189 (1988)
+ *  Ar-Ar from Aziz, JCP 92, 1030 (1990)
+ * the well depths are converted from K to cm-1 ; c_12 is 0 for the forms without that term
+ */
+static const AZIZ_PARAMS aziz_params[2][2] =
+{
+    {
+        {8.9571795e+5,13.86434671,-0.12993822, 1.21317545,0.53222749,0.24570703,0.,         1.36,42.25*0.695039,3.091},
+        {1.651205e+5, 9.69290567, -2.27380851, 1.09781826,0.34284623,0.30103922,0.74483225, 1.44,67.59*0.695039,3.4889}
+    },
+    {
+        {1.651205e+5, 9.69290567, -2.27380851, 1.09781826,0.34284623,0.30103922,0.74483225, 1.44,67.59*0.695039,3.4889},
+        {1.14211845e+5,9.00053441,-2.60270226, 1.09971113,0.54511632,0.39278653,0.,         1.04,143.25*0.695039,3.761}
+    }
+};
+
+/**
+ * @brief Resolves the atomic symbol of each species to an AZIZ_SPECIES (anything which is not neon is argon),
+ *          and builds the table of the HFD-B constants of each pair of species used by the energy loops
+ */
+void build_AZIZ_table(DATA *dat)
+{
+    uint32_t ti,tj;
+    uint32_t nt = dat->ntypes;
+
+    dat->aziz_sp = malloc(nt*sizeof *dat->aziz_sp);
+    dat->aziz = malloc(nt*nt*sizeof *dat->aziz);
+
+    for (ti=0; ti<nt; ti++)
+    {
+        if (!strcasecmp(dat->ljp[ti].sym,"Ne"))
+            dat->aziz_sp[ti] = AZ_NE;
+        else
+        {
+            if (strcasecmp(dat->ljp[ti].sym,"Ar"))
+                LOG_PRINT(LOG_WARNING,"Atom type %s is unknown to the Aziz potential : using the argon parameters.\n",dat->ljp[ti].sym);
+            dat->aziz_sp[ti] = AZ_AR;
+        }
+    }
+
+    for (ti=0; ti<nt; ti++)
+        for (tj=0; tj<nt; tj++)
+            dat->aziz[ti*nt+tj] = &aziz_params[dat->aziz_sp[ti]][dat->aziz_sp[tj]];
+}
+
+void free_AZIZ_table(DATA *dat)
+{
+    free(dat->aziz_sp);
+    free(dat->aziz);
+    dat->aziz_sp = NULL;
+    dat->aziz = NULL;
+}
+
+/*
+ * Energy (in cm-1) of the HFD-B form with the constants p, r in angstroems.
+ * The damping function is 1 beyond x = d, which is obtained without a branch by clamping d/x-1 at 0.
+ */
+static inline double aziz_hfdb(const AZIZ_PARAMS *restrict p, double r)
+{
+    const double x = r/p->r_m;
+    const double xi2 = 1./(x*x);
+    const double g = fmax(p->d/x-1.,0.);
+    const double f = exp(-g*g);
+    const double disp = xi2*xi2*xi2*(p->c_6+xi2*(p->c_8+xi2*(p->c_10+xi2*p->c_12)));
+
+    return p->epsi*(p->a_s*exp(-p->alpha_s*x+p->beta_s*x*x) - f*disp);
+}
+
+/*
+ * Same as aziz_hfdb, with the derivative dV/dr stored in dv
+ */
+static inline double aziz_hfdb_dv(const AZIZ_PARAMS *restrict p, double r, double *dv)
+{
+    const double x = r/p->r_m;
+    const double xi = 1./x;
+    const double xi2 = xi*xi;
+    const double g = fmax(p->d*xi-1.,0.);
+    const double f = exp(-g*g);
+    const double df = 2.*f*g*p->d*xi2;
+
+    // sum of c_n/x^n and its derivative, written with powers of 1/x^2
+    const double disp = xi2*xi2*xi2*(p->c_6+xi2*(p->c_8+xi2*(p->c_10+xi2*p->c_12)));
+    const double ddisp = -xi*xi2*xi2*xi2*(6.*p->c_6+xi2*(8.*p->c_8+xi2*(10.*p->c_10+xi2*12.*p->c_12)));
+
+    const double rep = p->a_s*exp(-p->alpha_s*x+p->beta_s*x*x);
+
+    *dv = p->epsi*(rep*(-p->alpha_s+2.*p->beta_s*x)-df*disp-f*ddisp)/p->r_m;
+
+    return p->epsi*(rep-f*disp);
+}
+
+double aziz_pair(AZIZ_SPECIES a, AZIZ_SPECIES b, double r)
+{
+    return aziz_hfdb(&aziz_params[a][b],r);
+}
+
+double aziz_pair_dv(AZIZ_SPECIES a, AZIZ_SPECIES b, double r, double *dv)
+{
+    return aziz_hfdb_dv(&aziz_params[a][b],r,dv);
+}
+
+double aziz_ne_ne(double r)
+{
+    return aziz_hfdb(&aziz_params[AZ_NE][AZ_NE],r);
+}
+
+double aziz_ar_ne(double r)
+{
+    return aziz_hfdb(&aziz_params[AZ_AR][AZ_NE],r);
+}
+
+double aziz_ar_ar(double r)
+{
+    return aziz_hfdb(&aziz_params[AZ_AR][AZ_AR],r);
+}
+
+double aziz_ne_ne_dv(double r, double *dv)
+{
+    return aziz_hfdb_dv(&aziz_params[AZ_NE][AZ_NE],r,dv);
+}
+
+double aziz_ar_ne_dv(double r, double *dv)
+{
+    return aziz_hfdb_dv(&aziz_params[AZ_AR][AZ_NE],r,dv);
+}
+
+double aziz_ar_ar_dv(double r, double *dv)
+{
+    return aziz_hfdb_dv(&aziz_params[AZ_AR][AZ_AR],r,dv);
+}
+
+/**
+ * @brief Aziz energy of the pair (i,j) : the HFD-B constants of the pair of species come from dat->aziz
+ */
+static inline double AZIZ_pair(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t j)
+{
+    double d = sqrt( X2(crd->x[i]-crd->x[j]) +  X2(crd->y[i]-crd->y[j]) + X2(crd->z[i]-crd->z[j]) );
+
+    return aziz_hfdb(dat->aziz[crd->type[i]*dat->ntypes+crd->type[j]],d);
+}
+
+/*
+ * Aziz energy of atom i with the atoms [from,to[ as a PAIR_RANGE, in the units of get_AZIZ_V
+ */
+static double AZIZ_V_range(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t from, uint32_t to, double out[])
+{
+    uint32_t j;
+    double e, energy=0.0;
+    const double conv = CM1TOKJM*JTOCAL;
+
+    for (j=from; j<to; j++)
+    {
+        e = AZIZ_pair(crd,dat,i,j)*conv;
+        if (out != NULL)
+            out[j] = e;
+        energy += e;
+    }
+
+    return energy;
+}
+
+ENERGY get_AZIZ_V(const COORDS *crd, const DATA *dat, int32_t candidate)
+{
+
+    uint32_t i,j;
+    double energy=0.0;
+    const uint32_t natom = crd->natom;
+    ENERGY e = {0.0, 0.0};
+
+    if (dat->det_sum)
+    {
+        e.pair = (candidate==-1) ? get_V_full_det(crd,dat,AZIZ_V_range) : get_V_cand_det(crd,dat,(uint32_t)candidate,NULL,AZIZ_V_range);
+        return e;
+    }
+
+#ifdef _OPENMP
+    if (candidate==-1 && OMP_FULL(crd))
+    {
+        e.pair = get_V_full_omp(crd,dat,AZIZ_V_range);
+        return e;
+    }
+    else if (candidate!=-1 && OMP_CAND)
+    {
+        e.pair = get_V_cand_omp(crd,dat,(uint32_t)candidate,NULL,AZIZ_V_range);
+        return e;
+    }
+#endif
+
+    if (candidate==-1)
+    {
+        for (i=0; i<(natom-1); i++)
+        {
+            for (j=i+1; j<natom; j++)
+                energy += AZIZ_pair(crd,dat,i,j);
+        }
+    }
+    else
+    {
+        i = (uint32_t) candidate;
+        for (j=0; j<natom; j++)
+        {
+            if (j!=i)
+                energy += AZIZ_pair(crd,dat,i,j);
+        }
+    }
+
+    e.pair = energy*CM1TOKJM*JTOCAL;
+
+    return e;
+}
+
+/**
+ * @brief Same as get_AZIZ_V(crd,dat,candidate) but each pair energy of the candidate is also stored
+ *          in row[j] (row[candidate] is set to 0). Used for the per atom energy cache.
+ */
+double get_AZIZ_V_row(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[])
+{
+    uint32_t j;
+    double energy=0.0;
+
+    if (dat->det_sum)
+        return get_V_cand_det(crd,dat,candidate,row,AZIZ_V_range);
+
+#ifdef _OPENMP
+    if (OMP_CAND)
+        return get_V_cand_omp(crd,dat,candidate,row,AZIZ_V_range);
+#endif
+
+    row[candidate] = 0.0;
+    for (j=0; j<crd->natom; j++)
+    {
+        if (j!=candidate)
+        {
+            row[j] = AZIZ_pair(crd,dat,candidate,j)*CM1TOKJM*JTOCAL;
+            energy += row[j];
+        }
+    }
+
+    return energy;
+}
+
+/*
+ * Same as AZIZ_pair, also storing (dV/dr)/r in de so that the gradient on atom i is de*(xi-xj)
+ */
+static inline double AZIZ_pair_dv(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t j, double *de)
+{
+    double e, dv;
+    double d = sqrt( X2(crd->x[i]-crd->x[j]) +  X2(crd->y[i]-crd->y[j]) + X2(crd->z[i]-crd->z[j]) );
+
+    e = aziz_hfdb_dv(dat->aziz[crd->type[i]*dat->ntypes+crd->type[j]],d,&dv);
+
+    *de = dv/d;
+
+    return e;
+}
+
+/*
+ * Half loop Aziz gradient : each pair is visited once and its force applied to both atoms.
+ * Returns the pair energy in cm-1.
+ */
+static double AZIZ_DV_half(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[])
+{
+    uint32_t i,j;
+    double e, de, dx, dy, dz;
+    double energy=0.0;
+    const uint32_t natom = crd->natom;
+    const double conv = CM1TOKJM*JTOCAL;
+
+    memset(fx,0,natom*sizeof(double));
+    memset(fy,0,natom*sizeof(double));
+    memset(fz,0,natom*sizeof(double));
+
+    for (i=0; i<natom; i++)
+    {
+        for (j=i+1; j<natom; j++)
+        {
+            e = AZIZ_pair_dv(crd,dat,i,j,&de);
+            energy += e;
+
+            de *= conv;
+            dx = crd->x[i]-crd->x[j];
+            dy = crd->y[i]-crd->y[j];
+            dz = crd->z[i]-crd->z[j];
+            fx[i] += de*dx; fy[i] += de*dy; fz[i] += de*dz;
+            fx[j] -= de*dx; fy[j] -= de*dy; fz[j] -= de*dz;
+        }
+    }
+
+    return energy;
+}
+
+#ifdef _OPENMP
+/*
+ * Full loop Aziz gradient : each atom sums the forces of all the others on itself only, so that
+ * the rows are independent and can be distributed over threads without any force buffer, at the
+ * price of evaluating each pair twice. Returns the pair energy in cm-1.
+ */
+static double AZIZ_DV_full(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[])
+{
+    double energy=0.0;
+    const int64_t natom = (int64_t) crd->natom;
+    const double conv = CM1TOKJM*JTOCAL;
+    int64_t i;
+
+    #pragma omp parallel for schedule(static) reduction(+:energy)
+    for (i=0; i<natom; i++)
+    {
+        double de, dx, dy, dz;
+        double gx=0.0, gy=0.0, gz=0.0;
+
+        for (uint32_t j=0; j<(uint32_t)natom; j++)
+        {
+            if (j==(uint32_t)i)
+                continue;
+
+            energy += 0.5*AZIZ_pair_dv(crd,dat,(uint32_t)i,j,&de);
+
+            de *= conv;
+            dx = crd->x[i]-crd->x[j];
+            dy = crd->y[i]-crd->y[j];
+            dz = crd->z[i]-crd->z[j];
+            gx += de*dx; gy += de*dy; gz += de*dz;
+        }
+
+        fx[i] = gx;
+        fy[i] = gy;
+        fz[i] = gz;
+    }
+
+    return energy;
+}
+#endif
+
+/**
+ * @brief Gradient of the Aziz energy. The half loop is used, except when compiled with OpenMP for
+ *          systems of at least LJ_DV_OMP_MIN atoms where the rows of the full loop are distributed over the threads.
+ */
+void get_AZIZ_DV(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[])
+{
+#ifdef _OPENMP
+    if (!dat->det_sum && OMP_FULL(crd))
+    {
+        AZIZ_DV_full(crd,dat,fx,fy,fz);
+        return;
+    }
+#endif
+
+    AZIZ_DV_half(crd,dat,fx,fy,fz);
+}
+
+/**
+ * @brief Total Aziz energy (as get_AZIZ_V(crd,dat,-1)) and its gradient evaluated in the same sweep over the pairs
+ */
+ENERGY get_AZIZ_V_DV(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[])
+{
+    ENERGY e = {0.0, 0.0};
+
+#ifdef _OPENMP
+    if (!dat->det_sum && OMP_FULL(crd))
+        e.pair = AZIZ_DV_full(crd,dat,fx,fy,fz)*CM1TOKJM*JTOCAL;
+    else
+#endif
+    e.pair = AZIZ_DV_half(crd,dat,fx,fy,fz)*CM1TOKJM*JTOCAL;
+
+    return e;
+}
+
+/**
+ * @brief Allocates and builds a per atom energy cache (see ECACHE in ener.h) for the configuration crd.
+ *          The full matrix of pair energies is also stored if there are not more than ECACHE_MATRIX_MAX atoms.
+ *          Requires get_ENER_ROW to be set.
+ *
+ * @param cache The cache
+ * @param crd Coordinates of the committed configuration
+ * @param dat Common data
+ */
+void alloc_ecache(ECACHE *cache, const COORDS *crd, const DATA *dat)
+{
+    cache->natom = crd->natom;
+    cache->eat = calloc(crd->natom,sizeof *cache->eat);
+    cache->row = calloc(crd->natom,sizeof *cache->row);
+    cache->oldrow = calloc(crd->natom,sizeof *cache->oldrow);
+    cache->pairs = NULL;
+
+    if (crd->natom <= ECACHE_MATRIX_MAX)
+        cache->pairs = calloc(crd->natom*crd->natom,sizeof *cache->pairs);
+
+    build_ecache(cache,crd,dat);
+}
+
+void free_ecache(ECACHE *cache)
+{
+    free(cache->eat);
+    free(cache->row);
+    free(cache->oldrow);
+    free(cache->pairs);
+    cache->eat = cache->row = cache->oldrow = cache->pairs = NULL;
+}
+
+/**
+ * @brief (Re)computes from scratch the per atom energies of the configuration crd ; this costs a full O(N^2)
+ *          evaluation so it is only done at startup and when saving energy, for removing accumulated rounding errors.
+ */
+void build_ecache(ECACHE *cache, const COORDS *crd, const DATA *dat)
+{
+    uint32_t i;
+
+    for (i=0; i<crd->natom; i++)
+    {
+        double *row = (cache->pairs != NULL) ? cache->pairs + i*crd->natom : cache->row;
+        cache->eat[i] = (*get_ENER_ROW)(crd,dat,i,row);
+    }
+}
+
+/**
+ * @brief Updates the cache when the move of candidate is accepted : row has to contain the pair energies
+ *          of the candidate in its new position (usually cache->row, as filled by get_ENER_ROW(crd_new,dat,candidate,cache->row)),
+ *          and crd still the coordinates before the move. When several atoms move, the cache is updated for
+ *          one atom at a time, each being placed in crd before updating for the next one. This is O(N).
+ *
+ * @param cache The cache
+ * @param crd Coordinates of the configuration before the move
+ * @param dat Common data
+ * @param candidate The atom whose move was accepted
+ * @param row Pair energies of the candidate in its new position
+ * @param Enew Interaction energy of the candidate in its new position
+ */
+void update_ecache(ECACHE *cache, const COORDS *crd, const DATA *dat, uint32_t candidate, const double row[], double Enew)
+{
+    uint32_t j;
+    const uint32_t n = cache->natom;
+    double * restrict eat = cache->eat;
+    const double * restrict old = NULL;
+
+    // without the matrix, the old pair energies of the candidate are evaluated again, only for accepted moves
+    if (cache->pairs == NULL)
+    {
+        (*get_ENER_ROW)(crd,dat,candidate,cache->oldrow);
+        old = cache->oldrow;
+    }
+    else
+        old = cache->pairs + candidate*n;
+
+    for (j=0; j<n; j++)
+        eat[j] += row[j] - old[j];
+
+    if (cache->pairs != NULL)
+    {
+        double * restrict pairs = cache->pairs;
+        for (j=0; j<n; j++)
+        {
+            pairs[candidate*n+j] = row[j];
+            pairs[j*n+candidate] = row[j];
+        }
+    }
+
+    eat[candidate] = Enew;
+}
+
+/**
+ * @brief Allocates and builds the nearest neighbours lists of the early rejection (see early_reject) for the
+ *          L-J potential without cutoff
+ *
+ * @param er The early rejection data
+ * @param crd Coordinates of the committed configuration
+ * @param dat Common data, with dat->early_rej neighbours per atom
+ */
+void alloc_early(EARLY_REJ *er, const COORDS *crd, const DATA *dat)
+{
+    uint32_t i, ti, tj;
+    const uint32_t nt = dat->ntypes;
+    uint32_t *count = calloc(nt,sizeof *count);
+
+    er->natom = crd->natom;
+    er->k = (dat->early_rej < crd->natom) ? dat->early_rej : crd->natom-1;
+    er->near = malloc(crd->natom*er->k*sizeof *er->near);
+    er->depth = malloc(nt*nt*sizeof *er->depth);
+    er->wsum = malloc(nt*sizeof *er->wsum);
+    er->nrej = 0;
+
+    // with c12 = 4*eps*sig^12 and c6 = 4*eps*sig^6 the minimum of the pair energy is -eps = -c6^2/(4*c12) ;
+    //  c12 is only 0 for pairs without interaction (EPSILON 0)
+    for (ti=0; ti<nt*nt; ti++)
+        er->depth[ti] = (dat->lj_c12[ti] != 0.0) ? X2(dat->lj_c6[ti])/(4.0*dat->lj_c12[ti]) : 0.0;
+
+    for (i=0; i<crd->natom; i++)
+        count[crd->type[i]]++;
+
+    for (ti=0; ti<nt; ti++)
+    {
+        // an atom does not interact with itself
+        er->wsum[ti] = er->depth[ti*nt+ti];
+        for (tj=0; tj<nt; tj++)
+            er->wsum[ti] -= count[tj]*er->depth[ti*nt+tj];
+    }
+
+    free(count);
+
+    build_early(er,crd);
+}
+
+void free_early(EARLY_REJ *er)
+{
+    free(er->near);
+    free(er->depth);
+    free(er->wsum);
+    er->near = NULL;
+    er->depth = NULL;
+    er->wsum = NULL;
+}
+
+/**
+ * @brief Finds the k nearest neighbours of atom i at its current position, nearest first.
+ */
+static void early_near(EARLY_REJ *er, const COORDS *crd, uint32_t i)
+{
+    uint32_t j, l, n = 0;
+    const uint32_t k = er->k;
+    uint32_t *restrict near = er->near + i*k;
+    const double *restrict x = crd->x;
+    const double *restrict y = crd->y;
+    const double *restrict z = crd->z;
+    double d2, dk[k];
+
+    for (j=0; j<crd->natom; j++)
+    {
+        if (j==i)
+            continue;
+
+        d2 = X2(x[j]-x[i]) + X2(y[j]-y[i]) + X2(z[j]-z[i]);
+
+        // most atoms are further than the k-th nearest one found so far
+        if (n==k && d2>=dk[k-1])
+            continue;
+
+        // insertion in the sorted list
+        l = (n<k) ? n++ : k-1;
+        while (l>0 && dk[l-1]>d2)
+        {
+            dk[l] = dk[l-1];
+            near[l] = near[l-1];
+            l--;
+        }
+        dk[l] = d2;
+        near[l] = j;
+    }
+}
+
+/**
+ * @brief (Re)builds the nearest neighbours lists of all the atoms, costs O(N^2). Between two updates the lists
+ *          only give the last known ordering of the neighbours, which does not affect the correctness of early_reject.
+ */
+void build_early(EARLY_REJ *er, const COORDS *crd)
+{
+    for (uint32_t i=0; i<crd->natom; i++)
+        early_near(er,crd,i);
+}
+
+/**
+ * @brief Early rejection of a trial move of the L-J potential : the energies of the candidate with its nearest
+ *          neighbours are summed one by one, and any other pair contributes at least minus its well depth. As soon as
+ *          this lower bound of the pair energy of the candidate reaches limit, the move is known to be rejected
+ *          without evaluating the other pairs.
+ *
+ * @param er The early rejection data
+ * @param crd Coordinates of the trial configuration
+ * @param dat Common data
+ * @param candidate The moving atom
+ * @param limit The pair energy of the candidate above which the move is rejected
+ * @return 1 if the pair energy of the candidate is at least limit, 0 if it is unknown
+ */
+uint32_t early_reject(const EARLY_REJ *er, const COORDS *crd, const DATA *dat, uint32_t candidate, double limit)
+{
+    uint32_t l, j;
+    double r6i;
+    const uint32_t ti = crd->type[candidate];
+    const uint32_t *near = er->near + candidate*er->k;
+    const double *c12 = dat->lj_c12 + ti*dat->ntypes;
+    const double *c6  = dat->lj_c6  + ti*dat->ntypes;
+    const double *depth = er->depth + ti*dat->ntypes;
+    const double xi = crd->x[candidate], yi = crd->y[candidate], zi = crd->z[candidate];
+
+    // lower bound of the pair energy of the candidate
+    double bound = er->wsum[ti];
+
+    for (l=0; l<er->k; l++)
+    {
+        j = near[l];
+        r6i = 1.0/(X3(X2(crd->x[j]-xi) + X2(crd->y[j]-yi) + X2(crd->z[j]-zi)));
+        bound += r6i*( c12[crd->type[j]]*r6i - c6[crd->type[j]] ) + depth[crd->type[j]];
+
+        if (bound >= limit)
+            return 1;
+    }
+
+    return 0;
+}
+
+double getExtraPot(double d2, double sig, double eps)
+{
+    double vc = d2/(X2(K_CONSTRAINT*sig));
+    // vc^10 by products : pow() cost about as much as the pair energy of a candidate in a small cluster
+    double vc2 = X2(vc);
+    vc = X4(vc2)*vc2;
+    vc*=eps;
+
+    return vc;
+
+//     return 0.0;
+
+}
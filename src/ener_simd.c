@@ -0,0 +1,560 @@
+/**
+ * \file ener_simd.c
+ *
+ * \brief Hand vectorised (AVX2 and AVX-512) versions of the Lennard-Jones energy and gradient kernels.
+ *          The variant used is selected at startup by init_LJ_kernels (see ener.c) depending of the cpu.
+ *
+ * \authors Florent Hedin (University of Basel, Switzerland) \n
+ *          Markus Meuwly (University of Basel, Switzerland)
+ *
+ * \copyright Copyright (c) 2011-2015, Florent Hedin, Markus Meuwly, and the University of Basel. \n
+ *            All rights reserved. \n
+ *            The 3-clause BSD license is applied to this software. \n
+ *            See LICENSE.txt
+ *
+ */
+
+#include <stdlib.h>
+
+#include "global.h"
+#include "ener_simd.h"
+
+#ifdef SIMD_KERNELS
+
+#include <immintrin.h>
+
+#define TARGET_AVX2     __attribute__((target("avx2,fma")))
+#define TARGET_AVX512   __attribute__((target("avx2,fma,avx512f")))
+
+// the row kernels take a compile time constant mix flag, and have to be inlined in each instantiation
+#define KERNEL_INLINE   static inline __attribute__((always_inline))
+
+// -----------------------------------------------------------------------------------------
+// AVX2
+// -----------------------------------------------------------------------------------------
+
+TARGET_AVX2
+static inline double hsum_avx2(__m256d v)
+{
+    __m128d lo = _mm256_castpd256_pd128(v);
+    __m128d hi = _mm256_extractf128_pd(v,1);
+    lo = _mm_add_pd(lo,hi);
+    hi = _mm_unpackhi_pd(lo,lo);
+    return _mm_cvtsd_f64(_mm_add_sd(lo,hi));
+}
+
+/*
+ * Sum of the L-J interactions between atom i and atoms [from,to[ ; 4 atoms j per iteration,
+ * the coefficients of the species pairs are gathered from the table row of atom i (mix=1),
+ * or are the constants of the species of atom i for systems of a single species (mix=0).
+ * If out is not NULL each pair energy is also stored in out[j].
+ */
+TARGET_AVX2
+KERNEL_INLINE double LJ_row_avx2(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t from, uint32_t to, double out[], const int mix)
+{
+    const double *c12 = dat->lj_c12 + crd->type[i]*dat->ntypes;
+    const double *c6  = dat->lj_c6  + crd->type[i]*dat->ntypes;
+    const double c12i = c12[crd->type[i]], c6i = c6[crd->type[i]];
+    const __m256d a0 = _mm256_set1_pd(c12i);
+    const __m256d b0 = _mm256_set1_pd(c6i);
+
+    const __m256d x1 = _mm256_set1_pd(crd->x[i]);
+    const __m256d y1 = _mm256_set1_pd(crd->y[i]);
+    const __m256d z1 = _mm256_set1_pd(crd->z[i]);
+    const __m256d one = _mm256_set1_pd(1.0);
+
+    __m256d acc = _mm256_setzero_pd();
+    double energy, d2, r6i, e_j;
+    uint32_t j = from;
+
+    for ( ; j+4<=to; j+=4)
+    {
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(crd->x+j),x1);
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(crd->y+j),y1);
+        __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(crd->z+j),z1);
+
+        __m256d r2 = _mm256_fmadd_pd(dz,dz,_mm256_fmadd_pd(dy,dy,_mm256_mul_pd(dx,dx)));
+        __m256d r2i = _mm256_div_pd(one,r2);
+        __m256d r6 = _mm256_mul_pd(_mm256_mul_pd(r2i,r2i),r2i);
+
+        __m256d a = a0, b = b0;
+        if (mix)
+        {
+            __m128i tj = _mm_loadu_si128((const __m128i*)(crd->type+j));
+            a = _mm256_i32gather_pd(c12,tj,8);
+            b = _mm256_i32gather_pd(c6,tj,8);
+        }
+
+        // r6*(c12*r6 - c6)
+        __m256d e = _mm256_mul_pd(r6,_mm256_fmsub_pd(a,r6,b));
+        acc = _mm256_add_pd(acc,e);
+
+        if (out != NULL)
+            _mm256_storeu_pd(out+j,e);
+    }
+
+    energy = hsum_avx2(acc);
+
+    for ( ; j<to; j++)
+    {
+        d2 = X2(crd->x[j]-crd->x[i]) + X2(crd->y[j]-crd->y[i]) + X2(crd->z[j]-crd->z[i]);
+        r6i = 1.0/(X3(d2));
+        e_j = mix ? r6i*( c12[crd->type[j]]*r6i - c6[crd->type[j]] ) : r6i*( c12i*r6i - c6i );
+        energy += e_j;
+
+        if (out != NULL)
+            out[j] = e_j;
+    }
+
+    return energy;
+}
+
+/*
+ * Gradient contributions of the pairs (i,j) with j>i : each pair is visited once,
+ * the force is added to atom i and subtracted from the 4 atoms j of each iteration.
+ * Returns the energy of those pairs. mix has the same meaning as for LJ_row_avx2.
+ */
+TARGET_AVX2
+KERNEL_INLINE double LJ_grad_row_avx2(const COORDS *crd, const DATA *dat, uint32_t i, double fx[], double fy[], double fz[], const int mix)
+{
+    const double *c12 = dat->lj_c12 + crd->type[i]*dat->ntypes;
+    const double *c6  = dat->lj_c6  + crd->type[i]*dat->ntypes;
+    const double c12i = c12[crd->type[i]], c6i = c6[crd->type[i]];
+    const __m256d a0 = _mm256_set1_pd(c12i);
+    const __m256d b0 = _mm256_set1_pd(c6i);
+    const uint32_t to = crd->natom;
+
+    const __m256d x1 = _mm256_set1_pd(crd->x[i]);
+    const __m256d y1 = _mm256_set1_pd(crd->y[i]);
+    const __m256d z1 = _mm256_set1_pd(crd->z[i]);
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d two = _mm256_set1_pd(2.0);
+    const __m256d m6 = _mm256_set1_pd(-6.0);
+
+    __m256d ax = _mm256_setzero_pd();
+    __m256d ay = _mm256_setzero_pd();
+    __m256d az = _mm256_setzero_pd();
+    __m256d ae = _mm256_setzero_pd();
+    double dx, dy, dz, r2i, r6i, de, a, b, energy;
+    uint32_t j = i+1;
+
+    for ( ; j+4<=to; j+=4)
+    {
+        __m256d vx = _mm256_sub_pd(x1,_mm256_loadu_pd(crd->x+j));
+        __m256d vy = _mm256_sub_pd(y1,_mm256_loadu_pd(crd->y+j));
+        __m256d vz = _mm256_sub_pd(z1,_mm256_loadu_pd(crd->z+j));
+
+        __m256d r2 = _mm256_fmadd_pd(vz,vz,_mm256_fmadd_pd(vy,vy,_mm256_mul_pd(vx,vx)));
+        __m256d ri = _mm256_div_pd(one,r2);
+        __m256d r6 = _mm256_mul_pd(_mm256_mul_pd(ri,ri),ri);
+
+        __m256d a = a0, b = b0;
+        if (mix)
+        {
+            __m128i tj = _mm_loadu_si128((const __m128i*)(crd->type+j));
+            a = _mm256_i32gather_pd(c12,tj,8);
+            b = _mm256_i32gather_pd(c6,tj,8);
+        }
+
+        ae = _mm256_fmadd_pd(r6,_mm256_fmsub_pd(a,r6,b),ae);
+
+        // -6*r6*(2*c12*r6 - c6)/r2
+        __m256d f = _mm256_fmsub_pd(_mm256_mul_pd(two,a),r6,b);
+        f = _mm256_mul_pd(_mm256_mul_pd(m6,r6),_mm256_mul_pd(f,ri));
+
+        vx = _mm256_mul_pd(f,vx);
+        vy = _mm256_mul_pd(f,vy);
+        vz = _mm256_mul_pd(f,vz);
+
+        ax = _mm256_add_pd(ax,vx);
+        ay = _mm256_add_pd(ay,vy);
+        az = _mm256_add_pd(az,vz);
+
+        _mm256_storeu_pd(fx+j,_mm256_sub_pd(_mm256_loadu_pd(fx+j),vx));
+        _mm256_storeu_pd(fy+j,_mm256_sub_pd(_mm256_loadu_pd(fy+j),vy));
+        _mm256_storeu_pd(fz+j,_mm256_sub_pd(_mm256_loadu_pd(fz+j),vz));
+    }
+
+    fx[i] += hsum_avx2(ax);
+    fy[i] += hsum_avx2(ay);
+    fz[i] += hsum_avx2(az);
+    energy = hsum_avx2(ae);
+
+    for ( ; j<to; j++)
+    {
+        dx = crd->x[i] - crd->x[j];
+        dy = crd->y[i] - crd->y[j];
+        dz = crd->z[i] - crd->z[j];
+        r2i = 1.0/(dx*dx + dy*dy + dz*dz);
+        r6i = X3(r2i);
+        a = mix ? c12[crd->type[j]] : c12i;
+        b = mix ? c6[crd->type[j]] : c6i;
+        energy += r6i*( a*r6i - b );
+        de = -6.0*r6i*( 2.0*a*r6i - b )*r2i ;
+        fx[i] += de*dx;
+        fy[i] += de*dy;
+        fz[i] += de*dz;
+        fx[j] -= de*dx;
+        fy[j] -= de*dy;
+        fz[j] -= de*dz;
+    }
+
+    return energy;
+}
+
+/*
+ * Exported kernels of one instruction set : energy of the whole system, of one candidate, energies of the
+ * pairs of one candidate, and gradient, for mixtures (MIX=1) or for systems of a single species (MIX=0)
+ */
+#define LJ_SIMD_KERNELS(TARGET,isa,name,MIX) \
+TARGET \
+double LJ_V_full_##name(const COORDS *crd, const DATA *dat) \
+{ \
+    double energy = 0.0; \
+    for (uint32_t i=0; i<crd->natom; i++) \
+        energy += LJ_row_##isa(crd,dat,i,i+1,crd->natom,NULL,MIX); \
+    return energy; \
+} \
+\
+TARGET \
+double LJ_V_cand_##name(const COORDS *crd, const DATA *dat, uint32_t candidate) \
+{ \
+    return LJ_row_##isa(crd,dat,candidate,0,candidate,NULL,MIX) \
+           + LJ_row_##isa(crd,dat,candidate,candidate+1,crd->natom,NULL,MIX); \
+} \
+\
+TARGET \
+double LJ_V_row_##name(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[]) \
+{ \
+    row[candidate] = 0.0; \
+    return LJ_row_##isa(crd,dat,candidate,0,candidate,row,MIX) \
+           + LJ_row_##isa(crd,dat,candidate,candidate+1,crd->natom,row,MIX); \
+} \
+\
+TARGET \
+double LJ_DV_row_##name(const COORDS *crd, const DATA *dat, uint32_t i, double fx[], double fy[], double fz[]) \
+{ \
+    return LJ_grad_row_##isa(crd,dat,i,fx,fy,fz,MIX); \
+} \
+\
+TARGET \
+double LJ_V_range_##name(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t from, uint32_t to, double out[]) \
+{ \
+    return LJ_row_##isa(crd,dat,i,from,to,out,MIX); \
+}
+
+LJ_SIMD_KERNELS(TARGET_AVX2,avx2,avx2,1)
+LJ_SIMD_KERNELS(TARGET_AVX2,avx2,avx2_single,0)
+
+// -----------------------------------------------------------------------------------------
+// AVX-512
+// -----------------------------------------------------------------------------------------
+
+/*
+ * Same as LJ_row_avx2 with 8 atoms j per iteration ; the remainder is handled with a masked iteration
+ */
+TARGET_AVX512
+KERNEL_INLINE double LJ_row_avx512(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t from, uint32_t to, double out[], const int mix)
+{
+    const double *c12 = dat->lj_c12 + crd->type[i]*dat->ntypes;
+    const double *c6  = dat->lj_c6  + crd->type[i]*dat->ntypes;
+    const __m512d a0 = _mm512_set1_pd(c12[crd->type[i]]);
+    const __m512d b0 = _mm512_set1_pd(c6[crd->type[i]]);
+
+    const __m512d x1 = _mm512_set1_pd(crd->x[i]);
+    const __m512d y1 = _mm512_set1_pd(crd->y[i]);
+    const __m512d z1 = _mm512_set1_pd(crd->z[i]);
+    const __m512d one = _mm512_set1_pd(1.0);
+
+    __m512d acc = _mm512_setzero_pd();
+    uint32_t j = from;
+
+    // the coordinates store is padded (see coords.c) so a full vector may be read past the last atom
+    for ( ; j<to; j+=8)
+    {
+        // lanes past the end of the row are masked out
+        __mmask8 m = (to-j >= 8) ? 0xFF : (__mmask8)((1u<<(to-j))-1u);
+
+        __m512d dx = _mm512_sub_pd(_mm512_maskz_loadu_pd(m,crd->x+j),x1);
+        __m512d dy = _mm512_sub_pd(_mm512_maskz_loadu_pd(m,crd->y+j),y1);
+        __m512d dz = _mm512_sub_pd(_mm512_maskz_loadu_pd(m,crd->z+j),z1);
+
+        __m512d r2 = _mm512_fmadd_pd(dz,dz,_mm512_fmadd_pd(dy,dy,_mm512_mul_pd(dx,dx)));
+        __m512d r2i = _mm512_div_pd(one,r2);
+        __m512d r6 = _mm512_mul_pd(_mm512_mul_pd(r2i,r2i),r2i);
+
+        __m512d a = a0, b = b0;
+        if (mix)
+        {
+            __m256i tj = _mm256_loadu_si256((const __m256i*)(crd->type+j));
+            a = _mm512_mask_i32gather_pd(_mm512_setzero_pd(),m,tj,c12,8);
+            b = _mm512_mask_i32gather_pd(_mm512_setzero_pd(),m,tj,c6,8);
+        }
+
+        __m512d e = _mm512_mul_pd(r6,_mm512_fmsub_pd(a,r6,b));
+        acc = _mm512_mask_add_pd(acc,m,acc,e);
+
+        if (out != NULL)
+            _mm512_mask_storeu_pd(out+j,m,e);
+    }
+
+    return _mm512_reduce_add_pd(acc);
+}
+
+/*
+ * Same as LJ_grad_row_avx2 with 8 atoms j per iteration ; masked loads and stores handle the end of the row
+ * so that the force arrays do not need to be padded.
+ */
+TARGET_AVX512
+KERNEL_INLINE double LJ_grad_row_avx512(const COORDS *crd, const DATA *dat, uint32_t i, double fx[], double fy[], double fz[], const int mix)
+{
+    const double *c12 = dat->lj_c12 + crd->type[i]*dat->ntypes;
+    const double *c6  = dat->lj_c6  + crd->type[i]*dat->ntypes;
+    const __m512d a0 = _mm512_set1_pd(c12[crd->type[i]]);
+    const __m512d b0 = _mm512_set1_pd(c6[crd->type[i]]);
+    const uint32_t to = crd->natom;
+
+    const __m512d x1 = _mm512_set1_pd(crd->x[i]);
+    const __m512d y1 = _mm512_set1_pd(crd->y[i]);
+    const __m512d z1 = _mm512_set1_pd(crd->z[i]);
+    const __m512d one = _mm512_set1_pd(1.0);
+    const __m512d two = _mm512_set1_pd(2.0);
+    const __m512d m6 = _mm512_set1_pd(-6.0);
+
+    __m512d ax = _mm512_setzero_pd();
+    __m512d ay = _mm512_setzero_pd();
+    __m512d az = _mm512_setzero_pd();
+    __m512d ae = _mm512_setzero_pd();
+    uint32_t j = i+1;
+
+    for ( ; j<to; j+=8)
+    {
+        __mmask8 m = (to-j >= 8) ? 0xFF : (__mmask8)((1u<<(to-j))-1u);
+
+        __m512d vx = _mm512_sub_pd(x1,_mm512_maskz_loadu_pd(m,crd->x+j));
+        __m512d vy = _mm512_sub_pd(y1,_mm512_maskz_loadu_pd(m,crd->y+j));
+        __m512d vz = _mm512_sub_pd(z1,_mm512_maskz_loadu_pd(m,crd->z+j));
+
+        __m512d r2 = _mm512_fmadd_pd(vz,vz,_mm512_fmadd_pd(vy,vy,_mm512_mul_pd(vx,vx)));
+        __m512d ri = _mm512_div_pd(one,r2);
+        __m512d r6 = _mm512_mul_pd(_mm512_mul_pd(ri,ri),ri);
+
+        __m512d a = a0, b = b0;
+        if (mix)
+        {
+            __m256i tj = _mm256_loadu_si256((const __m256i*)(crd->type+j));
+            a = _mm512_mask_i32gather_pd(_mm512_setzero_pd(),m,tj,c12,8);
+            b = _mm512_mask_i32gather_pd(_mm512_setzero_pd(),m,tj,c6,8);
+        }
+
+        ae = _mm512_mask_add_pd(ae,m,ae,_mm512_mul_pd(r6,_mm512_fmsub_pd(a,r6,b)));
+
+        __m512d f = _mm512_fmsub_pd(_mm512_mul_pd(two,a),r6,b);
+        f = _mm512_mul_pd(_mm512_mul_pd(m6,r6),_mm512_mul_pd(f,ri));
+
+        vx = _mm512_mul_pd(f,vx);
+        vy = _mm512_mul_pd(f,vy);
+        vz = _mm512_mul_pd(f,vz);
+
+        ax = _mm512_mask_add_pd(ax,m,ax,vx);
+        ay = _mm512_mask_add_pd(ay,m,ay,vy);
+        az = _mm512_mask_add_pd(az,m,az,vz);
+
+        _mm512_mask_storeu_pd(fx+j,m,_mm512_sub_pd(_mm512_maskz_loadu_pd(m,fx+j),vx));
+        _mm512_mask_storeu_pd(fy+j,m,_mm512_sub_pd(_mm512_maskz_loadu_pd(m,fy+j),vy));
+        _mm512_mask_storeu_pd(fz+j,m,_mm512_sub_pd(_mm512_maskz_loadu_pd(m,fz+j),vz));
+    }
+
+    fx[i] += _mm512_reduce_add_pd(ax);
+    fy[i] += _mm512_reduce_add_pd(ay);
+    fz[i] += _mm512_reduce_add_pd(az);
+
+    return _mm512_reduce_add_pd(ae);
+}
+
+LJ_SIMD_KERNELS(TARGET_AVX512,avx512,avx512,1)
+LJ_SIMD_KERNELS(TARGET_AVX512,avx512,avx512_single,0)
+
+// -----------------------------------------------------------------------------------------
+// Mixed precision (PRECISION MIXED) : the single precision copies of the coordinates are loaded, the
+// distances and r^-6 computed in float with twice more lanes, and the energies accumulated in double
+// -----------------------------------------------------------------------------------------
+
+/*
+ * Same as LJ_row_avx2 with 8 atoms j per iteration in float
+ */
+TARGET_AVX2
+static double LJ_row_mixed_avx2(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t from, uint32_t to, double out[])
+{
+    const float *c12 = dat->lj_c12f + crd->type[i]*dat->ntypes;
+    const float *c6  = dat->lj_c6f  + crd->type[i]*dat->ntypes;
+
+    const __m256 x1 = _mm256_set1_ps(crd->xf[i]);
+    const __m256 y1 = _mm256_set1_ps(crd->yf[i]);
+    const __m256 z1 = _mm256_set1_ps(crd->zf[i]);
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    __m256d acc = _mm256_setzero_pd();
+    double energy;
+    float d2, r6i, e_j;
+    uint32_t j = from;
+
+    for ( ; j+8<=to; j+=8)
+    {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(crd->xf+j),x1);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(crd->yf+j),y1);
+        __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(crd->zf+j),z1);
+
+        __m256 r2 = _mm256_fmadd_ps(dz,dz,_mm256_fmadd_ps(dy,dy,_mm256_mul_ps(dx,dx)));
+        __m256 r2i = _mm256_div_ps(one,r2);
+        __m256 r6 = _mm256_mul_ps(_mm256_mul_ps(r2i,r2i),r2i);
+
+        __m256i tj = _mm256_loadu_si256((const __m256i*)(crd->type+j));
+        __m256 a = _mm256_i32gather_ps(c12,tj,4);
+        __m256 b = _mm256_i32gather_ps(c6,tj,4);
+
+        __m256 e = _mm256_mul_ps(r6,_mm256_fmsub_ps(a,r6,b));
+        __m256d elo = _mm256_cvtps_pd(_mm256_castps256_ps128(e));
+        __m256d ehi = _mm256_cvtps_pd(_mm256_extractf128_ps(e,1));
+        acc = _mm256_add_pd(acc,_mm256_add_pd(elo,ehi));
+
+        if (out != NULL)
+        {
+            _mm256_storeu_pd(out+j,elo);
+            _mm256_storeu_pd(out+j+4,ehi);
+        }
+    }
+
+    energy = hsum_avx2(acc);
+
+    for ( ; j<to; j++)
+    {
+        d2 = X2(crd->xf[j]-crd->xf[i]) + X2(crd->yf[j]-crd->yf[i]) + X2(crd->zf[j]-crd->zf[i]);
+        r6i = 1.0f/(X3(d2));
+        e_j = r6i*( c12[crd->type[j]]*r6i - c6[crd->type[j]] );
+        energy += e_j;
+
+        if (out != NULL)
+            out[j] = e_j;
+    }
+
+    return energy;
+}
+
+TARGET_AVX2
+double LJ_V_full_mixed_avx2(const COORDS *crd, const DATA *dat)
+{
+    double energy = 0.0;
+
+    for (uint32_t i=0; i<crd->natom; i++)
+        energy += LJ_row_mixed_avx2(crd,dat,i,i+1,crd->natom,NULL);
+
+    return energy;
+}
+
+TARGET_AVX2
+double LJ_V_cand_mixed_avx2(const COORDS *crd, const DATA *dat, uint32_t candidate)
+{
+    return LJ_row_mixed_avx2(crd,dat,candidate,0,candidate,NULL)
+           + LJ_row_mixed_avx2(crd,dat,candidate,candidate+1,crd->natom,NULL);
+}
+
+TARGET_AVX2
+double LJ_V_row_mixed_avx2(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[])
+{
+    row[candidate] = 0.0;
+    return LJ_row_mixed_avx2(crd,dat,candidate,0,candidate,row)
+           + LJ_row_mixed_avx2(crd,dat,candidate,candidate+1,crd->natom,row);
+}
+
+TARGET_AVX2
+double LJ_V_range_mixed_avx2(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t from, uint32_t to, double out[])
+{
+    return LJ_row_mixed_avx2(crd,dat,i,from,to,out);
+}
+
+/*
+ * Same as LJ_row_avx512 with 16 atoms j per iteration in float
+ */
+TARGET_AVX512
+static double LJ_row_mixed_avx512(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t from, uint32_t to, double out[])
+{
+    const float *c12 = dat->lj_c12f + crd->type[i]*dat->ntypes;
+    const float *c6  = dat->lj_c6f  + crd->type[i]*dat->ntypes;
+
+    const __m512 x1 = _mm512_set1_ps(crd->xf[i]);
+    const __m512 y1 = _mm512_set1_ps(crd->yf[i]);
+    const __m512 z1 = _mm512_set1_ps(crd->zf[i]);
+    const __m512 one = _mm512_set1_ps(1.0f);
+
+    __m512d acc = _mm512_setzero_pd();
+    uint32_t j = from;
+
+    for ( ; j<to; j+=16)
+    {
+        // lanes past the end of the row are masked out
+        __mmask16 m = (to-j >= 16) ? 0xFFFF : (__mmask16)((1u<<(to-j))-1u);
+        __mmask8 mlo = (__mmask8)(m & 0xFF);
+        __mmask8 mhi = (__mmask8)(m >> 8);
+
+        __m512 dx = _mm512_sub_ps(_mm512_maskz_loadu_ps(m,crd->xf+j),x1);
+        __m512 dy = _mm512_sub_ps(_mm512_maskz_loadu_ps(m,crd->yf+j),y1);
+        __m512 dz = _mm512_sub_ps(_mm512_maskz_loadu_ps(m,crd->zf+j),z1);
+
+        __m512 r2 = _mm512_fmadd_ps(dz,dz,_mm512_fmadd_ps(dy,dy,_mm512_mul_ps(dx,dx)));
+        __m512 r2i = _mm512_div_ps(one,r2);
+        __m512 r6 = _mm512_mul_ps(_mm512_mul_ps(r2i,r2i),r2i);
+
+        __m512i tj = _mm512_maskz_loadu_epi32(m,crd->type+j);
+        __m512 a = _mm512_mask_i32gather_ps(_mm512_setzero_ps(),m,tj,c12,4);
+        __m512 b = _mm512_mask_i32gather_ps(_mm512_setzero_ps(),m,tj,c6,4);
+
+        // the masked lanes may hold a NaN if atom i is at the origin, they are zeroed
+        __m512 e = _mm512_maskz_mov_ps(m,_mm512_mul_ps(r6,_mm512_fmsub_ps(a,r6,b)));
+        __m512d elo = _mm512_cvtps_pd(_mm512_castps512_ps256(e));
+        __m512d ehi = _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(e),1)));
+        acc = _mm512_add_pd(acc,_mm512_add_pd(elo,ehi));
+
+        if (out != NULL)
+        {
+            _mm512_mask_storeu_pd(out+j,mlo,elo);
+            _mm512_mask_storeu_pd(out+j+8,mhi,ehi);
+        }
+    }
+
+    return _mm512_reduce_add_pd(acc);
+}
+
+TARGET_AVX512
+double LJ_V_full_mixed_avx512(const COORDS *crd, const DATA *dat)
+{
+    double energy = 0.0;
+
+    for (uint32_t i=0; i<crd->natom; i++)
+        energy += LJ_row_mixed_avx512(crd,dat,i,i+1,crd->natom,NULL);
+
+    return energy;
+}
+
+TARGET_AVX512
+double LJ_V_cand_mixed_avx512(const COORDS *crd, const DATA *dat, uint32_t candidate)
+{
+    return LJ_row_mixed_avx512(crd,dat,candidate,0,candidate,NULL)
+           + LJ_row_mixed_avx512(crd,dat,candidate,candidate+1,crd->natom,NULL);
+}
+
+TARGET_AVX512
+double LJ_V_row_mixed_avx512(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[])
+{
+    row[candidate] = 0.0;
+    return LJ_row_mixed_avx512(crd,dat,candidate,0,candidate,row)
+           + LJ_row_mixed_avx512(crd,dat,candidate,candidate+1,crd->natom,row);
+}
+
+TARGET_AVX512
+double LJ_V_range_mixed_avx512(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t from, uint32_t to, double out[])
+{
+    return LJ_row_mixed_avx512(crd,dat,i,from,to,out);
+}
+
+#endif //SIMD_KERNELS
@@ -21,6 +21,7 @@
 #include "global.h"
 #include "io.h"
 #include "tools.h"
+#include "logger.h"
 
 /// header has to be written only once at the beginning of the dcd
 static uint32_t dcd_header_empty=1;
@@ -77,13 +78,28 @@ void read_xyz(ATOM at[], DATA *dat, FILE *inpf)
  * @param when At which step function was called
  */
 void write_dcd(ATOM at[], DATA *dat, uint64_t when)
+{
+    (void) when;
+
+    write_dcd_frame(at,dat,traj,dcd_header_empty);
+    dcd_header_empty=0;
+}
+
+/**
+ * Writes one frame to a CHARMM like dcd file, for example the trajectory of one replica
+ * @param at ATOM array where to store coordinates
+ * @param dat common simulation data
+ * @param outf FILE where to write the frame
+ * @param header if not 0 the header of the dcd is written first, i.e. for the first frame of the file
+ */
+void write_dcd_frame(ATOM at[], DATA *dat, FILE *outf, uint32_t header)
 {
     recentre(at,dat);
 
     uint32_t i=0;
     uint32_t sizeB = 0;
 
-    if (dcd_header_empty)
+    if (header)
     {
         char corp[4]= {'C','O','R','D'};
 
@@ -117,56 +133,55 @@ void write_dcd(ATOM at[], DATA *dat, uint64_t when)
         uint32_t NATOM=dat->natom;
 
         sizeB = sizeof(corp) + sizeof(ICNTRL);
-        fwrite(&sizeB,sizeof(uint32_t),1,traj);
+        fwrite(&sizeB,sizeof(uint32_t),1,outf);
         {
-            fwrite(corp,sizeof(char),4,traj);
-            fwrite(ICNTRL,sizeof(uint32_t),20,traj);
+            fwrite(corp,sizeof(char),4,outf);
+            fwrite(ICNTRL,sizeof(uint32_t),20,outf);
         }
-        fwrite(&sizeB,sizeof(uint32_t),1,traj);
+        fwrite(&sizeB,sizeof(uint32_t),1,outf);
 
         sizeB = sizeof(NTITLE) + NTITLE*80*sizeof(char);
-        fwrite(&sizeB,sizeof(uint32_t),1,traj);
+        fwrite(&sizeB,sizeof(uint32_t),1,outf);
         {
-            fwrite(&NTITLE,sizeof(uint32_t),1,traj);
+            fwrite(&NTITLE,sizeof(uint32_t),1,outf);
             for (i=0; i<NTITLE; i++)
-                fwrite(TITLE[i],sizeof(char),80,traj);
+                fwrite(TITLE[i],sizeof(char),80,outf);
         }
-        fwrite(&sizeB,sizeof(uint32_t),1,traj);
+        fwrite(&sizeB,sizeof(uint32_t),1,outf);
 
         sizeB = sizeof(NATOM);
-        fwrite(&sizeB,sizeof(uint32_t),1,traj);
-        fwrite(&NATOM,sizeof(uint32_t),1,traj);
-        fwrite(&sizeB,sizeof(uint32_t),1,traj);
+        fwrite(&sizeB,sizeof(uint32_t),1,outf);
+        fwrite(&NATOM,sizeof(uint32_t),1,outf);
+        fwrite(&sizeB,sizeof(uint32_t),1,outf);
 
-        dcd_header_empty=0;
     }
 
     float x=0.f,y=0.f,z=0.f;
     sizeB=(uint32_t)sizeof(float)*dat->natom;
 
-    fwrite(&sizeB,sizeof(uint32_t),1,traj);
+    fwrite(&sizeB,sizeof(uint32_t),1,outf);
     for(i=0; i<dat->natom; i++)
     {
         x=(float)at[i].x;
-        fwrite(&x,sizeof(float),1,traj);
+        fwrite(&x,sizeof(float),1,outf);
     }
-    fwrite(&sizeB,sizeof(uint32_t),1,traj);
+    fwrite(&sizeB,sizeof(uint32_t),1,outf);
 
-    fwrite(&sizeB,sizeof(uint32_t),1,traj);
+    fwrite(&sizeB,sizeof(uint32_t),1,outf);
     for(i=0; i<dat->natom; i++)
     {
         y=(float)at[i].y;
-        fwrite(&y,sizeof(float),1,traj);
+        fwrite(&y,sizeof(float),1,outf);
     }
-    fwrite(&sizeB,sizeof(uint32_t),1,traj);
+    fwrite(&sizeB,sizeof(uint32_t),1,outf);
 
-    fwrite(&sizeB,sizeof(uint32_t),1,traj);
+    fwrite(&sizeB,sizeof(uint32_t),1,outf);
     for(i=0; i<dat->natom; i++)
     {
         z=(float)at[i].z;
-        fwrite(&z,sizeof(float),1,traj);
+        fwrite(&z,sizeof(float),1,outf);
     }
-    fwrite(&sizeB,sizeof(uint32_t),1,traj);
+    fwrite(&sizeB,sizeof(uint32_t),1,outf);
 
 }
 /**
@@ -229,3 +244,47 @@ void write_rst(ATOM at[], DATA *dat, SPDAT *spdat, uint32_t meth)
     /** END **/
     fclose(rstfile);
 }
+
+/**
+ * Name of the output file of replica or walker r : _r is inserted before the extension of path,
+ * and /dev/null is kept as is
+ * @param out Where the name is written
+ * @param path Path given in the input file
+ * @param r Index of the replica or walker
+ */
+void indexed_path(char out[FILENAME_MAX], const char *path, uint32_t r)
+{
+    const char *dot = strrchr(path,'.');
+    const char *sep = strrchr(path,'/');
+
+    if (!strcmp(path,NULLFILE))
+        snprintf(out,FILENAME_MAX,"%s",path);
+    else if (dot != NULL && (sep == NULL || dot > sep))
+        snprintf(out,FILENAME_MAX,"%.*s_%u%s",(int)(dot-path),path,r,dot);
+    else
+        snprintf(out,FILENAME_MAX,"%s_%u",path,r);
+}
+
+/**
+ * Opens the output file of replica or walker r (see indexed_path), and exits if it can not be opened
+ * @param path Path given in the input file
+ * @param r Index of the replica or walker
+ * @param mode Mode given to fopen
+ * @return The opened file
+ */
+FILE* open_indexed(const char *path, uint32_t r, const char *mode)
+{
+    char fname[FILENAME_MAX];
+    FILE *f = NULL;
+
+    indexed_path(fname,path,r);
+
+    f = fopen(fname,mode);
+    if (f==NULL)
+    {
+        LOG_PRINT(LOG_ERROR,"Error while opening output file %s\n",fname);
+        exit(-1);
+    }
+
+    return f;
+}
@@ -31,11 +31,19 @@
 #endif
 
 #include "global.h"
+#include "coords.h"
+#include "cells.h"
+#include "nlist.h"
+#include "table.h"
+#include "manybody.h"
+#include "threebody.h"
+#include "ener.h"
 #include "MCclassic.h"
 #include "MCspav.h"
+#include "MCptmc.h"
+#include "MCwalkers.h"
 #include "tools.h"
 #include "rand.h"
-#include "ener.h"
 #include "minim.h"
 #include "io.h"
 #include "parsing.h"
@@ -59,6 +67,14 @@ FILE *traj=NULL;
 FILE *crdfile=NULL;
 FILE *efile=NULL;
 
+// pointers to the energy, gradient and trajectory functions (see ener.h and io.h)
+ENERGY (*get_ENER)(const COORDS *crd, const DATA *dat, int32_t candidate) = NULL;
+void   (*get_DV)(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[]) = NULL;
+double (*get_ENER_ROW)(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[]) = NULL;
+double (*get_CONSTR)(const COORDS *crd, const DATA *dat, int32_t candidate) = NULL;
+ENERGY (*get_ENER_DV)(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[]) = NULL;
+void   (*write_traj)(ATOM at[], DATA *dat, uint64_t when) = NULL;
+
 /*
  * boolean like values
  * is the stdout redirected ?
@@ -94,8 +110,10 @@ LUA_PLUGIN_TYPE lua_plugin_type = PAIR;
 // -----------------------------------------------------------------------------------------
 
 //prototypes of functions written in this main.c
-void start_classic(DATA *dat, ATOM at[]);
-void start_spav(DATA *dat, SPDAT *spdat, ATOM at[]);
+void start_classic(DATA *dat, COORDS *crd, ATOM at[]);
+void start_spav(DATA *dat, SPDAT *spdat, COORDS *crd, ATOM at[]);
+void start_ptmc(DATA *dat, COORDS *crd, ATOM at[]);
+void start_walkers(DATA *dat, COORDS *crd, ATOM at[]);
 void help(char **argv);
 void getValuesFromDB(DATA *dat);
 
@@ -127,10 +145,20 @@ int main(int argc, char** argv)
     DATA dat ;
     SPDAT spdat = {5,5,0.5,NULL,0};
     ATOM *at = NULL;
+    COORDS crd;
+
+#ifdef _OPENMP
+    // by default all the threads allowed by the OpenMP runtime (e.g. OMP_NUM_THREADS) are used
+    ncpus = (uint32_t) omp_get_num_procs();
+    nthreads = (uint32_t) omp_get_max_threads();
+#endif
 
     // function pointers for energy and gradient, and trajectory
     get_ENER = NULL;
     get_DV = NULL;
+    get_ENER_ROW = NULL;
+    get_CONSTR = NULL;
+    get_ENER_DV = NULL;
     write_traj= &(write_dcd);
 
     // arguments parsing
@@ -184,9 +212,8 @@ int main(int argc, char** argv)
         else if (!strcasecmp(argv[i],"-np"))
         {
             nthreads=atoi(argv[++i]);
-            ncpus=omp_get_num_procs();
-            (nthreads < ncpus) ? omp_set_num_threads(nthreads) : omp_set_num_threads(ncpus);
-            //omp_set_num_threads(nthreads);
+            nthreads = (nthreads < ncpus) ? nthreads : ncpus;
+            omp_set_num_threads(nthreads);
         }
 #endif
         // print help and proper exit
@@ -255,11 +282,189 @@ int main(int argc, char** argv)
 
     // set the pointer to the default V and dV functions
     if(get_ENER==NULL)
+    {
         get_ENER = &(get_LJ_V);
+        get_ENER_ROW = &(get_LJ_V_row);
+        get_CONSTR = &(get_LJ_CONSTR);
+        get_ENER_DV = &(get_LJ_V_DV);
+    }
 
     if(get_DV==NULL)
         get_DV = &(get_LJ_DV);
 
+    // a cutoff is only implemented for the L-J potential ; the per atom energy cache is not used then
+    // as its O(N) update would cost more than the energy of a candidate
+    if (dat.cut_mode != CUT_NONE)
+    {
+        if (get_ENER==&(get_LJ_V))
+        {
+            get_ENER = &(get_LJ_V_cut);
+            get_DV = &(get_LJ_DV_cut);
+            get_ENER_DV = &(get_LJ_V_DV_cut);
+            get_ENER_ROW = NULL;
+        }
+        else
+        {
+            LOG_PRINT(LOG_WARNING,"CUTOFF is only available for the L-J potential and is ignored.\n");
+            dat.cut_mode = CUT_NONE;
+        }
+    }
+
+    if (dat.skin > 0.0 && dat.cut_mode == CUT_NONE)
+    {
+        LOG_PRINT(LOG_WARNING,"VERLET requires a CUTOFF with the L-J potential and is ignored.\n");
+        dat.skin = 0.0;
+    }
+
+    // the mixed precision kernels only exist for the L-J potential without cutoff
+    if (dat.precision == PREC_MIXED && get_ENER != &(get_LJ_V))
+    {
+        LOG_PRINT(LOG_WARNING,"PRECISION MIXED is only available for the L-J potential without CUTOFF and is ignored.\n");
+        dat.precision = PREC_DOUBLE;
+    }
+
+    // the early rejection relies on the well depths of the L-J pairs
+    if (dat.early_rej != 0 && get_ENER != &(get_LJ_V))
+    {
+        LOG_PRINT(LOG_WARNING,"METHOD METROP EARLY is only available for the L-J potential without CUTOFF and is ignored.\n");
+        dat.early_rej = 0;
+    }
+
+    // the bound of the early rejection is computed in double precision : with the float kernels a move near the
+    // threshold could be rejected early while its mixed precision energy would accept it
+    if (dat.early_rej != 0 && dat.precision == PREC_MIXED)
+    {
+        LOG_PRINT(LOG_WARNING,"METHOD METROP EARLY is not available with PRECISION MIXED and is ignored.\n");
+        dat.early_rej = 0;
+    }
+
+    // the bound of the early rejection ignores the three-body term, which may be negative
+    if (dat.early_rej != 0 && dat.threebody)
+    {
+        LOG_PRINT(LOG_WARNING,"METHOD METROP EARLY is not available with THREEBODY and is ignored.\n");
+        dat.early_rej = 0;
+    }
+
+    // the nearest neighbours of an atom need at least one other atom
+    if (dat.early_rej != 0 && dat.natom < 2)
+    {
+        LOG_PRINT(LOG_WARNING,"METHOD METROP EARLY needs at least 2 atoms and is ignored.\n");
+        dat.early_rej = 0;
+    }
+
+    // parallel tempering needs a ladder of at least two temperatures above TEMP
+    if (strcasecmp(dat.method,"ptmc")==0 && (dat.pt_nrep < 2 || dat.pt_tmax <= dat.T || dat.pt_exch == 0))
+    {
+        LOG_PRINT(LOG_ERROR,"METHOD PTMC requires NREP of at least 2, TMAX higher than TEMP and EXCHANGE of at least 1.\n");
+        exit(-1);
+    }
+
+    // the walkers are independent Metropolis chains
+    if (dat.n_walkers > 1 && strcasecmp(dat.method,"metrop")!=0)
+    {
+        LOG_PRINT(LOG_WARNING,"WALKERS is only available with METHOD METROP and is ignored.\n");
+        dat.n_walkers = 1;
+    }
+
+    // several atoms are only moved together by the Metropolis chains, without early rejection
+    if (dat.n_move > dat.natom)
+    {
+        LOG_PRINT(LOG_WARNING,"MOVE NATOMS %u is larger than the number of atoms : %u is used.\n",dat.n_move,dat.natom);
+        dat.n_move = dat.natom;
+    }
+
+    if (dat.n_move > 1 && strcasecmp(dat.method,"metrop")!=0 && strcasecmp(dat.method,"ptmc")!=0)
+    {
+        LOG_PRINT(LOG_WARNING,"MOVE NATOMS is only available with METHOD METROP or PTMC and is ignored.\n");
+        dat.n_move = 1;
+        dat.n_move_rand = 0;
+    }
+
+    if (dat.early_rej != 0 && dat.n_move > 1)
+    {
+        LOG_PRINT(LOG_WARNING,"METHOD METROP EARLY is not available with MOVE NATOMS and is ignored.\n");
+        dat.early_rej = 0;
+    }
+
+    // the speculative trial moves are the ones of a single atom, one per thread by default
+#ifdef _OPENMP
+    if (dat.n_spec == 0)
+        dat.n_spec = nthreads;
+
+    // the trial moves beyond one per thread would be evaluated one after the other, and mostly discarded
+    if (dat.n_spec > 1 && nthreads == 1)
+    {
+        LOG_PRINT(LOG_WARNING,"METHOD METROP SPECULATIVE needs at least 2 threads and is ignored.\n");
+        dat.n_spec = 1;
+    }
+    else if (dat.n_spec > nthreads)
+    {
+        LOG_PRINT(LOG_WARNING,"METHOD METROP SPECULATIVE %u is larger than the number of threads : %u is used.\n",dat.n_spec,nthreads);
+        dat.n_spec = nthreads;
+    }
+#else
+    if (dat.n_spec != 1)
+    {
+        LOG_PRINT(LOG_WARNING,"METHOD METROP SPECULATIVE is only available when compiled with OpenMP and is ignored.\n");
+        dat.n_spec = 1;
+    }
+#endif
+
+#ifdef LUA_PLUGINS
+    if (dat.n_spec > 1 && (get_ENER == &(get_lua_V) || get_ENER == &(get_lua_V_ffi)))
+    {
+        LOG_PRINT(LOG_WARNING,"METHOD METROP SPECULATIVE is not available with the Lua plugins and is ignored.\n");
+        dat.n_spec = 1;
+    }
+#endif
+
+    if (dat.n_spec > 1 && (dat.n_move > 1 || dat.n_move_rand))
+    {
+        LOG_PRINT(LOG_WARNING,"METHOD METROP SPECULATIVE is not available with MOVE NATOMS and is ignored.\n");
+        dat.n_spec = 1;
+    }
+
+    if (dat.n_spec > 1 && dat.early_rej != 0)
+    {
+        LOG_PRINT(LOG_WARNING,"METHOD METROP SPECULATIVE is not available with EARLY and is ignored.\n");
+        dat.n_spec = 1;
+    }
+
+    if (dat.n_spec > 1 && dat.n_walkers > 1)
+    {
+        LOG_PRINT(LOG_WARNING,"METHOD METROP SPECULATIVE is not available with WALKERS and is ignored.\n");
+        dat.n_spec = 1;
+    }
+
+    // the tabulated potential samples the selected pair potential once for all
+    if (dat.tab_src != TAB_NONE)
+        alloc_pair_table(&dat);
+
+    // the simulation works on a structure of arrays copy of the atom list, which is kept for I/O
+    alloc_coords(&crd,dat.natom);
+    atoms_to_coords(at,&crd);
+
+    // the mixed precision kernels read single precision copies of the coordinates
+    if (dat.precision == PREC_MIXED)
+        alloc_coords_mixed(&crd);
+
+    // select the vectorised Lennard-Jones kernels supported by this cpu, and specialised for the species present
+    const char *lj_kernels = init_LJ_kernels(&crd,&dat);
+
+    // with a cutoff the neighbours of an atom are found with a cell grid, which is also used for building the Verlet lists ;
+    // the same grid gives the triplets of the three-body term if it has a cutoff
+    if (dat.cut_mode != CUT_NONE)
+        alloc_cells(&crd,fmax(dat.cutoff+dat.skin,dat.tb_cutoff));
+    else if (dat.threebody && dat.tb_cutoff > 0.0)
+        alloc_cells(&crd,dat.tb_cutoff);
+
+    if (dat.skin > 0.0)
+        alloc_nlist(&crd,dat.cutoff,dat.skin);
+
+    // the densities of the many-body potentials are updated with each move
+    if (dat.mb_kind != MB_NONE)
+        alloc_density(&crd);
+
     // allocate arrays used by energy minimisation function
     alloc_minim(&dat);
 
@@ -274,15 +479,57 @@ int main(int argc, char** argv)
     fprintf(stdout,"Seed   = %s \n\n",seed);
 
     if (get_ENER==&(get_LJ_V))
-        fprintf(stdout,"Using L-J potential\n");
+        fprintf(stdout,"Using L-J potential (%s kernels)\n",lj_kernels);
+    else if (get_ENER==&(get_LJ_V_cut))
+    {
+        fprintf(stdout,"Using L-J potential with a cutoff of %lf (%s) and cell lists\n",dat.cutoff,
+                (dat.cut_mode==CUT_SHIFT) ? "shifted" : (dat.cut_mode==CUT_SWITCH) ? "switched" : "truncated");
+        if (dat.skin > 0.0)
+            fprintf(stdout,"Using Verlet lists with a skin of %lf\n",dat.skin);
+    }
     else if (get_ENER==&(get_AZIZ_V))
         fprintf(stdout,"Using Aziz potential\n");
+    else if (get_ENER==&(get_MB_V))
+        fprintf(stdout,"Using %s many-body potential\n",(dat.mb_kind==MB_GUPTA) ? "Gupta" : "Sutton-Chen");
+    else if (get_ENER==&(get_TAB_V))
+    {
+        fprintf(stdout,"Using tabulated %s potential\n",
+                (dat.tab_src==TAB_LJ) ? "L-J" : (dat.tab_src==TAB_AZIZ) ? "Aziz" : "plugin pair");
+        print_pair_table(&dat);
+    }
 #ifdef LUA_PLUGINS
     else if (get_ENER==&(get_lua_V))
         fprintf(stdout,"Using plugin pair potential\n");
     else if (get_ENER==&(get_lua_V_ffi))
         fprintf(stdout,"Using plugin ffi potential\n");
 #endif
+
+    if (dat.threebody)
+    {
+        if (dat.tb_cutoff > 0.0)
+            fprintf(stdout,"Using Axilrod-Teller three-body term with a cutoff of %lf\n",dat.tb_cutoff);
+        else
+            fprintf(stdout,"Using Axilrod-Teller three-body term\n");
+    }
+
+    if (dat.n_move > 1)
+    {
+        if (dat.n_move_rand)
+            fprintf(stdout,"Moving 1 to %u atoms together at each step\n",dat.n_move);
+        else
+            fprintf(stdout,"Moving %u atoms together at each step\n",dat.n_move);
+    }
+
+    if (dat.n_spec > 1)
+        fprintf(stdout,"Evaluating %u trial moves together at each step (speculative Metropolis)\n",dat.n_spec);
+
+    if (dat.det_sum)
+        fprintf(stdout,"Energies summed in a deterministic order, by blocks of %d atoms\n",DET_BLOCK);
+
+#ifdef _OPENMP
+    // parallel evaluation of the energy of a candidate only for large systems
+    init_omp_cand(&crd);
+#endif
     
     if (charmm_units)
         fprintf(stdout,"Using CHARMM  units.\n\n");
@@ -317,13 +564,21 @@ int main(int argc, char** argv)
                 "targeting %4.2lf %% of acceptance \n\n",dat.d_max,dat.d_max_when,dat.d_max_tgt);
 
     // then depending of the type of simulation run calculation
-    if (strcasecmp(dat.method,"metrop")==0)
+    if (strcasecmp(dat.method,"metrop")==0 && dat.n_walkers > 1)
+    {
+        start_walkers(&dat,&crd,at);
+    }
+    else if (strcasecmp(dat.method,"metrop")==0)
     {
-        start_classic(&dat,at);
+        start_classic(&dat,&crd,at);
     }
     else if (strcasecmp(dat.method,"spav")==0)
     {
-        start_spav(&dat,&spdat,at);
+        start_spav(&dat,&spdat,&crd,at);
+    }
+    else if (strcasecmp(dat.method,"ptmc")==0)
+    {
+        start_ptmc(&dat,&crd,at);
     }
     else
     {
@@ -344,7 +599,17 @@ int main(int argc, char** argv)
             (double)infos_usage.ru_utime.tv_sec+(double)infos_usage.ru_utime.tv_usec/1000000.0 +
             (double)infos_usage.ru_stime.tv_sec+(double)infos_usage.ru_stime.tv_usec/1000000.0
            );
+    if (dat.threebody)
+        fprintf(stdout,"Three-body term time in Seconds : %lf (%.2lf %% of the execution time)\n",get_3B_time(),
+                100.0*get_3B_time()/((double)infos_usage.ru_utime.tv_sec+(double)infos_usage.ru_utime.tv_usec/1000000.0 +
+                                     (double)infos_usage.ru_stime.tv_sec+(double)infos_usage.ru_stime.tv_usec/1000000.0));
+#else
+    if (dat.threebody)
+        fprintf(stdout,"Three-body term time in Seconds : %lf\n",get_3B_time());
 #endif
+    // only the builds of the committed configuration, the ones of the replicas and walkers are printed by their run
+    if (dat.skin > 0.0 && strcasecmp(dat.method,"ptmc")!=0 && dat.n_walkers < 2)
+        fprintf(stdout,"Verlet lists were built %"PRIu64" times\n",crd.nlist->nbuild);
     fprintf(stdout,"End of program\n");
 
     // free memory and exit properly
@@ -353,6 +618,13 @@ int main(int argc, char** argv)
     free(dat.seeds);
 #endif
     free(at);
+    free_coords(&crd);
+    free(dat.ljp);
+    free_LJ_table(&dat);
+    free_AZIZ_table(&dat);
+    free_pair_table();
+    free_MB_table();
+    free_3B_table();
     dealloc_minim();
 
 #ifdef LUA_PLUGINS
@@ -374,9 +646,10 @@ int main(int argc, char** argv)
  *          In the end it prints results, close the files and goes back to the function \b #main.
  *
  * \param   dat is a structure containing control parameters common to all simulations.
- * \param   at[] is an array of structures ATOM containing coordinates and other variables.
+ * \param   crd is the structure of arrays containing the coordinates used during the simulation.
+ * \param   at[] is an array of structures ATOM containing coordinates and other variables, used for I/O.
  */
-void start_classic(DATA *dat, ATOM at[])
+void start_classic(DATA *dat, COORDS *crd, ATOM at[])
 {
     double ener = 0.0 ;
     uint64_t acc=0;
@@ -391,12 +664,14 @@ void start_classic(DATA *dat, ATOM at[])
     fclose(crdfile);
 
     //get initial energy of whole system
-    ener = (*get_ENER)(at,dat,-1);
+    ener = (*get_ENER)(crd,dat,-1).pair;
+    if (dat->threebody)
+        ener += get_3B_V(crd,dat,-1);
     fprintf(stdout,"\nStarting METROP Monte-Carlo\n");
     fprintf(stdout,"LJ initial energy is : %lf \n\n",ener);
 
     //CALL TO MAIN mc FUNCTION
-    acc=make_MC_moves(at,dat,&ener);
+    acc=make_MC_moves(crd,at,dat,&ener);
     //simulation finished here
     
     fprintf(stdout,"\n\nLJ final energy is : %lf\n",ener);
@@ -423,9 +698,10 @@ void start_classic(DATA *dat, ATOM at[])
  *
  * \param   dat is a structure containing control parameters common to all simulations.
  * \param   spdat is a structure containing control parameters dedicated to Spatial Averaging simulations.
- * \param   at[] is an array of structures ATOM containing coordinates and other variables.
+ * \param   crd is the structure of arrays containing the coordinates used during the simulation.
+ * \param   at[] is an array of structures ATOM containing coordinates and other variables, used for I/O.
  */
-void start_spav(DATA *dat, SPDAT *spdat, ATOM at[])
+void start_spav(DATA *dat, SPDAT *spdat, COORDS *crd, ATOM at[])
 {
     fprintf(stdout,"SPAV parameters are :\n");
     fprintf(stdout,"W_EPSILON = %lf\nM_EPSILON = %d\nN_EPSILON = %d\n\n",spdat->weps,spdat->meps,spdat->neps);
@@ -449,13 +725,15 @@ void start_spav(DATA *dat, SPDAT *spdat, ATOM at[])
     fclose(crdfile);
 
     //get E of whole system
-    ener = (*get_ENER)(at,dat,-1);
+    ener = (*get_ENER)(crd,dat,-1).pair;
+    if (dat->threebody)
+        ener += get_3B_V(crd,dat,-1);
 
     fprintf(stdout,"\nStarting SPAV\n");
     fprintf(stdout,"LJ initial energy is : %lf \n\n",ener);
 
     //run sp avg simulation
-    acc=launch_SPAV(at,dat,spdat,&ener);
+    acc=launch_SPAV(crd,at,dat,spdat,&ener);
 
     fprintf(stdout,"LJ final energy is : %lf\n",ener);
     fprintf(stdout,"Acceptance ratio is %lf %% \n",100.0*(double)acc/(double)dat->nsteps);
@@ -475,6 +753,86 @@ void start_spav(DATA *dat, SPDAT *spdat, ATOM at[])
     free(spdat->normalNumbs);
 }
 
+// -----------------------------------------------------------------------------------------
+/**
+ * \brief   This function starts a Parallel Tempering Monte Carlo (PTMC) simulation.
+ *
+ * \details This function writes the initial coordinates and computes the initial energy, shared by all the replicas.\n
+ *          Then the function \b #launch_PTMC starting the simulation is called ; it opens and closes the output
+ *          files of each temperature itself.\n
+ *          In the end it prints results and goes back to the function \b #main.
+ *
+ * \param   dat is a structure containing control parameters common to all simulations.
+ * \param   crd is the structure of arrays containing the coordinates used during the simulation.
+ * \param   at[] is an array of structures ATOM containing coordinates and other variables, used for I/O.
+ */
+void start_ptmc(DATA *dat, COORDS *crd, ATOM at[])
+{
+    double ener = 0.0 ;
+    uint64_t acc=0;
+
+    //write initial coordinates
+    crdfile=fopen(io.crdtitle_first,"wt");
+    write_xyz(at,dat,0,crdfile);
+    fclose(crdfile);
+
+    //get initial energy of whole system
+    ener = (*get_ENER)(crd,dat,-1).pair;
+    if (dat->threebody)
+        ener += get_3B_V(crd,dat,-1);
+    fprintf(stdout,"\nStarting PTMC Monte-Carlo with %u replicas\n",dat->pt_nrep);
+    fprintf(stdout,"LJ initial energy is : %lf \n\n",ener);
+
+    //CALL TO MAIN ptmc FUNCTION
+    acc=launch_PTMC(crd,at,dat,&ener);
+    //simulation finished here
+
+    fprintf(stdout,"\n\nLJ final energy is : %lf\n",ener);
+    fprintf(stdout,"Acceptance ratio is %lf %% \n",100.0*(double)acc/((double)dat->nsteps*(double)dat->pt_nrep));
+    fprintf(stdout,"Final dmax = %lf\n",dat->d_max);
+    fprintf(stdout,"End of PTMC Monte-Carlo\n\n");
+}
+
+// -----------------------------------------------------------------------------------------
+/**
+ * \brief   This function starts several independent Metropolis Monte Carlo simulations (walkers).
+ *
+ * \details This function writes the initial coordinates and computes the initial energy, shared by all the walkers.\n
+ *          Then the function \b #launch_walkers starting the simulations is called ; it opens and closes the output
+ *          files of each walker itself.\n
+ *          In the end it prints results and goes back to the function \b #main.
+ *
+ * \param   dat is a structure containing control parameters common to all simulations.
+ * \param   crd is the structure of arrays containing the coordinates used during the simulation.
+ * \param   at[] is an array of structures ATOM containing coordinates and other variables, used for I/O.
+ */
+void start_walkers(DATA *dat, COORDS *crd, ATOM at[])
+{
+    double ener = 0.0 ;
+    uint64_t acc=0;
+
+    //write initial coordinates
+    crdfile=fopen(io.crdtitle_first,"wt");
+    write_xyz(at,dat,0,crdfile);
+    fclose(crdfile);
+
+    //get initial energy of whole system
+    ener = (*get_ENER)(crd,dat,-1).pair;
+    if (dat->threebody)
+        ener += get_3B_V(crd,dat,-1);
+    fprintf(stdout,"\nStarting METROP Monte-Carlo with %u walkers\n",dat->n_walkers);
+    fprintf(stdout,"LJ initial energy is : %lf \n\n",ener);
+
+    //CALL TO MAIN walkers FUNCTION
+    acc=launch_walkers(crd,at,dat,&ener);
+    //simulation finished here
+
+    fprintf(stdout,"\n\nLJ final energy is : %lf\n",ener);
+    fprintf(stdout,"Acceptance ratio is %lf %% \n",100.0*(double)acc/((double)dat->nsteps*(double)dat->n_walkers));
+    fprintf(stdout,"Final dmax = %lf\n",dat->d_max);
+    fprintf(stdout,"End of METROP Monte-Carlo\n\n");
+}
+
 // -----------------------------------------------------------------------------------------
 /**
  * \brief   This function simply prints a basic help message.
@@ -0,0 +1,469 @@
+/**
+ * \file manybody.c
+ *
+ * \brief Many-body potentials of the embedded atom kind, for metal clusters : Gupta and Sutton-Chen
+ *
+ * \details Both are written as E = sum_{i<j} phi(r_ij) - sum_i G_i sqrt(rho_i), where the density of atom i is
+ *          rho_i = sum_{j!=i} f(r_ij) :
+ *          - Gupta (POTENTIAL GUPTA) : phi(r) = 2A exp(-p(r/r0-1)), f(r) = xi^2 exp(-2q(r/r0-1)) and G = 1 ;
+ *              Cleri and Rosato, Phys. Rev. B 48, 22 (1993)
+ *          - Sutton-Chen (POTENTIAL SC) : phi(r) = epsilon (a/r)^n, f(r) = (a/r)^m and G = epsilon c ;
+ *              Sutton and Chen, Phil. Mag. Lett. 61, 139 (1990)
+ *
+ *          The parameters of two different species are mixed with arithmetic means, except epsilon of Sutton-Chen
+ *          which is mixed with a geometric mean (Rafii-Tabar and Sutton, Phil. Mag. Lett. 63, 217 (1991)) ;
+ *          G is always the one of the embedded atom. Parameters are in eV and angstroems, and the energies are
+ *          returned in kcal/mol like the ones of the Aziz potential.
+ *
+ *          The density of each atom is kept up to date in the coordinates store (COORDS::dens) by the functions of
+ *          coords.c : moving one atom changes its density and one term of the density of each other atom, so that
+ *          the energy of a trial move costs O(N) instead of O(N^2).
+ *
+ * \authors Florent Hedin (University of Basel, Switzerland) \n
+ *          Markus Meuwly (University of Basel, Switzerland)
+ *
+ * \copyright Copyright (c) 2011-2015, Florent Hedin, Markus Meuwly, and the University of Basel. \n
+ *            All rights reserved. \n
+ *            The 3-clause BSD license is applied to this software. \n
+ *            See LICENSE.txt
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+
+#include "global.h"
+#include "manybody.h"
+#include "logger.h"
+
+/**
+ * @brief Parameters of one species, in eV and angstroems :
+ *          A, xi, p, q, r0 for Gupta ; epsilon, c, a, n, m for Sutton-Chen
+ */
+typedef struct
+{
+    char sym[4];
+    double par[5];
+} MB_SPECIES;
+
+/*
+ * Built-in parameters :
+ *  Gupta from Cleri and Rosato, Phys. Rev. B 48, 22 (1993)
+ *  Sutton-Chen from Sutton and Chen, Phil. Mag. Lett. 61, 139 (1990)
+ */
+static const MB_SPECIES gupta_params[] =
+{
+    {"Ni",{0.0376,1.070,16.999,1.189,2.49}},
+    {"Cu",{0.0855,1.224,10.960,2.278,2.556}},
+    {"Rh",{0.0629,1.660,18.450,1.867,2.69}},
+    {"Pd",{0.1746,1.718,10.867,3.742,2.75}},
+    {"Ag",{0.1028,1.178,10.928,3.139,2.89}},
+    {"Ir",{0.1156,2.289,16.980,2.691,2.715}},
+    {"Pt",{0.2975,2.695,10.612,4.004,2.775}},
+    {"Au",{0.2061,1.790,10.229,4.036,2.884}},
+    {"Al",{0.1221,1.316,8.612,2.516,2.864}},
+    {"Pb",{0.0980,0.914,9.576,3.648,3.50}}
+};
+
+static const MB_SPECIES sc_params[] =
+{
+    {"Ni",{1.5707e-2,39.432,3.52,9.,6.}},
+    {"Cu",{1.2382e-2,39.432,3.61,9.,6.}},
+    {"Rh",{4.9371e-3,144.41,3.80,12.,6.}},
+    {"Pd",{4.1790e-3,108.27,3.89,12.,7.}},
+    {"Ag",{2.5415e-3,144.41,4.09,12.,6.}},
+    {"Ir",{2.4489e-3,334.94,3.84,14.,6.}},
+    {"Pt",{1.9833e-2,34.408,3.92,10.,8.}},
+    {"Au",{1.2793e-2,34.408,4.08,10.,8.}},
+    {"Pb",{5.5765e-3,45.778,4.95,10.,7.}},
+    {"Al",{3.3147e-2,16.399,4.05,7.,6.}}
+};
+
+/**
+ * @brief The functions of distance of one pair of species, in kcal/mol :
+ *          phi(r) = a exp(-alpha r) r^-n and f(r) = b exp(-beta r) r^-m
+ */
+typedef struct
+{
+    double a, alpha, n;
+    double b, beta, m;
+} MB_PAIR;
+
+/// parameters given in the input file
+static MB_SPECIES *user = NULL;
+static MANYBODY_KIND *user_kind = NULL;
+static uint32_t nuser = 0;
+
+/// potential in use, ntypes*ntypes table of the pairs of species, and G of each species
+static MANYBODY_KIND kind = MB_NONE;
+static MB_PAIR *pairs = NULL;
+static double *emb = NULL;
+static uint32_t nt = 0;
+
+/*
+ * phi(r) and f(r) of the pair of species p ; Gupta only needs the exponentials
+ */
+static inline void mb_pair(const MB_PAIR *restrict p, double r, double *phi, double *f)
+{
+    const double lr = (kind==MB_SC) ? log(r) : 0.0;
+
+    *phi = p->a*exp(-p->alpha*r - p->n*lr);
+    *f = p->b*exp(-p->beta*r - p->m*lr);
+}
+
+/*
+ * Same as mb_pair, with the derivatives dphi/dr and df/dr stored in dphi and df
+ */
+static inline void mb_pair_dv(const MB_PAIR *restrict p, double r, double *phi, double *f, double *dphi, double *df)
+{
+    mb_pair(p,r,phi,f);
+
+    *dphi = -(*phi)*(p->alpha + p->n/r);
+    *df = -(*f)*(p->beta + p->m/r);
+}
+
+/*
+ * Density function f(r_ij) only
+ */
+static inline double mb_dens(const COORDS *crd, uint32_t i, uint32_t j, double xi, double yi, double zi)
+{
+    const MB_PAIR *p = &pairs[crd->type[i]*nt+crd->type[j]];
+    const double r = sqrt( X2(xi-crd->x[j]) + X2(yi-crd->y[j]) + X2(zi-crd->z[j]) );
+    const double lr = (kind==MB_SC) ? log(r) : 0.0;
+
+    return p->b*exp(-p->beta*r - p->m*lr);
+}
+
+/**
+ * @brief Registers the parameters of a species given in the input file, which are used instead of the built-in ones
+ *
+ * @param kind MB_GUPTA (A, xi, p, q, r0) or MB_SC (epsilon, c, a, n, m)
+ * @param sym Atomic symbol
+ * @param par The 5 parameters, in eV and angstroems
+ */
+void set_MB_params(MANYBODY_KIND kind, const char *sym, const double par[5])
+{
+    user = realloc(user,(nuser+1)*sizeof *user);
+    user_kind = realloc(user_kind,(nuser+1)*sizeof *user_kind);
+
+    snprintf(user[nuser].sym,sizeof user[nuser].sym,"%s",sym);
+    memcpy(user[nuser].par,par,sizeof user[nuser].par);
+    user_kind[nuser] = kind;
+
+    nuser++;
+}
+
+/*
+ * Parameters of the species sym : from the input file first, otherwise the built-in ones
+ */
+static const double* find_MB_params(const char *sym)
+{
+    uint32_t i;
+    const MB_SPECIES *list = (kind==MB_GUPTA) ? gupta_params : sc_params;
+    const uint32_t n = (kind==MB_GUPTA) ? sizeof gupta_params/sizeof *gupta_params : sizeof sc_params/sizeof *sc_params;
+
+    for (i=nuser; i>0; i--)
+        if (user_kind[i-1]==kind && !strcasecmp(user[i-1].sym,sym))
+            return user[i-1].par;
+
+    for (i=0; i<n; i++)
+        if (!strcasecmp(list[i].sym,sym))
+            return list[i].par;
+
+    return NULL;
+}
+
+/**
+ * @brief Resolves the parameters of each species from its atomic symbol, and builds the table of the mixed
+ *          functions of distance of each pair of species, converted to kcal/mol
+ *
+ * @param dat Common data, with dat->mb_kind the potential to use
+ */
+void build_MB_table(DATA *dat)
+{
+    uint32_t ti,tj;
+    const double **par = malloc(dat->ntypes*sizeof *par);
+
+    kind = dat->mb_kind;
+    nt = dat->ntypes;
+    pairs = malloc(nt*nt*sizeof *pairs);
+    emb = malloc(nt*sizeof *emb);
+
+    for (ti=0; ti<nt; ti++)
+    {
+        par[ti] = find_MB_params(dat->ljp[ti].sym);
+        if (par[ti] == NULL)
+        {
+            LOG_PRINT(LOG_ERROR,"Atom type %s is unknown to the %s potential : its parameters must be given with %s.\n",
+                      dat->ljp[ti].sym,(kind==MB_GUPTA) ? "Gupta" : "Sutton-Chen",(kind==MB_GUPTA) ? "GUPTAPARAMS" : "SCPARAMS");
+            exit(-1);
+        }
+    }
+
+    for (ti=0; ti<nt; ti++)
+    {
+        for (tj=0; tj<nt; tj++)
+        {
+            MB_PAIR *p = &pairs[ti*nt+tj];
+            double mix[5];
+
+            for (uint32_t k=0; k<5; k++)
+                mix[k] = 0.5*(par[ti][k]+par[tj][k]);
+
+            if (kind==MB_GUPTA)
+            {
+                // A, xi, p, q, r0 : the constant factors of the exponentials are moved to a and b
+                p->a = 2.0*mix[0]*exp(mix[2])*EVTOKCAL;
+                p->alpha = mix[2]/mix[4];
+                p->n = 0.0;
+                p->b = X2(mix[1])*exp(2.0*mix[3]);
+                p->beta = 2.0*mix[3]/mix[4];
+                p->m = 0.0;
+            }
+            else
+            {
+                // epsilon, c, a, n, m
+                const double eps = sqrt(par[ti][0]*par[tj][0]);
+
+                p->a = eps*pow(mix[2],mix[3])*EVTOKCAL;
+                p->alpha = 0.0;
+                p->n = mix[3];
+                p->b = pow(mix[2],mix[4]);
+                p->beta = 0.0;
+                p->m = mix[4];
+            }
+        }
+
+        emb[ti] = ((kind==MB_GUPTA) ? 1.0 : par[ti][0]*par[ti][1])*EVTOKCAL;
+    }
+
+    free(par);
+}
+
+void free_MB_table()
+{
+    free(pairs);
+    free(emb);
+    free(user);
+    free(user_kind);
+    pairs = NULL;
+    emb = NULL;
+    user = NULL;
+    user_kind = NULL;
+    nuser = 0;
+    nt = 0;
+}
+
+/*
+ * Densities of all the atoms from scratch, half loop over the pairs
+ */
+static void compute_density(const COORDS *crd, double rho[])
+{
+    uint32_t i,j;
+    double f;
+
+    memset(rho,0,crd->natom*sizeof(double));
+
+    for (i=0; i<crd->natom; i++)
+    {
+        for (j=i+1; j<crd->natom; j++)
+        {
+            f = mb_dens(crd,i,j,crd->x[i],crd->y[i],crd->z[i]);
+            rho[i] += f;
+            rho[j] += f;
+        }
+    }
+}
+
+/**
+ * @brief Allocates the densities of the many-body potential for the coordinates store crd and builds them
+ *
+ * @param crd The coordinates store
+ */
+void alloc_density(COORDS *crd)
+{
+    DENSITY *d = malloc(sizeof *d);
+
+    d->rho = malloc(crd->natom*sizeof *d->rho);
+
+    crd->dens = d;
+    build_density(crd);
+}
+
+void free_density(COORDS *crd)
+{
+    if (crd->dens == NULL)
+        return;
+
+    free(crd->dens->rho);
+    free(crd->dens);
+    crd->dens = NULL;
+}
+
+/**
+ * @brief Recomputes the densities from scratch, in O(N^2) ; also removes the rounding errors accumulated by move_density
+ */
+void build_density(COORDS *crd)
+{
+    compute_density(crd,crd->dens->rho);
+}
+
+/**
+ * @brief Updates the densities after atom i moved from (xo,yo,zo) to its current position, in O(N)
+ *
+ * @param crd The coordinates store
+ * @param i Index of the atom
+ * @param xo,yo,zo The previous position of the atom
+ */
+void move_density(COORDS *crd, uint32_t i, double xo, double yo, double zo)
+{
+    uint32_t j;
+    double f, rhoi = 0.0;
+    double *restrict rho = crd->dens->rho;
+
+    for (j=0; j<crd->natom; j++)
+    {
+        if (j==i)
+            continue;
+
+        f = mb_dens(crd,i,j,crd->x[i],crd->y[i],crd->z[i]);
+        rho[j] += f - mb_dens(crd,i,j,xo,yo,zo);
+        rhoi += f;
+    }
+
+    rho[i] = rhoi;
+}
+
+void copy_density(COORDS *dst, const COORDS *src)
+{
+    memcpy(dst->dens->rho,src->dens->rho,src->natom*sizeof(double));
+}
+
+/*
+ * The densities of a coordinates store : the maintained ones if any, otherwise computed in the buffer tmp
+ */
+static const double* get_density(const COORDS *crd, double **tmp)
+{
+    if (crd->dens != NULL)
+        return crd->dens->rho;
+
+    *tmp = malloc(crd->natom*sizeof **tmp);
+    compute_density(crd,*tmp);
+
+    return *tmp;
+}
+
+/**
+ * @brief Energy of the many-body potential : of the whole system (candidate=-1), or the part of it depending on the
+ *          position of a candidate, i.e. the energy of the system minus the one of the system without the candidate,
+ *          so that the difference between two positions of the candidate is the difference of the total energies.
+ *          With maintained densities (COORDS::dens) the energy of a candidate costs O(N).
+ */
+ENERGY get_MB_V(const COORDS *crd, const DATA *dat, int32_t candidate)
+{
+    uint32_t i,j;
+    double phi, f, r;
+    double *tmp = NULL;
+    const double *rho = get_density(crd,&tmp);
+    ENERGY e = {0.0, 0.0};
+
+    (void) dat;
+
+    if (candidate==-1)
+    {
+        for (i=0; i<crd->natom; i++)
+        {
+            for (j=i+1; j<crd->natom; j++)
+            {
+                r = sqrt( X2(crd->x[i]-crd->x[j]) + X2(crd->y[i]-crd->y[j]) + X2(crd->z[i]-crd->z[j]) );
+                mb_pair(&pairs[crd->type[i]*nt+crd->type[j]],r,&phi,&f);
+                e.pair += phi;
+            }
+
+            e.pair -= emb[crd->type[i]]*sqrt(rho[i]);
+        }
+    }
+    else
+    {
+        i = (uint32_t) candidate;
+
+        for (j=0; j<crd->natom; j++)
+        {
+            if (j==i)
+                continue;
+
+            r = sqrt( X2(crd->x[i]-crd->x[j]) + X2(crd->y[i]-crd->y[j]) + X2(crd->z[i]-crd->z[j]) );
+            mb_pair(&pairs[crd->type[i]*nt+crd->type[j]],r,&phi,&f);
+            e.pair += phi;
+
+            // embedding energy of j with and without the candidate : sqrt(rho)-sqrt(rho-f) without cancellation
+            if (f > 0.0)
+                e.pair -= emb[crd->type[j]]*f/(sqrt(rho[j])+sqrt(fmax(rho[j]-f,0.0)));
+        }
+
+        e.pair -= emb[crd->type[i]]*sqrt(rho[i]);
+    }
+
+    free(tmp);
+
+    return e;
+}
+
+/**
+ * @brief Energy of the whole system and its gradient : the derivative of the embedding energies of both atoms
+ *          of a pair is added to the one of the pair term
+ */
+ENERGY get_MB_V_DV(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[])
+{
+    uint32_t i,j;
+    double phi, f, dphi, df, r, de, dx, dy, dz;
+    double *tmp = NULL;
+    const double *rho = get_density(crd,&tmp);
+    const uint32_t natom = crd->natom;
+    double *demb = malloc(natom*sizeof *demb);
+    ENERGY e = {0.0, 0.0};
+
+    (void) dat;
+
+    memset(fx,0,natom*sizeof(double));
+    memset(fy,0,natom*sizeof(double));
+    memset(fz,0,natom*sizeof(double));
+
+    // derivative of the embedding energy of each atom with respect to its density
+    for (i=0; i<natom; i++)
+    {
+        e.pair -= emb[crd->type[i]]*sqrt(rho[i]);
+        demb[i] = (rho[i] > 0.0) ? -0.5*emb[crd->type[i]]/sqrt(rho[i]) : 0.0;
+    }
+
+    for (i=0; i<natom; i++)
+    {
+        for (j=i+1; j<natom; j++)
+        {
+            dx = crd->x[i]-crd->x[j];
+            dy = crd->y[i]-crd->y[j];
+            dz = crd->z[i]-crd->z[j];
+            r = sqrt(X2(dx) + X2(dy) + X2(dz));
+
+            mb_pair_dv(&pairs[crd->type[i]*nt+crd->type[j]],r,&phi,&f,&dphi,&df);
+            e.pair += phi;
+
+            de = (dphi + (demb[i]+demb[j])*df)/r;
+            fx[i] += de*dx; fy[i] += de*dy; fz[i] += de*dz;
+            fx[j] -= de*dx; fy[j] -= de*dy; fz[j] -= de*dz;
+        }
+    }
+
+    free(demb);
+    free(tmp);
+
+    return e;
+}
+
+void get_MB_DV(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[])
+{
+    get_MB_V_DV(crd,dat,fx,fy,fz);
+}
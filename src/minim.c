@@ -17,41 +17,62 @@
 #include <math.h>
 #include <string.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "global.h"
+#include "coords.h"
 #include "ener.h"
+#include "threebody.h"
 #include "logger.h"
 #include "minim.h"
 
-static double *fx = NULL ;
-static double *fy = NULL ;
-static double *fz = NULL ;
-
-static double *fxo = NULL ;
-static double *fyo = NULL ;
-static double *fzo = NULL ;
+/*
+ * Gradients of the steepest descent : the new and old x,y,z ones, one set of 6*natom values per OpenMP thread
+ * so that several chains (WALKERS) can be minimised at the same time
+ */
+static double *grad = NULL ;
 
 void alloc_minim(DATA *dat)
 {
-    fx  = malloc(dat->natom*sizeof *fx);
-    fy  = malloc(dat->natom*sizeof *fy);
-    fz  = malloc(dat->natom*sizeof *fz);
-
-    fxo  = malloc(dat->natom*sizeof *fxo);
-    fyo  = malloc(dat->natom*sizeof *fyo);
-    fzo  = malloc(dat->natom*sizeof *fzo);
+#ifdef _OPENMP
+    grad = malloc((size_t)nthreads*6*dat->natom*sizeof *grad);
+#else
+    grad = malloc((size_t)6*dat->natom*sizeof *grad);
+#endif
 }
 
 void dealloc_minim()
 {
-    free(fx);
-    free(fy);
-    free(fz);
-    free(fxo);
-    free(fyo);
-    free(fzo);
+    free(grad);
+    grad = NULL;
 }
 
-void steepd(ATOM at[],DATA *dat)
+/*
+ * Energy of the whole system and its gradient stored in fx,fy,fz : in a single sweep over the pairs
+ * when the potential provides get_ENER_DV, otherwise with two separate evaluations
+ */
+static double ener_and_grad(COORDS *crd, DATA *dat, double fx[], double fy[], double fz[])
+{
+    double e;
+
+    if (get_ENER_DV != NULL)
+        e = (*get_ENER_DV)(crd,dat,fx,fy,fz).pair;
+    else
+    {
+        (*get_DV)(crd,dat,fx,fy,fz);
+        e = (*get_ENER)(crd,dat,-1).pair;
+    }
+
+    // the gradient of the three-body term is added to the one of the pair potential
+    if (dat->threebody)
+        e += get_3B_DV(crd,dat,fx,fy,fz);
+
+    return e;
+}
+
+void steepd(COORDS *crd,DATA *dat)
 {
     uint32_t i=0,/*j=0,*/counter=0;
 
@@ -60,6 +81,14 @@ void steepd(ATOM at[],DATA *dat)
     double e1=0. , e2=0.;
     double diff;
 
+#ifdef _OPENMP
+    double *fx = grad + (size_t)6*dat->natom*omp_get_thread_num();
+#else
+    double *fx = grad;
+#endif
+    double *fy = fx + dat->natom, *fz = fy + dat->natom;
+    double *fxo = fz + dat->natom, *fyo = fxo + dat->natom, *fzo = fyo + dat->natom;
+
 //     ATOM *at2 = NULL ;
 
 //     at2 = malloc(dat->natom*sizeof *at2);
@@ -67,7 +96,7 @@ void steepd(ATOM at[],DATA *dat)
 //     for (i=0; i<(dat->natom); i++)
 //         memcpy(&at2[i],&at[i],sizeof(ATOM));
 
-    (*get_DV)(at,dat,fx,fy,fz);
+    ener_and_grad(crd,dat,fx,fy,fz);
     memcpy(fxo,fx,dat->natom*sizeof(double));
     memcpy(fyo,fy,dat->natom*sizeof(double));
     memcpy(fzo,fz,dat->natom*sizeof(double));
@@ -76,12 +105,13 @@ void steepd(ATOM at[],DATA *dat)
     {
         for (i=0; i<(dat->natom); i++)
         {
-            at[i].x -= alpha[0]*fx[i];
-            at[i].y -= alpha[1]*fy[i];
-            at[i].z -= alpha[2]*fz[i];
+            crd->x[i] -= alpha[0]*fx[i];
+            crd->y[i] -= alpha[1]*fy[i];
+            crd->z[i] -= alpha[2]*fz[i];
         }
+        refresh_coords(crd);
 
-        (*get_DV)(at,dat,fx,fy,fz);
+        e1 = ener_and_grad(crd,dat,fx,fy,fz)/dat->ljp[crd->type[0]].eps;
 
 //         LOG_PRINT(LOG_DEBUG,"SteepD alpha vector old = %lf %lf %lf\n",alpha[0],alpha[1],alpha[2]);
         adjust_alpha(dat->natom,fxo,fx,alpha);
@@ -93,7 +123,6 @@ void steepd(ATOM at[],DATA *dat)
         memcpy(fyo,fy,dat->natom*sizeof(double));
         memcpy(fzo,fz,dat->natom*sizeof(double));
 
-        e1 = (*get_ENER)(at,dat,-1)/at[0].ljp.eps;
         diff = fabs(e1-e2);
         e2=e1;
 
@@ -0,0 +1,227 @@
+/**
+ * \file nlist.c
+ *
+ * \brief Functions managing the Verlet neighbour lists (see NLIST in global.h), which hold for each atom
+ *          the atoms closer than the cutoff plus a skin distance
+ *
+ * \authors Florent Hedin (University of Basel, Switzerland) \n
+ *          Markus Meuwly (University of Basel, Switzerland)
+ *
+ * \copyright Copyright (c) 2011-2015, Florent Hedin, Markus Meuwly, and the University of Basel. \n
+ *            All rights reserved. \n
+ *            The 3-clause BSD license is applied to this software. \n
+ *            See LICENSE.txt
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "cells.h"
+#include "nlist.h"
+#include "logger.h"
+
+/// identifier of the last build, shared by all the lists
+static uint64_t nlist_stamp = 0;
+
+/**
+ * @brief Allocates Verlet lists for the coordinates store crd and builds them
+ *
+ * @param crd The coordinates store ; if it has a cell grid its cells have to be at least rc+skin large
+ * @param rc The cutoff of the potential
+ * @param skin The skin distance
+ */
+void alloc_nlist(COORDS *crd, double rc, double skin)
+{
+    NLIST *l = malloc(sizeof *l);
+
+    l->rc = rc;
+    l->skin = skin;
+    l->x0 = malloc(crd->natom*sizeof *l->x0);
+    l->y0 = malloc(crd->natom*sizeof *l->y0);
+    l->z0 = malloc(crd->natom*sizeof *l->z0);
+    l->start = malloc((crd->natom+1)*sizeof *l->start);
+    l->half = malloc(crd->natom*sizeof *l->half);
+    l->size = (uint64_t)NLIST_NB_PER_ATOM*crd->natom;
+    l->nb = malloc(l->size*sizeof *l->nb);
+    l->far = calloc(crd->natom,sizeof *l->far);
+    l->nfar = 0;
+    l->stamp = 0;
+    l->nbuild = 0;
+
+    crd->nlist = l;
+    build_nlist(crd);
+}
+
+void free_nlist(COORDS *crd)
+{
+    NLIST *l = crd->nlist;
+
+    if (l == NULL)
+        return;
+
+    free(l->x0);
+    free(l->y0);
+    free(l->z0);
+    free(l->start);
+    free(l->half);
+    free(l->nb);
+    free(l->far);
+    free(l);
+    crd->nlist = NULL;
+}
+
+/**
+ * @brief Builds the lists from the current positions, using the cell grid of crd if any
+ *
+ * @param crd The coordinates store
+ */
+void build_nlist(COORDS *crd)
+{
+    uint32_t i, j, k, n, a, b, tmp;
+    int32_t c;
+    uint32_t cl[27];
+    uint64_t cnt = 0;
+    NLIST *l = crd->nlist;
+    CELLS *cells = crd->cells;
+    const double rl2 = X2(l->rc+l->skin);
+
+    for (i=0; i<crd->natom; i++)
+    {
+        const double xi = crd->x[i], yi = crd->y[i], zi = crd->z[i];
+
+        l->start[i] = (uint32_t) cnt;
+
+        // the candidates are the atoms of the 27 surrounding cells, or all of them without a grid
+        n = (cells != NULL) ? get_neighbour_cells(cells,xi,yi,zi,cl) : 1;
+        for (k=0; k<n; k++)
+        {
+            c = (cells != NULL) ? cells->head[cl[k]] : 0;
+            while (c != -1 && (uint32_t)c < crd->natom)
+            {
+                j = (uint32_t) c;
+                c = (cells != NULL) ? cells->next[j] : c+1;
+
+                if (j==i || X2(xi-crd->x[j])+X2(yi-crd->y[j])+X2(zi-crd->z[j]) >= rl2)
+                    continue;
+
+                if (cnt == l->size)
+                {
+                    l->size *= 2;
+                    l->nb = realloc(l->nb,l->size*sizeof *l->nb);
+                }
+                l->nb[cnt++] = j;
+            }
+        }
+
+        // the neighbours j>i first, so that the half lists used for the total energy and the gradient are contiguous
+        a = l->start[i];
+        b = (uint32_t) cnt;
+        while (a < b)
+        {
+            if (l->nb[a] > i)
+                a++;
+            else
+            {
+                b--;
+                tmp = l->nb[a];
+                l->nb[a] = l->nb[b];
+                l->nb[b] = tmp;
+            }
+        }
+        l->half[i] = a;
+
+        l->x0[i] = xi;
+        l->y0[i] = yi;
+        l->z0[i] = zi;
+    }
+
+    l->start[crd->natom] = (uint32_t) cnt;
+
+    memset(l->far,0,crd->natom*sizeof *l->far);
+    l->nfar = 0;
+    // the lists of several replicas may be built concurrently (METHOD PTMC)
+#ifdef _OPENMP
+    #pragma omp atomic capture
+#endif
+    l->stamp = ++nlist_stamp;
+    l->nbuild++;
+
+    LOG_PRINT(LOG_DEBUG,"Verlet lists built (%"PRIu64" times) : %"PRIu64" neighbours\n",l->nbuild,cnt);
+}
+
+/**
+ * @brief Marks atom i as moved too far if it is further than skin/2 from its position when the lists were built.
+ *          The lists are not rebuilt here, as the move may still be rejected ; see refresh_nlist.
+ *
+ * @param crd The coordinates store, where atom i already has its new position
+ * @param i Index of the atom
+ */
+void move_nlist(COORDS *crd, uint32_t i)
+{
+    NLIST *l = crd->nlist;
+    const uint8_t far = (X2(crd->x[i]-l->x0[i])+X2(crd->y[i]-l->y0[i])+X2(crd->z[i]-l->z0[i]) > X2(0.5*l->skin));
+
+    if (far != l->far[i])
+    {
+        l->far[i] = far;
+        if (far)
+            l->nfar++;
+        else
+            l->nfar--;
+    }
+}
+
+/**
+ * @brief Checks the displacement of all the atoms, and rebuilds the lists if one of them moved by more than skin/2
+ *
+ * @param crd The coordinates store
+ */
+void refresh_nlist(COORDS *crd)
+{
+    for (uint32_t i=0; i<crd->natom; i++)
+        move_nlist(crd,i);
+
+    if (crd->nlist->nfar != 0)
+        build_nlist(crd);
+}
+
+/**
+ * @brief Copies the lists of src to dst, which must already have lists for the same number of atoms.
+ *          The lists themselves are only copied if they were built since the last copy.
+ *
+ * @param dst Destination coordinates store
+ * @param src Source coordinates store
+ */
+void copy_nlist(COORDS *dst, COORDS *src)
+{
+    NLIST *d = dst->nlist;
+    NLIST *s = src->nlist;
+    const uint32_t natom = src->natom;
+
+    if (d->stamp != s->stamp)
+    {
+        if (d->size < s->start[natom])
+        {
+            d->size = s->size;
+            d->nb = realloc(d->nb,d->size*sizeof *d->nb);
+        }
+
+        d->rc = s->rc;
+        d->skin = s->skin;
+        memcpy(d->x0,s->x0,natom*sizeof *s->x0);
+        memcpy(d->y0,s->y0,natom*sizeof *s->y0);
+        memcpy(d->z0,s->z0,natom*sizeof *s->z0);
+        memcpy(d->start,s->start,(natom+1)*sizeof *s->start);
+        memcpy(d->half,s->half,natom*sizeof *s->half);
+        memcpy(d->nb,s->nb,s->start[natom]*sizeof *s->nb);
+        d->stamp = s->stamp;
+    }
+
+    if (d->nfar != 0 || s->nfar != 0)
+    {
+        memcpy(d->far,s->far,natom*sizeof *s->far);
+        d->nfar = s->nfar;
+    }
+}
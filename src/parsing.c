@@ -24,8 +24,12 @@
 #include "tools.h"
 #include "logger.h"
 #include "plugins_lua.h"
+#include "table.h"
+#include "manybody.h"
+#include "threebody.h"
+#include "MCptmc.h"
 
-///the array of LJ-params size
+///the array of LJ-params size, i.e. the number of species
 static uint32_t lj_size = 0 ;
 
 /**
@@ -48,6 +52,39 @@ void parse_from_file(char fname[], DATA *dat, SPDAT *spdat, ATOM **at)
     FILE *ifile=NULL;
     ifile=fopen(fname,"r");
 
+    /// no cutoff by default
+    dat->cut_mode = CUT_NONE;
+    dat->cutoff = 0.0;
+    dat->cuton = 0.0;
+    dat->skin = 0.0;
+    /// double precision kernels by default
+    dat->precision = PREC_DOUBLE;
+    /// no early rejection of the Metropolis moves by default
+    dat->early_rej = 0;
+    /// the energies are summed in the fastest order by default
+    dat->det_sum = 0;
+    /// one atom moved at each step by default
+    dat->n_move = 1;
+    dat->n_move_rand = 0;
+    /// one trial move evaluated at each step by default
+    dat->n_spec = 1;
+    /// parallel tempering parameters, the ladder has to be given with METHOD PTMC
+    dat->pt_nrep = 0;
+    dat->pt_tmax = 0.0;
+    dat->pt_exch = PT_EXCH;
+    /// a single Metropolis chain by default
+    dat->n_walkers = 1;
+    /// no tabulated potential by default, and default grid if it is used
+    dat->tab_src = TAB_NONE;
+    dat->tab_points = 0;
+    dat->tab_rmin = 0.0;
+    dat->tab_rmax = 0.0;
+    /// no many-body potential by default
+    dat->mb_kind = MB_NONE;
+    /// no three-body term by default
+    dat->threebody = 0;
+    dat->tb_cutoff = 0.0;
+
     if (ifile==NULL)
     {
         LOG_PRINT(LOG_ERROR,"Error while opening the file '%s'\n",fname);
@@ -73,9 +110,34 @@ void parse_from_file(char fname[], DATA *dat, SPDAT *spdat, ATOM **at)
             ///to know which MC method we use
             if (!strcasecmp(buff2,"METHOD"))
             {
-                ///no extra parameter for Metropolis currently
+                ///Metropolis, optionally with the early rejection of the moves : METROP EARLY [k]
+                ///where k is the number of nearest neighbours visited, or with p trial moves
+                ///evaluated together : METROP SPECULATIVE [p], p being the number of threads by default
                 if (!strcasecmp(buff3,"METROP"))
+                {
+                    char *early=NULL , *near=NULL;
+
                     sprintf(dat->method,"%s",buff3);
+
+                    early=strtok(NULL," \n\t");
+                    if (early != NULL && !strcasecmp(early,"EARLY"))
+                    {
+                        near=strtok(NULL," \n\t");
+                        dat->early_rej = (near != NULL) ? (uint32_t) atoi(near) : EARLY_NEAR;
+                        if (dat->early_rej == 0)
+                            dat->early_rej = EARLY_NEAR;
+                    }
+                    else if (early != NULL && !strcasecmp(early,"SPECULATIVE"))
+                    {
+                        near=strtok(NULL," \n\t");
+                        // 0 means one trial move per thread, see main.c
+                        dat->n_spec = (near != NULL) ? (uint32_t) atoi(near) : 0;
+                    }
+                    else if (early != NULL)
+                    {
+                        LOG_PRINT(LOG_WARNING,"%s %s %s is unknown. Should be EARLY or SPECULATIVE.\n",buff2,buff3,early);
+                    }
+                }
                 ///for spatial averaging extra parameters are required
                 ///see literature for more details
                 else if (!strcasecmp(buff3,"SPAV"))
@@ -99,28 +161,114 @@ void parse_from_file(char fname[], DATA *dat, SPDAT *spdat, ATOM **at)
 
                     sprintf(dat->method,"%s",buff3);
                 }
+                ///parallel tempering : PTMC NREP n TMAX t [EXCHANGE k], the lowest temperature being TEMP
+                else if (!strcasecmp(buff3,"PTMC"))
+                {
+                    char *key=NULL , *val=NULL;
+
+                    sprintf(dat->method,"%s",buff3);
+
+                    while ( (key=strtok(NULL," \n\t")) != NULL && (val=strtok(NULL," \n\t")) != NULL )
+                    {
+                        if (!strcasecmp(key,"NREP"))
+                            dat->pt_nrep = (uint32_t) atoi(val);
+                        else if (!strcasecmp(key,"TMAX"))
+                            dat->pt_tmax = atof(val);
+                        else if (!strcasecmp(key,"EXCHANGE"))
+                            dat->pt_exch = (uint32_t) atoi(val);
+                        else
+                        {
+                            LOG_PRINT(LOG_WARNING,"%s %s %s is unknown. Should be NREP, TMAX or EXCHANGE.\n",buff2,buff3,key);
+                        }
+                    }
+                }
                 else
                 {
-                    LOG_PRINT(LOG_WARNING,"%s %s is unknown. Should be METROP or SPAV.\n",buff2,buff3);
+                    LOG_PRINT(LOG_WARNING,"%s %s is unknown. Should be METROP, SPAV or PTMC.\n",buff2,buff3);
                 }
             }
             ///get type of potential we plan to use
             else if (!strcasecmp(buff2,"POTENTIAL"))
             {
-                ///available : hard coded LJ potential, hard coded Aziz potential, and user defined potential read from LUA script
-                if (strcasecmp(buff3,"LJ") && strcasecmp(buff3,"AZIZ") && strcasecmp(buff3,"PLUGIN"))
+                ///available : hard coded LJ potential, hard coded Aziz potential, user defined potential read from LUA script,
+                ///a tabulated version of one of those, and the Gupta or Sutton-Chen many-body potentials
+                if (strcasecmp(buff3,"LJ") && strcasecmp(buff3,"AZIZ") && strcasecmp(buff3,"PLUGIN") && strcasecmp(buff3,"TABLE")
+                        && strcasecmp(buff3,"GUPTA") && strcasecmp(buff3,"SC"))
                 {
-                    LOG_PRINT(LOG_WARNING,"%s %s is unknown. Should be LJ or AZIZ or PLUGIN.\n",buff2,buff3);
+                    LOG_PRINT(LOG_WARNING,"%s %s is unknown. Should be LJ or AZIZ or PLUGIN or TABLE or GUPTA or SC.\n",buff2,buff3);
                 }
                 else
                 {
                     ///the user of pointers to functions avoids the use of if(...) in energy functions so code is faster
                     if (!strcasecmp(buff3,"AZIZ"))
+                    {
                         get_ENER = &(get_AZIZ_V);
+                        get_DV = &(get_AZIZ_DV);
+                        get_ENER_ROW = &(get_AZIZ_V_row);
+                        get_CONSTR = NULL;
+                        get_ENER_DV = &(get_AZIZ_V_DV);
+                    }
                     else if (!strcasecmp(buff3,"LJ"))
                     {
                         get_ENER = &(get_LJ_V);
                         get_DV = &(get_LJ_DV);
+                        get_ENER_ROW = &(get_LJ_V_row);
+                        get_CONSTR = &(get_LJ_CONSTR);
+                        get_ENER_DV = &(get_LJ_V_DV);
+                    }
+                    /// many-body potentials for metals, parameters resolved from the atomic symbols or given with GUPTAPARAMS or SCPARAMS
+                    else if (!strcasecmp(buff3,"GUPTA") || !strcasecmp(buff3,"SC"))
+                    {
+                        get_ENER = &(get_MB_V);
+                        get_DV = &(get_MB_DV);
+                        get_ENER_ROW = NULL;
+                        get_CONSTR = NULL;
+                        get_ENER_DV = &(get_MB_V_DV);
+
+                        dat->mb_kind = (!strcasecmp(buff3,"GUPTA")) ? MB_GUPTA : MB_SC;
+                    }
+                    /**
+                     * the tabulated potential samples at startup one of the other potentials : TABLE LJ, TABLE AZIZ,
+                     * or TABLE PLUGIN file.lua energy_function gradient_function for the functions of a PAIR plugin
+                     * see the TABLE keyword for the grid
+                     */
+                    else if (!strcasecmp(buff3,"TABLE"))
+                    {
+                        char *src=strtok(NULL," \n\t");
+
+                        get_ENER = &(get_TAB_V);
+                        get_DV = &(get_TAB_DV);
+                        get_ENER_ROW = &(get_TAB_V_row);
+                        get_CONSTR = NULL;
+                        get_ENER_DV = &(get_TAB_V_DV);
+
+                        if (src != NULL && !strcasecmp(src,"LJ"))
+                        {
+                            dat->tab_src = TAB_LJ;
+                            get_CONSTR = &(get_LJ_CONSTR);
+                        }
+                        else if (src != NULL && !strcasecmp(src,"AZIZ"))
+                            dat->tab_src = TAB_AZIZ;
+#ifdef LUA_PLUGINS
+                        else if (src != NULL && !strcasecmp(src,"PLUGIN"))
+                        {
+                            char *file=NULL , *fv=NULL , *fdv=NULL;
+                            file=strtok(NULL," \n\t");
+                            fv=strtok(NULL," \n\t");
+                            fdv=strtok(NULL," \n\t");
+
+                            dat->tab_src = TAB_PLUGIN;
+                            lua_plugin_type = PAIR;
+                            init_lua(file);
+                            register_lua_function(fv,POTENTIAL);
+                            register_lua_function(fdv,GRADIENT);
+                        }
+#endif
+                        else
+                        {
+                            LOG_PRINT(LOG_ERROR,"%s %s %s : the potential to tabulate is unknown. Must be LJ or AZIZ or PLUGIN.\n",buff2,buff3,src);
+                            exit(-1);
+                        }
                     }
 #ifdef LUA_PLUGINS
                     /**
@@ -132,24 +280,32 @@ void parse_from_file(char fname[], DATA *dat, SPDAT *spdat, ATOM **at)
                      */
                     else if (!strcasecmp(buff3,"PLUGIN"))
                     {
-                        char *buff4=NULL , *buff5=NULL , *buff6=NULL , *buff7=NULL;
+                        char *buff4=NULL , *buff5=NULL , *buff6=NULL , *buff7=NULL , *buff8=NULL;
 //                         PLUGIN_TYPE plug_type;
                         buff4=strtok(NULL," \n\t");
                         buff5=strtok(NULL," \n\t");
                         buff6=strtok(NULL," \n\t");
                         buff7=strtok(NULL," \n\t");
+                        /// optional for FFI : a function returning the energy while filling the gradient
+                        buff8=strtok(NULL," \n\t");
                         
                         if (!strcasecmp(buff4,"PAIR"))
                         {
                             lua_plugin_type = PAIR;
                             get_ENER = &(get_lua_V);
                             get_DV = &(get_lua_DV);
+                            get_ENER_ROW = NULL;
+                            get_CONSTR = NULL;
+                            get_ENER_DV = NULL;
                         }
                         else if (!strcasecmp(buff4,"FFI"))
                         {
                             lua_plugin_type = FFI;
                             get_ENER = &(get_lua_V_ffi);
                             get_DV = &(get_lua_DV_ffi);
+                            get_ENER_ROW = NULL;
+                            get_CONSTR = NULL;
+                            get_ENER_DV = NULL;
                         }
                         else
                         {
@@ -161,6 +317,11 @@ void parse_from_file(char fname[], DATA *dat, SPDAT *spdat, ATOM **at)
                         init_lua(buff5);
                         register_lua_function(buff6,POTENTIAL);
                         register_lua_function(buff7,GRADIENT);
+                        if (lua_plugin_type == FFI && buff8 != NULL)
+                        {
+                            register_lua_function(buff8,ENERGY_GRADIENT);
+                            get_ENER_DV = &(get_lua_V_DV_ffi);
+                        }
                     }
 #endif
                 }
@@ -230,6 +391,176 @@ void parse_from_file(char fname[], DATA *dat, SPDAT *spdat, ATOM **at)
                 *at = malloc(dat->natom*sizeof(ATOM));
                 build_cluster(*at,dat,0,dat->natom,-1);	///< initialise the cluster with atoms at infinity initially
             }
+            /// cutoff of the L-J potential : CUTOFF rc [SHIFT|SWITCH [ron]] ; pairs are simply truncated if no mode is given
+            else if (!strcasecmp(buff2,"CUTOFF"))
+            {
+                char *mode=NULL , *ron=NULL;
+                dat->cutoff = atof(buff3);
+                dat->cut_mode = CUT_TRUNC;
+
+                if (dat->cutoff <= 0.0)
+                {
+                    LOG_PRINT(LOG_ERROR,"%s %s : the cutoff has to be strictly positive.\n",buff2,buff3);
+                    exit(-1);
+                }
+
+                mode=strtok(NULL," \n\t");
+                if (mode != NULL)
+                {
+                    if (!strcasecmp(mode,"SHIFT"))
+                        dat->cut_mode = CUT_SHIFT;
+                    else if (!strcasecmp(mode,"SWITCH"))
+                    {
+                        /// the switching starts by default at 90 % of the cutoff
+                        dat->cut_mode = CUT_SWITCH;
+                        ron=strtok(NULL," \n\t");
+                        dat->cuton = (ron != NULL) ? atof(ron) : 0.9*dat->cutoff;
+                        if (dat->cuton <= 0.0 || dat->cuton >= dat->cutoff)
+                        {
+                            LOG_PRINT(LOG_ERROR,"%s %s SWITCH %lf : the switching distance has to be between 0 and the cutoff.\n",buff2,buff3,dat->cuton);
+                            exit(-1);
+                        }
+                    }
+                    else
+                    {
+                        LOG_PRINT(LOG_WARNING,"%s %s %s : unknown mode, should be SHIFT or SWITCH. Pairs are truncated at the cutoff.\n",buff2,buff3,mode);
+                    }
+                }
+            }
+            /// Axilrod-Teller three-body term added to the potential : THREEBODY AXILROD [NU nu] [CUTOFF rc]
+            else if (!strcasecmp(buff2,"THREEBODY"))
+            {
+                char *key=NULL , *val=NULL;
+
+                if (strcasecmp(buff3,"AXILROD"))
+                {
+                    LOG_PRINT(LOG_ERROR,"%s %s is unknown. Should be AXILROD.\n",buff2,buff3);
+                    exit(-1);
+                }
+                dat->threebody = 1;
+
+                while ((key=strtok(NULL," \n\t")) != NULL)
+                {
+                    val=strtok(NULL," \n\t");
+                    if (val == NULL || (strcasecmp(key,"NU") && strcasecmp(key,"CUTOFF")))
+                    {
+                        LOG_PRINT(LOG_ERROR,"%s %s %s : should be NU value or CUTOFF value.\n",buff2,buff3,key);
+                        exit(-1);
+                    }
+                    if (!strcasecmp(key,"NU"))
+                        set_3B_nu(atof(val));
+                    else
+                        dat->tb_cutoff = atof(val);
+                }
+
+                if (dat->tb_cutoff < 0.0)
+                {
+                    LOG_PRINT(LOG_ERROR,"%s %s CUTOFF %lf : the cutoff has to be positive.\n",buff2,buff3,dat->tb_cutoff);
+                    exit(-1);
+                }
+            }
+            /// Verlet lists with the given skin distance, used together with CUTOFF : VERLET skin
+            else if (!strcasecmp(buff2,"VERLET"))
+            {
+                dat->skin = atof(buff3);
+
+                if (dat->skin <= 0.0)
+                {
+                    LOG_PRINT(LOG_ERROR,"%s %s : the skin distance has to be strictly positive.\n",buff2,buff3);
+                    exit(-1);
+                }
+            }
+            /// grid of the tabulated potential : TABLE [POINTS n] [RMIN r] [RMAX r], in any order
+            else if (!strcasecmp(buff2,"TABLE"))
+            {
+                char *name=buff3 , *val=NULL;
+
+                while (name != NULL)
+                {
+                    val=strtok(NULL," \n\t");
+                    if (val == NULL)
+                    {
+                        LOG_PRINT(LOG_ERROR,"%s %s : a value is missing.\n",buff2,name);
+                        exit(-1);
+                    }
+
+                    if (!strcasecmp(name,"POINTS"))
+                        dat->tab_points = (uint32_t) atoi(val);
+                    else if (!strcasecmp(name,"RMIN"))
+                        dat->tab_rmin = atof(val);
+                    else if (!strcasecmp(name,"RMAX"))
+                        dat->tab_rmax = atof(val);
+                    else
+                    {
+                        LOG_PRINT(LOG_WARNING,"%s %s is unknown. Should be POINTS or RMIN or RMAX.\n",buff2,name);
+                    }
+
+                    name=strtok(NULL," \n\t");
+                }
+            }
+            /// precision of the L-J energy kernels : PRECISION DOUBLE|MIXED
+            else if (!strcasecmp(buff2,"PRECISION"))
+            {
+                if (!strcasecmp(buff3,"DOUBLE"))
+                    dat->precision = PREC_DOUBLE;
+                else if (!strcasecmp(buff3,"MIXED"))
+                    dat->precision = PREC_MIXED;
+                else
+                {
+                    LOG_PRINT(LOG_WARNING,"%s %s is unknown. Should be DOUBLE or MIXED.\n",buff2,buff3);
+                }
+            }
+            /// order of the summation of the energies : REDUCTION DEFAULT|DETERMINISTIC
+            else if (!strcasecmp(buff2,"REDUCTION"))
+            {
+                if (!strcasecmp(buff3,"DEFAULT"))
+                    dat->det_sum = 0;
+                else if (!strcasecmp(buff3,"DETERMINISTIC"))
+                    dat->det_sum = 1;
+                else
+                {
+                    LOG_PRINT(LOG_WARNING,"%s %s is unknown. Should be DEFAULT or DETERMINISTIC.\n",buff2,buff3);
+                }
+            }
+            /// number of atoms moved together at each step : MOVE NATOMS k [RANDOM],
+            /// where RANDOM draws this number between 1 and k at each step
+            else if (!strcasecmp(buff2,"MOVE"))
+            {
+                char *k=NULL , *rnd=NULL;
+
+                if (!strcasecmp(buff3,"NATOMS"))
+                {
+                    k=strtok(NULL," \n\t");
+                    dat->n_move = (k != NULL) ? (uint32_t) atoi(k) : 1;
+                    if (dat->n_move == 0)
+                    {
+                        LOG_PRINT(LOG_WARNING,"%s %s should be followed by a positive number of atoms : 1 is used.\n",buff2,buff3);
+                        dat->n_move = 1;
+                    }
+
+                    rnd=strtok(NULL," \n\t");
+                    if (rnd != NULL && !strcasecmp(rnd,"RANDOM"))
+                        dat->n_move_rand = 1;
+                    else if (rnd != NULL)
+                    {
+                        LOG_PRINT(LOG_WARNING,"%s %s %s %s is unknown. Should be RANDOM.\n",buff2,buff3,k,rnd);
+                    }
+                }
+                else
+                {
+                    LOG_PRINT(LOG_WARNING,"%s %s is unknown. Should be NATOMS.\n",buff2,buff3);
+                }
+            }
+            /// number of independent Metropolis chains run together : WALKERS n
+            else if (!strcasecmp(buff2,"WALKERS"))
+            {
+                dat->n_walkers = (buff3 != NULL) ? (uint32_t) atoi(buff3) : 0;
+                if (dat->n_walkers == 0)
+                {
+                    LOG_PRINT(LOG_WARNING,"%s should be followed by a positive number of walkers : 1 is used.\n",buff2);
+                    dat->n_walkers = 1;
+                }
+            }
             /// define temperature
             else if (!strcasecmp(buff2,"TEMP"))
                 dat->T = atof(buff3);
@@ -275,6 +606,27 @@ void parse_from_file(char fname[], DATA *dat, SPDAT *spdat, ATOM **at)
 
                 lj_size++;
             }
+            /// parameters of a species for the many-body potentials, in eV and angstroems :
+            /// GUPTAPARAMS sym A a XI xi P p Q q R0 r0 or SCPARAMS sym EPSILON eps C c A a N n M m
+            else if (!strcasecmp(buff2,"GUPTAPARAMS") || !strcasecmp(buff2,"SCPARAMS"))
+            {
+                char *val=NULL;
+                double par[5];
+
+                for (uint32_t l=0; l<5; l++)
+                {
+                    val=strtok(NULL," \n\t");
+                    val=strtok(NULL," \n\t");
+                    if (val == NULL)
+                    {
+                        LOG_PRINT(LOG_ERROR,"%s %s : 5 parameters are required.\n",buff2,buff3);
+                        exit(-1);
+                    }
+                    par[l]=atof(val);
+                }
+
+                set_MB_params((!strcasecmp(buff2,"GUPTAPARAMS")) ? MB_GUPTA : MB_SC,buff3,par);
+            }
             /// for building atom list manually
             else if (!strcasecmp(buff2,"ATOM"))
             {
@@ -298,18 +650,29 @@ void parse_from_file(char fname[], DATA *dat, SPDAT *spdat, ATOM **at)
 
                 LOG_PRINT(LOG_INFO,"Building an atomic list from index %d to %d and of type  %s.\n",j,k-1,type);
                 
+                /// find the species index of this type, i.e. its position in the LJPARAMS list
+                for(l=0; l<lj_size; l++)
+                {
+                    if (!strcasecmp(ljpars[l].sym,type))
+                        break;
+                }
+                /// unknown symbol (for example with AZIZ) : register it as a new species with unit parameters
+                if (l==lj_size)
+                {
+                    LOG_PRINT(LOG_WARNING,"No LJPARAMS found for atom type %s : using EPSILON 1.0 and SIGMA 1.0.\n",type);
+                    ljpars=(LJPARAMS*)realloc(ljpars,(lj_size+1)*sizeof(LJPARAMS));
+                    sprintf(ljpars[lj_size].sym,"%s",type);
+                    ljpars[lj_size].eps=1.0;
+                    ljpars[lj_size].sig=1.0;
+                    lj_size++;
+                }
+
                 for(i=j; i<k; i++)
                 {
                     sprintf((*at)[i].sym,"%s",type);
-                    for(l=0; l<lj_size; l++)
-                    {
-                        if (!strcasecmp(ljpars[l].sym,(*at)[i].sym))
-                        {
-                            (*at)[i].ljp.eps=ljpars[l].eps;
-                            (*at)[i].ljp.sig=ljpars[l].sig;
-                            break;
-                        }
-                    }
+                    (*at)[i].type=l;
+                    (*at)[i].ljp.eps=ljpars[l].eps;
+                    (*at)[i].ljp.sig=ljpars[l].sig;
                 }
                 ///randomly distribute atoms
                 if(!strcasecmp(coor,"RANDOM"))
@@ -352,5 +715,23 @@ void parse_from_file(char fname[], DATA *dat, SPDAT *spdat, ATOM **at)
     }
 
     fclose(ifile);
-    free(ljpars);
+
+    /// the list of species is kept for the whole simulation, and used for precomputing the LJ coefficients of each pair of species
+    dat->ntypes = lj_size;
+    dat->ljp = ljpars;
+    build_LJ_table(dat);
+
+    /// the Aziz species of the atomic symbols are resolved once for all
+    dat->aziz_sp = NULL;
+    dat->aziz = NULL;
+    if (get_ENER == &(get_AZIZ_V) || dat->tab_src == TAB_AZIZ)
+        build_AZIZ_table(dat);
+
+    /// same for the many-body potentials, whose parameters are mixed for each pair of species
+    if (dat->mb_kind != MB_NONE)
+        build_MB_table(dat);
+
+    /// and for the three-body term, whose built-in constants depend on the Aziz species
+    if (dat->threebody)
+        build_3B_table(dat);
 }
@@ -23,6 +23,7 @@
 #include "lauxlib.h"
 
 #include "global.h"
+#include "coords.h"
 #include "plugins_lua.h"
 #include "logger.h"
 
@@ -34,6 +35,9 @@ static char lua_file[FILENAME_MAX];
 
 static char lua_function[LUA_MAX_FUNCTIONS_NUMBER][LUA_FUNCTIONS_NAMELEN];
 
+// ATOM view of the coordinates store, sent to the FFI plugins
+static ATOM *ffi_at = NULL;
+
 void init_lua(char *plugin_file_name)
 {
     int32_t err=0;
@@ -58,7 +62,7 @@ void init_lua(char *plugin_file_name)
 
 }
 
-// type is 0 for energy, 1 for gradient
+// type is 0 for energy, 1 for gradient, 2 for energy and gradient together
 void register_lua_function(char *plugin_function_name, LUA_FUNCTION_TYPE type)
 {
     LOG_PRINT(LOG_INFO,"Registering Lua function : %s \n",plugin_function_name);
@@ -67,6 +71,8 @@ void register_lua_function(char *plugin_function_name, LUA_FUNCTION_TYPE type)
         strcpy(lua_function[POTENTIAL],plugin_function_name);
     else if(type == GRADIENT)
         strcpy(lua_function[GRADIENT],plugin_function_name);
+    else if(type == ENERGY_GRADIENT)
+        strcpy(lua_function[ENERGY_GRADIENT],plugin_function_name);
     else
     {
         LOG_PRINT(LOG_ERROR,"Unknown type %d for register_lua_function.\n",type);
@@ -81,15 +87,40 @@ void end_lua()
         /* cleanup Lua */
         lua_close(L);
     }
+    free(ffi_at);
+    ffi_at = NULL;
+}
+
+/*
+ * The FFI plugins work on an array of ATOM : this updates (and allocates at first call)
+ * the ATOM view of a coordinates store
+ */
+static ATOM* get_ffi_view(const COORDS *crd, const DATA *dat)
+{
+    if (ffi_at == NULL)
+    {
+        ffi_at = malloc(crd->natom*sizeof *ffi_at);
+        for (uint32_t i=0; i<crd->natom; i++)
+        {
+            ffi_at[i].type = crd->type[i];
+            ffi_at[i].ljp  = dat->ljp[crd->type[i]];
+            memcpy(ffi_at[i].sym,dat->ljp[crd->type[i]].sym,4*sizeof(char));
+        }
+    }
+
+    coords_to_atoms(crd,ffi_at);
+
+    return ffi_at;
 }
 
 /*
  * This interface calls a lua script evaluating a Lennard Jobes like potential, pair by pair
  * see plugins/lj_n_m.lua
  */
-double get_lua_V(ATOM at[], DATA *dat, int32_t candidate)
+ENERGY get_lua_V(const COORDS *crd, const DATA *dat, int32_t candidate)
 {
     uint32_t i,j;
+    LJPARAMS *pi, *pj;
     double dx1,dy1,dz1;
     double dx2,dy2,dz2;
 
@@ -97,17 +128,17 @@ double get_lua_V(ATOM at[], DATA *dat, int32_t candidate)
 
     if (candidate==-1)
     {
-        for (i=0; i<(dat->natom); i++)
+        for (i=0; i<(crd->natom); i++)
         {
-            dx1=at[i].x;
-            dy1=at[i].y;
-            dz1=at[i].z;
+            dx1=crd->x[i];
+            dy1=crd->y[i];
+            dz1=crd->z[i];
 
-            for (j=i+1; j<(dat->natom); j++)
+            for (j=i+1; j<(crd->natom); j++)
             {
-                dx2=at[j].x;
-                dy2=at[j].y;
-                dz2=at[j].z;
+                dx2=crd->x[j];
+                dy2=crd->y[j];
+                dz2=crd->z[j];
 
 //                 LOG_PRINT(LOG_DEBUG,"From get_lua_V full : [i,j] = %d,%d\n",i,j);
 
@@ -127,11 +158,14 @@ double get_lua_V(ATOM at[], DATA *dat, int32_t candidate)
                 lua_pushnumber(L, dy2);
                 lua_pushnumber(L, dz2);
 
-                lua_pushnumber(L, at[i].ljp.eps);
-                lua_pushnumber(L, at[j].ljp.eps);
+                pi = &dat->ljp[crd->type[i]];
+                pj = &dat->ljp[crd->type[j]];
 
-                lua_pushnumber(L, at[i].ljp.sig);
-                lua_pushnumber(L, at[j].ljp.sig);
+                lua_pushnumber(L, pi->eps);
+                lua_pushnumber(L, pj->eps);
+
+                lua_pushnumber(L, pi->sig);
+                lua_pushnumber(L, pj->sig);
 
                 /* call the function with 10 arguments, return 1 result */
                 lua_call(L, 10, 1);
@@ -146,17 +180,17 @@ double get_lua_V(ATOM at[], DATA *dat, int32_t candidate)
     {
         i = (uint32_t) candidate;
 
-        dx1=at[i].x;
-        dy1=at[i].y;
-        dz1=at[i].z;
+        dx1=crd->x[i];
+        dy1=crd->y[i];
+        dz1=crd->z[i];
 
-        for (j=0; j<(dat->natom); j++)
+        for (j=0; j<(crd->natom); j++)
         {
             if (j!=i)
             {
-                dx2=at[j].x;
-                dy2=at[j].y;
-                dz2=at[j].z;
+                dx2=crd->x[j];
+                dy2=crd->y[j];
+                dz2=crd->z[j];
 
 //                 LOG_PRINT(LOG_DEBUG,"From get_lua_V candidate : [i,j] = %d,%d\n",i,j);
 
@@ -175,11 +209,14 @@ double get_lua_V(ATOM at[], DATA *dat, int32_t candidate)
                 lua_pushnumber(L, dy2);
                 lua_pushnumber(L, dz2);
 
-                lua_pushnumber(L, at[i].ljp.eps);
-                lua_pushnumber(L, at[j].ljp.eps);
+                pi = &dat->ljp[crd->type[i]];
+                pj = &dat->ljp[crd->type[j]];
+
+                lua_pushnumber(L, pi->eps);
+                lua_pushnumber(L, pj->eps);
 
-                lua_pushnumber(L, at[i].ljp.sig);
-                lua_pushnumber(L, at[j].ljp.sig);
+                lua_pushnumber(L, pi->sig);
+                lua_pushnumber(L, pj->sig);
 
                 /* call the function with 10 arguments, return 1 result */
                 lua_call(L,10,1);
@@ -193,32 +230,34 @@ double get_lua_V(ATOM at[], DATA *dat, int32_t candidate)
 
     LOG_PRINT(LOG_DEBUG,"LUA pair potential : %lf\n",energy);
 
-    return energy;
+    // the plugins have no constraint
+    return (ENERGY){energy, 0.0};
 }
 
-void get_lua_DV(ATOM at[], DATA *dat, double fx[], double fy[], double fz[])
+void get_lua_DV(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[])
 {
     uint32_t i=0 , j=0 ;
+    LJPARAMS *pi, *pj;
     double dx1,dy1,dz1;
     double dx2,dy2,dz2;
     
-    for (i=0 ; i < dat->natom ; i++ )
+    for (i=0 ; i < crd->natom ; i++ )
     {
         fx[i] = 0.0 ;
         fy[i] = 0.0 ;
         fz[i] = 0.0 ;
         
-        dx1=at[i].x;
-        dy1=at[i].y;
-        dz1=at[i].z;
+        dx1=crd->x[i];
+        dy1=crd->y[i];
+        dz1=crd->z[i];
         
-        for (j=0 ; j < dat->natom ; j++ )
+        for (j=0 ; j < crd->natom ; j++ )
         {
             if (i==j) continue ;
             
-            dx2=at[j].x;
-            dy2=at[j].y;
-            dz2=at[j].z;
+            dx2=crd->x[j];
+            dy2=crd->y[j];
+            dz2=crd->z[j];
             
             lua_getglobal(L, lua_function[GRADIENT]);
 
@@ -230,11 +269,14 @@ void get_lua_DV(ATOM at[], DATA *dat, double fx[], double fy[], double fz[])
             lua_pushnumber(L, dy2);
             lua_pushnumber(L, dz2);
 
-            lua_pushnumber(L, at[i].ljp.eps);
-            lua_pushnumber(L, at[j].ljp.eps);
+            pi = &dat->ljp[crd->type[i]];
+            pj = &dat->ljp[crd->type[j]];
 
-            lua_pushnumber(L, at[i].ljp.sig);
-            lua_pushnumber(L, at[j].ljp.sig);
+            lua_pushnumber(L, pi->eps);
+            lua_pushnumber(L, pj->eps);
+
+            lua_pushnumber(L, pi->sig);
+            lua_pushnumber(L, pj->sig);
 
             /* call the function with 10 arguments, return 3 results */
             lua_call(L,10,3);
@@ -249,6 +291,51 @@ void get_lua_DV(ATOM at[], DATA *dat, double fx[], double fy[], double fz[])
     LOG_PRINT(LOG_DEBUG,"LUA pair gradient done.\n");
 }
 
+/*
+ * Evaluates the PAIR functions for two atoms of species pi and pj at a distance r, the first one being
+ * at (r,0,0) and the second at the origin, so that the x component of the gradient is dV/dr, stored in dv.
+ * Used for sampling the plugin once at startup, see table.c
+ */
+double get_lua_pair_dv(double r, LJPARAMS *pi, LJPARAMS *pj, double *dv)
+{
+    double energy=0.0;
+    LUA_FUNCTION_TYPE f;
+
+    for (f=POTENTIAL; f<=GRADIENT; f++)
+    {
+        lua_getglobal(L, lua_function[f]);
+
+        lua_pushnumber(L, r);
+        lua_pushnumber(L, 0.0);
+        lua_pushnumber(L, 0.0);
+
+        lua_pushnumber(L, 0.0);
+        lua_pushnumber(L, 0.0);
+        lua_pushnumber(L, 0.0);
+
+        lua_pushnumber(L, pi->eps);
+        lua_pushnumber(L, pj->eps);
+
+        lua_pushnumber(L, pi->sig);
+        lua_pushnumber(L, pj->sig);
+
+        if (f == POTENTIAL)
+        {
+            lua_call(L,10,1);
+            energy = (double)lua_tonumber(L, -1);
+            lua_pop(L,1);
+        }
+        else
+        {
+            lua_call(L,10,3);
+            *dv = (double)lua_tonumber(L, -1);
+            lua_pop(L,3);
+        }
+    }
+
+    return energy;
+}
+
 /*
  * This interface calls a lua script evaluating a Lennard Jobes like potential
  * This version directly sends the ATOM structure, the Lua side requires LUAJIT/FFI
@@ -256,9 +343,10 @@ void get_lua_DV(ATOM at[], DATA *dat, double fx[], double fy[], double fz[])
  * 
  * This is the recommended way of calling lua script
  */
-double get_lua_V_ffi(ATOM at[], DATA *dat, int32_t candidate)
+ENERGY get_lua_V_ffi(const COORDS *crd, const DATA *dat, int32_t candidate)
 {
     double energy=0.0;
+    ATOM *at = get_ffi_view(crd,dat);
 
     lua_getglobal(L, lua_function[POTENTIAL]);
 
@@ -273,14 +361,16 @@ double get_lua_V_ffi(ATOM at[], DATA *dat, int32_t candidate)
 
     LOG_PRINT(LOG_DEBUG,"LUA FFI potential : %lf\n",energy);
 
-    return energy;
+    return (ENERGY){energy, 0.0};
 }
 
 /*
  * This is the recommended way of calling lua script 
  */
-void get_lua_DV_ffi(ATOM at[], DATA *dat, double fx[], double fy[], double fz[])
+void get_lua_DV_ffi(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[])
 {
+    ATOM *at = get_ffi_view(crd,dat);
+
     lua_getglobal(L, lua_function[GRADIENT]);
     
 //     function lj_dv_n_m_ffi(natom, at_list, fx, fy, fz)
@@ -295,4 +385,32 @@ void get_lua_DV_ffi(ATOM at[], DATA *dat, double fx[], double fy[], double fz[])
     LOG_PRINT(LOG_DEBUG,"LUA FFI gradient done.\n");
 }
 
+/*
+ * Optional FFI entry point returning the energy of the whole system while filling the gradient,
+ * so that the minimiser only calls the script once per step
+ */
+ENERGY get_lua_V_DV_ffi(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[])
+{
+    double energy=0.0;
+    ATOM *at = get_ffi_view(crd,dat);
+
+    lua_getglobal(L, lua_function[ENERGY_GRADIENT]);
+
+//     function lj_vdv_n_m_ffi(natom, at_list, fx, fy, fz)
+    lua_pushinteger(L, dat->natom);
+    lua_pushlightuserdata(L, (void*) at);
+    lua_pushlightuserdata(L, (void*) fx);
+    lua_pushlightuserdata(L, (void*) fy);
+    lua_pushlightuserdata(L, (void*) fz);
+
+    lua_call(L,5,1);
+
+    energy = (double)lua_tonumber(L, -1);
+    lua_pop(L, 1);
+
+    LOG_PRINT(LOG_DEBUG,"LUA FFI potential and gradient : %lf\n",energy);
+
+    return (ENERGY){energy, 0.0};
+}
+
 #endif //LUA_PLUGINS
@@ -49,6 +49,40 @@ double get_next(DATA *dat)
     return dat->rn[dat->nrn-1] ;
 }
 
+/**
+ * @brief Gives dst, a copy of the common data src (e.g. for a replica), its own random numbers : a buffer, and a dSFMT
+ *          state initialised from numbers drawn from src, so that all the streams derive from the seed of the simulation.
+ *          With STDRAND all the streams share the generator of the C library.
+ *
+ * @param dst The copy of the common data, whose buffer is allocated
+ * @param src Common data whose generator is used for seeding the one of dst
+ */
+void init_rand_stream(DATA *dst, DATA *src)
+{
+    dst->nrn = 2048;
+    dst->rn = calloc(dst->nrn,sizeof *dst->rn);
+
+#ifndef STDRAND
+    uint32_t i;
+    uint32_t key[RAND_STREAM_KEY];
+
+    for (i=0; i<RAND_STREAM_KEY; i++)
+        key[i] = (uint32_t) (4294967296.0*get_next(src));
+
+    dsfmt_init_by_array(&dst->dsfmt,key,RAND_STREAM_KEY);
+    // the seeds belong to src
+    dst->seeds = NULL;
+#else
+    (void) src;
+#endif
+}
+
+void free_rand_stream(DATA *dat)
+{
+    free(dat->rn);
+    dat->rn = NULL;
+}
+
 /**
  * @brief Returns a double precision number normally distributed around 0,
  *  following a standard deviation taken from spdat->weps
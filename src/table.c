@@ -0,0 +1,495 @@
+/**
+ * \file table.c
+ *
+ * \brief Tabulated pair potential : the L-J, Aziz or a Lua PAIR plugin potential is sampled once at startup
+ *          for each pair of species, and then evaluated from cubic splines
+ *
+ * \details The tables are built on a grid regular in r^2, so that neither the energy nor the gradient needs a
+ *          square root. On each interval the energy is the cubic Hermite polynomial matching the sampled energy
+ *          and derivative at both ends. Below the first point the first interval is extrapolated linearly,
+ *          pairs further apart than the last point are ignored.
+ *
+ * \authors Florent Hedin (University of Basel, Switzerland) \n
+ *          Markus Meuwly (University of Basel, Switzerland)
+ *
+ * \copyright Copyright (c) 2011-2015, Florent Hedin, Markus Meuwly, and the University of Basel. \n
+ *            All rights reserved. \n
+ *            The 3-clause BSD license is applied to this software. \n
+ *            See LICENSE.txt
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "global.h"
+#include "ener.h"
+#include "table.h"
+#include "logger.h"
+#include "plugins_lua.h"
+
+/// ntypes*ntypes tables of npt intervals, 4 polynomial coefficients per interval
+static double *tab = NULL;
+static uint32_t npt = 0;
+static uint32_t nt = 0;
+
+/// grid in r^2 : first and last point and inverse of the step
+static double smin = 0.0, smax = 0.0, ids = 0.0;
+
+/// for each pair of species : largest interpolation error, where it occurs, and energy at the last point
+static double *tab_err = NULL, *tab_err_r = NULL, *tab_tail = NULL;
+
+/*
+ * The sampled potentials : energy of the pair of species (ti,tj) at a distance r, dV/dr being stored in dv
+ */
+static double sample_LJ(DATA *dat, uint32_t ti, uint32_t tj, double r, double *dv)
+{
+    const double c12 = dat->lj_c12[ti*dat->ntypes+tj];
+    const double c6  = dat->lj_c6[ti*dat->ntypes+tj];
+    const double r6 = 1.0/(X6(r));
+
+    *dv = (-12.0*c12*r6 + 6.0*c6)*r6/r;
+
+    return (c12*r6 - c6)*r6;
+}
+
+static double sample_AZIZ(DATA *dat, uint32_t ti, uint32_t tj, double r, double *dv)
+{
+    const double conv = CM1TOKJM*JTOCAL;
+    const double e = aziz_pair_dv(dat->aziz_sp[ti],dat->aziz_sp[tj],r,dv);
+
+    *dv *= conv;
+
+    return e*conv;
+}
+
+#ifdef LUA_PLUGINS
+static double sample_PLUGIN(DATA *dat, uint32_t ti, uint32_t tj, double r, double *dv)
+{
+    return get_lua_pair_dv(r,&dat->ljp[ti],&dat->ljp[tj],dv);
+}
+#endif
+
+/*
+ * Energy of the pair at the squared distance s, from the table c of its pair of species
+ */
+static inline double tab_V(const double *restrict c, const double s)
+{
+    double u, t;
+    uint32_t k;
+
+    if (s >= smax)
+        return 0.0;
+
+    u = (s-smin)*ids;
+    if (u < 0.0)
+        return c[0] + u*c[1];
+
+    k = (uint32_t) u;
+    if (k >= npt)
+        k = npt-1;
+    t = u - (double) k;
+    c += 4*k;
+
+    return c[0] + t*(c[1] + t*(c[2] + t*c[3]));
+}
+
+/*
+ * Same as tab_V, also storing (dV/dr)/r = 2 dV/ds in de so that the gradient on atom i is de*(xi-xj)
+ */
+static inline double tab_V_DV(const double *restrict c, const double s, double *de)
+{
+    double u, t;
+    uint32_t k;
+
+    if (s >= smax)
+    {
+        *de = 0.0;
+        return 0.0;
+    }
+
+    u = (s-smin)*ids;
+    if (u < 0.0)
+    {
+        *de = 2.0*ids*c[1];
+        return c[0] + u*c[1];
+    }
+
+    k = (uint32_t) u;
+    if (k >= npt)
+        k = npt-1;
+    t = u - (double) k;
+    c += 4*k;
+
+    *de = 2.0*ids*(c[1] + t*(2.0*c[2] + 3.0*t*c[3]));
+
+    return c[0] + t*(c[1] + t*(c[2] + t*c[3]));
+}
+
+/**
+ * @brief Samples the pair potential selected by dat->tab_src for each pair of species, builds the splines
+ *          and measures their interpolation error at the middle of each interval.
+ *          The grid is given by dat->tab_points, dat->tab_rmin and dat->tab_rmax, a default being used for the unset ones.
+ *
+ * @param dat Common data, with the species and their L-J parameters already known
+ */
+void alloc_pair_table(DATA *dat)
+{
+    uint32_t ti, tj, k, t;
+    double s, r, h, e0, e1, m0, m1, dv, err, sigmin, sigmax;
+    double *c;
+    double (*sample)(DATA*, uint32_t, uint32_t, double, double*) = NULL;
+
+    nt = dat->ntypes;
+
+    sigmin = sigmax = dat->ljp[0].sig;
+    for (t=1; t<nt; t++)
+    {
+        sigmin = fmin(sigmin,dat->ljp[t].sig);
+        sigmax = fmax(sigmax,dat->ljp[t].sig);
+    }
+
+    // the hard coded Aziz potentials are in angstroems, the L-J like ones scale with sigma
+    switch (dat->tab_src)
+    {
+    case TAB_LJ:
+        sample = &sample_LJ;
+        break;
+    case TAB_AZIZ:
+        sample = &sample_AZIZ;
+        sigmin = sigmax = 2.5;
+        break;
+#ifdef LUA_PLUGINS
+    case TAB_PLUGIN:
+        sample = &sample_PLUGIN;
+        break;
+#endif
+    default:
+        LOG_PRINT(LOG_ERROR,"No pair potential to tabulate.\n");
+        exit(-1);
+    }
+
+    if (dat->tab_points == 0)
+        dat->tab_points = TABLE_POINTS;
+    if (dat->tab_rmin <= 0.0)
+        dat->tab_rmin = 0.6*sigmin;
+    if (dat->tab_rmax <= 0.0)
+        dat->tab_rmax = 6.0*sigmax;
+
+    if (dat->tab_points < 2 || dat->tab_rmax <= dat->tab_rmin)
+    {
+        LOG_PRINT(LOG_ERROR,"Bad TABLE parameters : %u points from %lf to %lf.\n",dat->tab_points,dat->tab_rmin,dat->tab_rmax);
+        exit(-1);
+    }
+
+    npt  = dat->tab_points;
+    smin = X2(dat->tab_rmin);
+    smax = X2(dat->tab_rmax);
+    h    = (smax-smin)/npt;
+    ids  = 1.0/h;
+
+    tab = malloc((size_t)nt*nt*npt*4*sizeof *tab);
+    tab_err   = malloc(nt*nt*sizeof *tab_err);
+    tab_err_r = malloc(nt*nt*sizeof *tab_err_r);
+    tab_tail  = malloc(nt*nt*sizeof *tab_tail);
+
+    for (ti=0; ti<nt; ti++)
+    {
+        for (tj=0; tj<nt; tj++)
+        {
+            c = tab + (size_t)(ti*nt+tj)*npt*4;
+
+            // energy and dV/ds at each point, dV/ds = (dV/dr)/(2r)
+            r = sqrt(smin);
+            e0 = (*sample)(dat,ti,tj,r,&dv);
+            m0 = 0.5*dv/r;
+
+            for (k=0; k<npt; k++)
+            {
+                r = sqrt(smin + (k+1)*h);
+                e1 = (*sample)(dat,ti,tj,r,&dv);
+                m1 = 0.5*dv/r;
+
+                c[4*k]   = e0;
+                c[4*k+1] = h*m0;
+                c[4*k+2] = 3.0*(e1-e0) - h*(2.0*m0+m1);
+                c[4*k+3] = 2.0*(e0-e1) + h*(m0+m1);
+
+                e0 = e1;
+                m0 = m1;
+            }
+
+            tab_tail[ti*nt+tj] = e0;
+            tab_err[ti*nt+tj] = 0.0;
+            tab_err_r[ti*nt+tj] = dat->tab_rmin;
+
+            for (k=0; k<npt; k++)
+            {
+                s = smin + (k+0.5)*h;
+                r = sqrt(s);
+                err = fabs(tab_V(c,s) - (*sample)(dat,ti,tj,r,&dv));
+                if (err > tab_err[ti*nt+tj])
+                {
+                    tab_err[ti*nt+tj] = err;
+                    tab_err_r[ti*nt+tj] = r;
+                }
+            }
+        }
+    }
+}
+
+void free_pair_table()
+{
+    free(tab);
+    free(tab_err);
+    free(tab_err_r);
+    free(tab_tail);
+    tab = tab_err = tab_err_r = tab_tail = NULL;
+}
+
+/**
+ * @brief Prints to stdout the resolution of the tables, and for each pair of species the largest
+ *          interpolation error and the energy at the last point, i.e. the error due to truncating the potential there
+ */
+void print_pair_table(DATA *dat)
+{
+    uint32_t ti, tj;
+
+    fprintf(stdout,"Tables of %u points from r = %lf to %lf (step in r^2 of %g, i.e. in r from %g to %g)\n",
+            npt,dat->tab_rmin,dat->tab_rmax,1.0/ids,0.5/(ids*dat->tab_rmin),0.5/(ids*dat->tab_rmax));
+
+    for (ti=0; ti<nt; ti++)
+    {
+        for (tj=ti; tj<nt; tj++)
+        {
+            fprintf(stdout,"\t%s-%s : max interpolation error %g at r = %lf ; energy at the last point %g\n",
+                    dat->ljp[ti].sym,dat->ljp[tj].sym,tab_err[ti*nt+tj],tab_err_r[ti*nt+tj],tab_tail[ti*nt+tj]);
+        }
+    }
+}
+
+/*
+ * Tabulated energy of atom i with the atoms [from,to[ as a PAIR_RANGE
+ */
+static double TAB_V_range(const COORDS *crd, const DATA *dat, uint32_t i, uint32_t from, uint32_t to, double out[])
+{
+    uint32_t j;
+    double e, energy = 0.0;
+    const double *restrict x = crd->x;
+    const double *restrict y = crd->y;
+    const double *restrict z = crd->z;
+    const uint32_t *restrict type = crd->type;
+    const size_t stride = (size_t)npt*4;
+    const double *ci = tab + type[i]*nt*stride;
+
+    (void) dat;
+
+    for (j=from; j<to; j++)
+    {
+        e = tab_V(ci+type[j]*stride, X2(x[i]-x[j]) + X2(y[i]-y[j]) + X2(z[i]-z[j]));
+        if (out != NULL)
+            out[j] = e;
+        energy += e;
+    }
+
+    return energy;
+}
+
+#ifdef _OPENMP
+/*
+ * Full loop gradient : each atom sums the forces of all the others on itself only, so that the rows are
+ * independent and can be distributed over threads (see AZIZ_DV_full in ener.c). Returns the pair energy.
+ */
+static double TAB_V_DV_full(const COORDS *crd, double fx[], double fy[], double fz[])
+{
+    double energy = 0.0;
+    const int64_t natom = (int64_t) crd->natom;
+    const double *restrict x = crd->x;
+    const double *restrict y = crd->y;
+    const double *restrict z = crd->z;
+    const uint32_t *restrict type = crd->type;
+    const size_t stride = (size_t)npt*4;
+    int64_t i;
+
+    #pragma omp parallel for schedule(static) reduction(+:energy)
+    for (i=0; i<natom; i++)
+    {
+        double de, dx, dy, dz;
+        double gx=0.0, gy=0.0, gz=0.0;
+        const double *ci = tab + type[i]*nt*stride;
+
+        for (int64_t j=0; j<natom; j++)
+        {
+            if (j==i)
+                continue;
+
+            dx = x[i]-x[j];
+            dy = y[i]-y[j];
+            dz = z[i]-z[j];
+            energy += 0.5*tab_V_DV(ci+type[j]*stride, dx*dx + dy*dy + dz*dz, &de);
+            gx += de*dx; gy += de*dy; gz += de*dz;
+        }
+
+        fx[i] = gx;
+        fy[i] = gy;
+        fz[i] = gz;
+    }
+
+    return energy;
+}
+#endif
+
+/**
+ * @brief Energy from the tabulated potential, for the whole system (candidate=-1) or for a candidate atom only
+ */
+ENERGY get_TAB_V(const COORDS *crd, const DATA *dat, int32_t candidate)
+{
+    uint32_t i, j;
+    ENERGY e = {0.0, 0.0};
+    const uint32_t natom = crd->natom;
+    const double *restrict x = crd->x;
+    const double *restrict y = crd->y;
+    const double *restrict z = crd->z;
+    const uint32_t *restrict type = crd->type;
+    const size_t stride = (size_t)npt*4;
+    const double *ci;
+
+    e.constr = (get_CONSTR != NULL) ? (*get_CONSTR)(crd,dat,candidate) : 0.0;
+
+    if (dat->det_sum)
+    {
+        e.pair = (candidate==-1) ? get_V_full_det(crd,dat,TAB_V_range) : get_V_cand_det(crd,dat,(uint32_t)candidate,NULL,TAB_V_range);
+        return e;
+    }
+
+#ifdef _OPENMP
+    if (candidate==-1 && OMP_FULL(crd))
+    {
+        e.pair = get_V_full_omp(crd,dat,TAB_V_range);
+        return e;
+    }
+    else if (candidate!=-1 && OMP_CAND)
+    {
+        e.pair = get_V_cand_omp(crd,dat,(uint32_t)candidate,NULL,TAB_V_range);
+        return e;
+    }
+#endif
+
+    if (candidate==-1)
+    {
+        for (i=0; i<natom; i++)
+        {
+            ci = tab + type[i]*nt*stride;
+            for (j=i+1; j<natom; j++)
+                e.pair += tab_V(ci+type[j]*stride, X2(x[i]-x[j]) + X2(y[i]-y[j]) + X2(z[i]-z[j]));
+        }
+    }
+    else
+    {
+        i = (uint32_t) candidate;
+        ci = tab + type[i]*nt*stride;
+        for (j=0; j<natom; j++)
+        {
+            if (j!=i)
+                e.pair += tab_V(ci+type[j]*stride, X2(x[i]-x[j]) + X2(y[i]-y[j]) + X2(z[i]-z[j]));
+        }
+    }
+
+    return e;
+}
+
+/**
+ * @brief Same as get_TAB_V(crd,dat,candidate) but each pair energy of the candidate is also stored
+ *          in row[j] (row[candidate] is set to 0). Used for the per atom energy cache.
+ */
+double get_TAB_V_row(const COORDS *crd, const DATA *dat, uint32_t candidate, double row[])
+{
+    uint32_t j;
+    double energy = 0.0;
+    const uint32_t i = candidate;
+    const double *restrict x = crd->x;
+    const double *restrict y = crd->y;
+    const double *restrict z = crd->z;
+    const uint32_t *restrict type = crd->type;
+    const size_t stride = (size_t)npt*4;
+    const double *ci = tab + type[i]*nt*stride;
+
+    if (dat->det_sum)
+        return get_V_cand_det(crd,dat,candidate,row,TAB_V_range);
+
+#ifdef _OPENMP
+    if (OMP_CAND)
+        return get_V_cand_omp(crd,dat,candidate,row,TAB_V_range);
+#endif
+
+    for (j=0; j<crd->natom; j++)
+    {
+        row[j] = (j!=i) ? tab_V(ci+type[j]*stride, X2(x[i]-x[j]) + X2(y[i]-y[j]) + X2(z[i]-z[j])) : 0.0;
+        energy += row[j];
+    }
+
+    return energy;
+}
+
+/**
+ * @brief Total energy from the tabulated potential (as get_TAB_V(crd,dat,-1)) and its gradient evaluated in the same sweep over the pairs.
+ *          When compiled with OpenMP, systems of at least LJ_DV_OMP_MIN atoms use the parallel full loop.
+ */
+ENERGY get_TAB_V_DV(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[])
+{
+    uint32_t i, j;
+    double de, dx, dy, dz;
+    ENERGY e = {0.0, 0.0};
+    const uint32_t natom = crd->natom;
+    const double *restrict x = crd->x;
+    const double *restrict y = crd->y;
+    const double *restrict z = crd->z;
+    const uint32_t *restrict type = crd->type;
+    const size_t stride = (size_t)npt*4;
+    const double *ci;
+
+    e.constr = (get_CONSTR != NULL) ? (*get_CONSTR)(crd,dat,-1) : 0.0;
+
+#ifdef _OPENMP
+    if (!dat->det_sum && OMP_FULL(crd))
+    {
+        e.pair = TAB_V_DV_full(crd,fx,fy,fz);
+        return e;
+    }
+#endif
+
+    memset(fx,0,natom*sizeof(double));
+    memset(fy,0,natom*sizeof(double));
+    memset(fz,0,natom*sizeof(double));
+
+    for (i=0; i<natom; i++)
+    {
+        ci = tab + type[i]*nt*stride;
+        for (j=i+1; j<natom; j++)
+        {
+            dx = x[i]-x[j];
+            dy = y[i]-y[j];
+            dz = z[i]-z[j];
+            e.pair += tab_V_DV(ci+type[j]*stride, dx*dx + dy*dy + dz*dz, &de);
+
+            fx[i] += de*dx; fy[i] += de*dy; fz[i] += de*dz;
+            fx[j] -= de*dx; fy[j] -= de*dy; fz[j] -= de*dz;
+        }
+    }
+
+    return e;
+}
+
+/**
+ * @brief Gradient of the tabulated potential : each pair is visited once and its force applied to both atoms
+ */
+void get_TAB_DV(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[])
+{
+    get_TAB_V_DV(crd,dat,fx,fy,fz);
+}
@@ -0,0 +1,426 @@
+/**
+ * \file threebody.c
+ *
+ * \brief Axilrod-Teller triple-dipole dispersion term, added on top of a pair potential (THREEBODY keyword)
+ *
+ * \details The energy of a triplet of atoms i,j,k is
+ *              nu (1 + 3 cos(g_i) cos(g_j) cos(g_k)) / (r_ij r_ik r_jk)^3
+ *          where g_i is the angle of the triangle at atom i ; Axilrod and Teller, J. Chem. Phys. 11, 299 (1943).
+ *          It is only written with the squared distances, the product of the cosines being
+ *          (u+v-t)(u+t-v)(v+t-u)/(8uvt) with u = r_ij^2, v = r_ik^2 and t = r_jk^2.
+ *
+ *          The constant nu is either given for all the triplets in the input file (in the energy and length units of
+ *          the potential : about 0.073 for argon in L-J reduced units), or with the Aziz potential taken from the
+ *          built-in constants of neon and argon, in kcal/mol and angstroems ; the constant of a triplet of different
+ *          species is then approximated by the geometric mean of the three constants.
+ *
+ *          The term is not part of the energy functions (get_ENER ...) : the MC moves add the change of the
+ *          three-body energy of the moving atom (get_3B_diff) to the pair energy difference, the old and new triplets
+ *          sharing the distances between the other atoms. With a cutoff only the triplets whose three sides are
+ *          shorter are summed, and the neighbours of an atom are taken from the cell grid of the coordinates store
+ *          (see cells.c), which costs O(n^2) per move for n neighbours instead of O(N^2).
+ *
+ * \authors Florent Hedin (University of Basel, Switzerland) \n
+ *          Markus Meuwly (University of Basel, Switzerland)
+ *
+ * \copyright Copyright (c) 2011-2015, Florent Hédin, Markus Meuwly, and the University of Basel. \n
+ *            All rights reserved. \n
+ *            The 3-clause BSD license is applied to this software. \n
+ *            See LICENSE.txt
+ *
+ */
+
+// required for the per thread cpu clock when compiling with -std=c99
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "global.h"
+#include "cells.h"
+#include "threebody.h"
+#include "logger.h"
+
+/*
+ * Built-in triple-dipole constants in atomic units, indexed by AZIZ_SPECIES :
+ *  Kumar and Meath, Mol. Phys. 54, 823 (1985)
+ */
+static const double c9_aziz[2] = {11.96, 518.3};
+
+/// constant given in the input file, 0 if none
+static double user_nu = 0.0;
+
+/// ntypes*ntypes*ntypes table of the constant of each triplet of species
+static double *nu3 = NULL;
+static uint32_t nt = 0;
+
+/// cpu time spent in the three-body functions, summed over the threads
+static double tb_time = 0.0;
+
+static double thread_cpu_time()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID,&ts);
+
+    return (double)ts.tv_sec + 1.0e-09*(double)ts.tv_nsec;
+}
+
+static void add_time(double t0)
+{
+    const double dt = thread_cpu_time() - t0;
+
+#ifdef _OPENMP
+    #pragma omp atomic
+#endif
+    tb_time += dt;
+}
+
+/*
+ * Energy of one triplet from the squared distances u, v, t and s = 1/(r_ij r_ik r_jk) ;
+ * if wu is not NULL the derivatives with respect to u, v and t are stored in wu, wv and wt
+ */
+static inline double at_triplet(double nu, double u, double v, double t, double s, double *wu, double *wv, double *wt)
+{
+    const double a = u+v-t, b = u+t-v, c = v+t-u;
+    const double p = a*b*c;
+    const double s2 = s*s;
+    const double s3 = s2*s;
+
+    if (wu != NULL)
+    {
+        const double s5 = 0.375*s3*s2;
+        *wu = nu*( -1.5*s3/u + s5*(b*c + a*c - a*b - 2.5*p/u) );
+        *wv = nu*( -1.5*s3/v + s5*(b*c - a*c + a*b - 2.5*p/v) );
+        *wt = nu*( -1.5*s3/t + s5*(a*c + a*b - b*c - 2.5*p/t) );
+    }
+
+    return nu*s3*(1.0 + 0.375*p*s2);
+}
+
+void set_3B_nu(double nu)
+{
+    user_nu = nu;
+}
+
+/**
+ * @brief Fills the table of the constant of each triplet of species : the one of the input file, or the built-in
+ *          ones of the Aziz species converted to kcal/mol and angstroems.
+ *
+ * @param dat Common data, with dat->aziz_sp already resolved if the Aziz potential is used
+ */
+void build_3B_table(DATA *dat)
+{
+    uint32_t ti, tj, tk;
+    double *c9 = NULL;
+
+    if (user_nu == 0.0 && dat->aziz_sp == NULL)
+    {
+        LOG_PRINT(LOG_ERROR,"THREEBODY : NU is required, built-in constants only exist for the Aziz potential.\n");
+        exit(-1);
+    }
+
+    nt = dat->ntypes;
+    nu3 = malloc(nt*nt*nt*sizeof *nu3);
+    c9 = malloc(nt*sizeof *c9);
+
+    for (ti=0; ti<nt; ti++)
+        c9[ti] = (user_nu != 0.0) ? user_nu : c9_aziz[dat->aziz_sp[ti]]*HARTREETOKCAL*pow(BOHRTOANG,9.0);
+
+    for (ti=0; ti<nt; ti++)
+        for (tj=0; tj<nt; tj++)
+            for (tk=0; tk<nt; tk++)
+                nu3[(ti*nt+tj)*nt+tk] = cbrt(c9[ti]*c9[tj]*c9[tk]);
+
+    free(c9);
+}
+
+void free_3B_table()
+{
+    free(nu3);
+    nu3 = NULL;
+    nt = 0;
+}
+
+/*
+ * Gathers the atoms j!=i with j>=jmin around the point xi,yi,zi (the position of atom i), closer than the cutoff
+ * if there is one : from the 27 cells around the point if the store has a cell grid, otherwise from all the atoms.
+ * Their indices, squared distances and inverse distances are stored in idx, u and ru ; returns their number.
+ */
+static uint32_t at_neighbours(const COORDS *crd, uint32_t i, uint32_t jmin, double xi, double yi, double zi, double rc2,
+                              uint32_t idx[], double u[], double ru[])
+{
+    uint32_t j, k, n, cnt=0;
+    uint32_t nb[27];
+    int32_t l;
+    double d2;
+
+    if (rc2 == 0.0 || crd->cells == NULL)
+    {
+        for (j=jmin; j<crd->natom; j++)
+        {
+            if (j==i)
+                continue;
+            d2 = X2(xi-crd->x[j]) + X2(yi-crd->y[j]) + X2(zi-crd->z[j]);
+            if (rc2 != 0.0 && d2 >= rc2)
+                continue;
+            idx[cnt] = j;
+            u[cnt] = d2;
+            ru[cnt] = 1.0/sqrt(d2);
+            cnt++;
+        }
+        return cnt;
+    }
+
+    n = get_neighbour_cells(crd->cells,xi,yi,zi,nb);
+    for (k=0; k<n; k++)
+    {
+        for (l=crd->cells->head[nb[k]]; l!=-1; l=crd->cells->next[l])
+        {
+            j = (uint32_t) l;
+            if (j==i || j<jmin)
+                continue;
+            d2 = X2(xi-crd->x[j]) + X2(yi-crd->y[j]) + X2(zi-crd->z[j]);
+            if (d2 >= rc2)
+                continue;
+            idx[cnt] = j;
+            u[cnt] = d2;
+            ru[cnt] = 1.0/sqrt(d2);
+            cnt++;
+        }
+    }
+
+    return cnt;
+}
+
+/*
+ * Sum of the triplets (i,j,k) for all the pairs of gathered neighbours j,k of atom i of species ti,
+ * whose distance is shorter than the cutoff if there is one
+ */
+static double at_row(const COORDS *crd, const DATA *dat, uint32_t ti, uint32_t n, const uint32_t idx[], const double u[],
+                     const double ru[], double rc2)
+{
+    const double *nui = nu3 + ti*nt*nt;
+    double energy = 0.0;
+    int64_t a;
+
+#ifndef _OPENMP
+    (void) dat;
+#else
+    #pragma omp parallel for default(shared) reduction(+:energy) schedule(dynamic,8) if(n>TB_OMP_MIN && !dat->det_sum)
+#endif
+    for (a=0; a<(int64_t)n; a++)
+    {
+        const uint32_t j = idx[a];
+        const double *nuj = nui + crd->type[j]*nt;
+        const double xj = crd->x[j], yj = crd->y[j], zj = crd->z[j];
+
+        for (uint32_t b=(uint32_t)a+1; b<n; b++)
+        {
+            const uint32_t k = idx[b];
+            const double t = X2(xj-crd->x[k]) + X2(yj-crd->y[k]) + X2(zj-crd->z[k]);
+
+            if (rc2 != 0.0 && t >= rc2)
+                continue;
+
+            energy += at_triplet(nuj[crd->type[k]],u[a],u[b],t,ru[a]*ru[b]/sqrt(t),NULL,NULL,NULL);
+        }
+    }
+
+    return energy;
+}
+
+/**
+ * @brief Axilrod-Teller energy of the whole system, or of the triplets containing one atom
+ *
+ * @param crd The coordinates store
+ * @param dat Common data
+ * @param candidate The atom whose triplets are summed, or -1 for all the triplets
+ *
+ * @return The energy
+ */
+double get_3B_V(const COORDS *crd, const DATA *dat, int32_t candidate)
+{
+    const double t0 = thread_cpu_time();
+    const double rc2 = X2(dat->tb_cutoff);
+    uint32_t i, n;
+    double energy = 0.0;
+
+    uint32_t *idx = malloc(crd->natom*sizeof *idx);
+    double *u = malloc(crd->natom*sizeof *u);
+    double *ru = malloc(crd->natom*sizeof *ru);
+
+    if (candidate == -1)
+    {
+        for (i=0; i<crd->natom; i++)
+        {
+            n = at_neighbours(crd,i,i+1,crd->x[i],crd->y[i],crd->z[i],rc2,idx,u,ru);
+            energy += at_row(crd,dat,crd->type[i],n,idx,u,ru,rc2);
+        }
+    }
+    else
+    {
+        i = (uint32_t) candidate;
+        n = at_neighbours(crd,i,0,crd->x[i],crd->y[i],crd->z[i],rc2,idx,u,ru);
+        energy = at_row(crd,dat,crd->type[i],n,idx,u,ru,rc2);
+    }
+
+    free(idx);
+    free(u);
+    free(ru);
+
+    add_time(t0);
+
+    return energy;
+}
+
+/**
+ * @brief Change of the Axilrod-Teller energy when one atom moves. Without a cutoff the old and new triplets are
+ *          summed in a single sweep over the pairs of the other atoms, whose distance is shared ; with a cutoff
+ *          the two sets of neighbours differ and the triplets of both positions are summed separately.
+ *
+ * @param crd The coordinates store before the move
+ * @param crd_new The coordinates store after the move, only the candidate differing from crd
+ * @param dat Common data
+ * @param candidate The moving atom
+ *
+ * @return The energy after the move minus the energy before
+ */
+double get_3B_diff(const COORDS *crd, const COORDS *crd_new, const DATA *dat, uint32_t candidate)
+{
+    if (dat->tb_cutoff > 0.0)
+        return get_3B_V(crd_new,dat,(int32_t)candidate) - get_3B_V(crd,dat,(int32_t)candidate);
+
+    const double t0 = thread_cpu_time();
+    const uint32_t i = candidate;
+    const double *nui = nu3 + crd->type[i]*nt*nt;
+    uint32_t n;
+    double diff = 0.0;
+    int64_t a;
+
+    uint32_t *idx = malloc(crd->natom*sizeof *idx);
+    double *u = malloc(crd->natom*sizeof *u);
+    double *ru = malloc(crd->natom*sizeof *ru);
+    double *un = malloc(crd->natom*sizeof *un);
+    double *run = malloc(crd->natom*sizeof *run);
+
+    // without cutoff both calls gather all the other atoms in the same order
+    n = at_neighbours(crd,i,0,crd->x[i],crd->y[i],crd->z[i],0.0,idx,u,ru);
+    at_neighbours(crd_new,i,0,crd_new->x[i],crd_new->y[i],crd_new->z[i],0.0,idx,un,run);
+
+#ifdef _OPENMP
+    #pragma omp parallel for default(shared) reduction(+:diff) schedule(dynamic,8) if(n>TB_OMP_MIN && !dat->det_sum)
+#endif
+    for (a=0; a<(int64_t)n; a++)
+    {
+        const uint32_t j = idx[a];
+        const double *nuj = nui + crd->type[j]*nt;
+        const double xj = crd->x[j], yj = crd->y[j], zj = crd->z[j];
+
+        for (uint32_t b=(uint32_t)a+1; b<n; b++)
+        {
+            const uint32_t k = idx[b];
+            const double t = X2(xj-crd->x[k]) + X2(yj-crd->y[k]) + X2(zj-crd->z[k]);
+            const double rt = 1.0/sqrt(t);
+            const double nu = nuj[crd->type[k]];
+
+            diff += at_triplet(nu,un[a],un[b],t,run[a]*run[b]*rt,NULL,NULL,NULL)
+                  - at_triplet(nu,u[a],u[b],t,ru[a]*ru[b]*rt,NULL,NULL,NULL);
+        }
+    }
+
+    free(idx);
+    free(u);
+    free(ru);
+    free(un);
+    free(run);
+
+    add_time(t0);
+
+    return diff;
+}
+
+/**
+ * @brief Axilrod-Teller energy of the whole system and its gradient
+ *
+ * @param crd The coordinates store
+ * @param dat Common data
+ * @param fx,fy,fz The gradient of the pair potential, to which the one of the three-body term is added
+ *
+ * @return The energy
+ */
+double get_3B_DV(const COORDS *crd, const DATA *dat, double fx[], double fy[], double fz[])
+{
+    const double t0 = thread_cpu_time();
+    const double rc2 = X2(dat->tb_cutoff);
+    uint32_t i, j, k, n, a, b;
+    double energy = 0.0;
+    double t, wu, wv, wt;
+    double dxij, dyij, dzij, dxik, dyik, dzik, dxjk, dyjk, dzjk;
+
+    uint32_t *idx = malloc(crd->natom*sizeof *idx);
+    double *u = malloc(crd->natom*sizeof *u);
+    double *ru = malloc(crd->natom*sizeof *ru);
+
+    for (i=0; i<crd->natom; i++)
+    {
+        const double *nui = nu3 + crd->type[i]*nt*nt;
+
+        n = at_neighbours(crd,i,i+1,crd->x[i],crd->y[i],crd->z[i],rc2,idx,u,ru);
+
+        for (a=0; a<n; a++)
+        {
+            j = idx[a];
+            dxij = crd->x[i]-crd->x[j];
+            dyij = crd->y[i]-crd->y[j];
+            dzij = crd->z[i]-crd->z[j];
+
+            for (b=a+1; b<n; b++)
+            {
+                k = idx[b];
+                dxjk = crd->x[j]-crd->x[k];
+                dyjk = crd->y[j]-crd->y[k];
+                dzjk = crd->z[j]-crd->z[k];
+                t = dxjk*dxjk + dyjk*dyjk + dzjk*dzjk;
+
+                if (rc2 != 0.0 && t >= rc2)
+                    continue;
+
+                energy += at_triplet(nui[crd->type[j]*nt+crd->type[k]],u[a],u[b],t,ru[a]*ru[b]/sqrt(t),&wu,&wv,&wt);
+
+                // d(u)/d(r_i) = 2 r_ij, d(v)/d(r_i) = 2 r_ik, d(t)/d(r_j) = 2 r_jk
+                wu *= 2.0; wv *= 2.0; wt *= 2.0;
+                dxik = crd->x[i]-crd->x[k];
+                dyik = crd->y[i]-crd->y[k];
+                dzik = crd->z[i]-crd->z[k];
+
+                fx[i] += wu*dxij + wv*dxik;
+                fy[i] += wu*dyij + wv*dyik;
+                fz[i] += wu*dzij + wv*dzik;
+
+                fx[j] += wt*dxjk - wu*dxij;
+                fy[j] += wt*dyjk - wu*dyij;
+                fz[j] += wt*dzjk - wu*dzij;
+
+                fx[k] -= wv*dxik + wt*dxjk;
+                fy[k] -= wv*dyik + wt*dyjk;
+                fz[k] -= wv*dzik + wt*dzjk;
+            }
+        }
+    }
+
+    free(idx);
+    free(u);
+    free(ru);
+
+    add_time(t0);
+
+    return energy;
+}
+
+double get_3B_time()
+{
+    return tb_time;
+}